@@ -5,12 +5,10 @@
 #include <cstdlib>
 
 /* constants/global variables ------------------------------------------------*/
-static obs_t obss = {0}; /* observation data */
+static obsstr_t strs[1]; /* observation stream (rover) */
 static imu_t imus = {0}; /* imu data */
 static sta_t sta = {0};
-static int iobs = 0; /* current rover observation data index */
 static int iimu = 0; /* current imu data index */
-static int nepoch;
 
 typedef struct
 {
@@ -18,17 +16,17 @@ typedef struct
     CVect3 vngps, posgps;
 } gps_t;
 
-static int data_align(CRMemory &memimu, CRMemory &memobs, int &iimu, int &iobsu)
+static int data_align(CRMemory &memimu, obsstr_t *str, int &iimu)
 {
     double tow, refs;
     imud_t *pimu = (imud_t *)memimu.get(0);
-    obsd_t *pobs = (obsd_t *)memobs.get(0);
+    obsd_t *pobs = str->rnx.obs.data;
 
     refs = (pimu->t > time2gpst(pobs->time, NULL)) ? pimu->t : time2gpst(pobs->time, NULL);
 
-    for (iobsu = 0; iobsu < memobs.recordNum; iobsu++)
+    for (; str->rnx.obs.n > 0; next_obsstr(str))
     {
-        tow = time2gpst(pobs[iobsu].time, NULL);
+        tow = time2gpst(pobs->time, NULL);
         if (tow >= refs)
             break;
     }
@@ -39,32 +37,27 @@ static int data_align(CRMemory &memimu, CRMemory &memobs, int &iimu, int &iobsu)
             break;
     }
 
-    return (iimu < memimu.recordNum && iobsu < memobs.recordNum) ? 1 : 0;
+    return (iimu < memimu.recordNum && str->rnx.obs.n > 0) ? 1 : 0;
 }
 
-static int inputobs(CRMemory &memobs, int &iobsu, obsd_t *obs)
+static int inputobs(obsstr_t *str, obsd_t *obs)
 {
     int n;
-    obsd_t *pobs = (obsd_t *)memobs.get(iobsu);
 
-    for (n = 0; n < memobs.recordNum - iobsu; n++)
+    for (n = 0; n < str->rnx.obs.n; n++)
     {
-        if (timediff(pobs[n].time, pobs[0].time) > DTTOL)
-        {
-            break;
-        }
-        obs[n] = pobs[n];
+        obs[n] = str->rnx.obs.data[n];
     }
-    iobsu += n;
+    next_obsstr(str);
 
     return n;
 }
 
-static void Forward(CRMemory &memimu, CRMemory &memobs, CMyAutoDrive &app)
+static void Forward(CRMemory &memimu, obsstr_t *str, CMyAutoDrive &app)
 {
     imud_t *pimu;
     obsd_t obs[MAXOBS];
-    int nobs = inputobs(memobs, iobs, obs), nn = getSamples(app);
+    int nobs = inputobs(str, obs), nn = getSamples(app);
     double tobs = time2gpst(obs[0].time, NULL);
     for (; iimu + nn < imus.n; iimu += nn)
     {
@@ -73,7 +66,7 @@ static void Forward(CRMemory &memimu, CRMemory &memobs, CMyAutoDrive &app)
         if (app.tk >= tobs)
         {
             app.GPSProcess(obs, nobs);
-            nobs = inputobs(memobs, iobs, obs);
+            nobs = inputobs(str, obs);
             tobs = time2gpst(obs[0].time, NULL);
         }
     }
@@ -82,6 +75,7 @@ static void Forward(CRMemory &memimu, CRMemory &memobs, CMyAutoDrive &app)
 int main(int argc, char *argv[])
 {
     unsigned int tick = tickget();
+    char obsfile[MAXSTRPATH];
 
     /* Read YAML */
     CGNSSConfig Gyaml;
@@ -91,14 +85,16 @@ int main(int argc, char *argv[])
         return -1;
 
     /* Read Data */
-    if (!readobs(Gyaml.filopt.rovobs, 1, &Gyaml.prcopt, &obss, &sta, &nepoch))
+    cacheobc(Gyaml.filopt.cachedir, Gyaml.filopt.rovobs, Gyaml.prcopt.rnxopt[0], obsfile);
+    if (!open_obsstr(strs, obsfile, 1, Gyaml.prcopt.ts, Gyaml.prcopt.te, Gyaml.prcopt.ti,
+                     Gyaml.prcopt.rnxopt[0]))
         return 0;
+    sta = strs[0].rnx.sta;
     if (!readimu(&Iyaml.imuopt, &imus))
         return 0;
 
     CRMemory memimu((BYTE *)imus.data, imus.n * sizeof(imud_t), sizeof(imud_t));
-    CRMemory memobs((BYTE *)obss.data, obss.n * sizeof(obsd_t), sizeof(obsd_t));
-    if (!data_align(memimu, memobs, iimu, iobs))
+    if (!data_align(memimu, strs, iimu))
         return 0;
 
     /* Processing instantiation */
@@ -110,7 +106,8 @@ int main(int argc, char *argv[])
 
     // SetInterrupt(app, 371287, 371327);
     /* Forward Processing */
-    Forward(memimu, memobs, app);
+    Forward(memimu, strs, app);
+    close_obsstr(strs);
 
     app.Sol2kml();
     checkbrk("%40s", "");
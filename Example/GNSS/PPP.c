@@ -3,14 +3,19 @@
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define SQRT(x) ((x) <= 0.0 || (x) != (x) ? 0.0 : sqrt(x))
+#define NEPWIN 3600 /* number of rover epochs in obs data window */
 
 /* constants/global variables ------------------------------------------------*/
 static pcvs_t pcvss = {0};  /* receiver antenna parameters */
 static pcvs_t pcvsr = {0};  /* satellite antenna parameters */
-static obs_t obss = {0};    /* observation data */
+static obs_t obss = {0};    /* observation data window */
+static obsstr_t strs[1];    /* observation streams (0:rover) */
 static nav_t navs = {0};    /* navigation data */
+static satsto_t stos = {0}; /* precomputed satellite states */
 static stas_t stas = {{0}}; /* station list */
 static int nepoch = 0;      /* number of observation epochs */
+static int niter = 0;       /* number of filter iterations */
+static int nsave = 0;       /* robust filter re-runs skipped (no pos-fit rejection) */
 static int iobsu = 0;       /* current rover observation data index */
 static int iobsr = 0;       /* current reference observation data index */
 static int revs = 0;        /* analysis direction (0:forward,1:backward) */
@@ -73,6 +78,22 @@ static int nextobsb(const obs_t *obs, int *i, int rcv)
     return n;
 }
 
+/* input next obs data window ------------------------------------------------*/
+static int inputwin(const prcopt_t *popt)
+{
+    int n;
+
+    navs.sto = NULL;
+    if ((n = readobsw(strs, 1, NEPWIN, &obss)) <= 0)
+        return 0;
+    nepoch += n;
+    iobsu = iobsr = 0;
+
+    /* precompute satellite states of window */
+    if (popt->satpre > 0 && satprecomp(&obss, &navs, popt->sateph, popt->satpre, &stos))
+        navs.sto = &stos;
+    return n;
+}
 /* input obs data, navigation messages and sbas correction -------------------*/
 static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
 {
@@ -92,7 +113,7 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
     }
     if (!revs)
     { /* input forward data */
-        if ((nu = nextobsf(&obss, &iobsu, 1)) <= 0)
+        if ((nu = nextobsf(&obss, &iobsu, 1)) <= 0 && (!inputwin(popt) || (nu = nextobsf(&obss, &iobsu, 1)) <= 0))
             return -1;
         if (popt->intpref)
         {
@@ -171,12 +192,13 @@ static int process(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 }
 
 /* process positioning ----------------------------------------------------*/
-static void procpos(const prcopt_t *popt, const solopt_t *sopt, rtk_t *rtk, int mode, FILE *fp_outs[])
+static int procpos(const prcopt_t *popt, const solopt_t *sopt, rtk_t *rtk, int mode, FILE *fp_outs[])
 {
-    int i, nobs, n;
+    int i, nobs, n, nep = 0;
     obsd_t obs[MAXOBS];
 
     iobsu = (mode == 0) ? 0 : obss.n - 1;
+    niter = nsave = 0;
     rtkinit(rtk, popt);
 
     while ((nobs = inputobs(obs, rtk->sol.stat, popt)) >= 0)
@@ -197,6 +219,9 @@ static void procpos(const prcopt_t *popt, const solopt_t *sopt, rtk_t *rtk, int
 
         if (!process(rtk, obs, n, &navs))
             continue;
+        nep++;
+        niter += rtk->niter;
+        nsave += rtk->nsave;
         if (mode == 0)
         {
             outppp(fp_outs[1], rtk, obs, n, &navs);
@@ -204,6 +229,7 @@ static void procpos(const prcopt_t *popt, const solopt_t *sopt, rtk_t *rtk, int
         }
     }
     checkbrk("                                        ");
+    return nep;
 }
 
 int main(int argc, char *argv[])
@@ -231,22 +257,33 @@ int main(int argc, char *argv[])
     for (int i = 0; i < stas.n; i++)
     {
         unsigned int tick = tickget();
+        int nep = 0;
         trace(1, "%03d:%s\n", i + 1, stas.data[i].name);
 
-        /* read obs */
+        /* open obs stream */
         reppath(filopt.rovobs, path, prcopt.ts, stas.data[i].name, "");
-        if (!readobs(path, 1, &prcopt, &obss, &sta, &nepoch))
+        cacheobc(filopt.cachedir, path, prcopt.rnxopt[0], path);
+        if (!open_obsstr(strs, path, 1, prcopt.ts, prcopt.te, prcopt.ti, prcopt.rnxopt[0]))
             continue;
+        sta = strs[0].rnx.sta;
 
         /* read ppp corrections */
         reppath(filopt.corr, path, prcopt.ts, "", "");
         pppcorr_read(path, &navs);
 
         /* set antenna &&  ocean tide && ref position */
-        setpcv(obss.n > 0 ? obss.data[0].time : timeget(), &prcopt, &navs, &pcvss, &pcvsr, &sta);
+        setpcv(strs[0].rnx.obs.data[0].time, &prcopt, &navs, &pcvss, &pcvsr, &sta);
         readblq(filopt.blq, sta.name, prcopt.odisp[0]);
         matcpy(prcopt.ru, (norm(stas.data[i].pos, 3) > 0.0) ? stas.data[i].pos : sta.pos, 3, 1);
 
+        /* read first obs data window */
+        nepoch = 0;
+        if (!inputwin(&prcopt))
+        {
+            close_obsstr(strs);
+            continue;
+        }
+
         /* open outfile &&  write file header*/
         sprintf(outfile1, "%s%s", filopt.outdir, filopt.outfile1);
         sprintf(outfile2, "%s%s", filopt.outdir, filopt.outfile2);
@@ -254,7 +291,10 @@ int main(int argc, char *argv[])
         if (!(fp_outs[0] = openfile(outfile1, prcopt.ts, stas.data[i].name)) ||
             !(fp_outs[1] = openfile(outfile2, prcopt.ts, stas.data[i].name)))
         {
+            navs.sto = NULL;
+            freesatsto(&stos);
             freeobs(&obss);
+            close_obsstr(strs);
             closefile(fp_outs, 2);
             continue;
         }
@@ -266,7 +306,7 @@ int main(int argc, char *argv[])
         /* process */
         if (prcopt.soltype == 0)
         {
-            procpos(&prcopt, &solopt, &rtk, 0, fp_outs);
+            nep = procpos(&prcopt, &solopt, &rtk, 0, fp_outs);
 #if 1
             char time[32];
             double rr[3], enu[3], pos[3];
@@ -286,10 +326,15 @@ int main(int argc, char *argv[])
             rtkfree(&rtk);
         }
 
+        navs.sto = NULL;
+        freesatsto(&stos);
         freeobs(&obss);
+        close_obsstr(strs);
         closefile(fp_outs, 2);
         traceclose();
         printf("\nTime=%.1f s\n", (tickget() - tick) * 0.001);
+        printf("Iter=%.2f /epoch (robust=%s, skipped re-runs=%d)\n", nep > 0 ? (double)niter / nep : 0.0,
+               prcopt.robust == ROBUST_IGG3 ? "igg3" : "off", nsave);
     }
     freeproduct(&navs, &pcvss, &pcvsr, &stas);
     // sol2kml(filopt.outdir);
@@ -5,6 +5,7 @@
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define SQRT(x) ((x) <= 0.0 || (x) != (x) ? 0.0 : sqrt(x))
+#define NEPWIN 3600 /* number of rover epochs in obs data window */
 
 #define MAXINFILE 1000               /* max number of input files */
 #define TTOL_MOVEB (1.0 + 2 * DTTOL) /* time sync tolerance for moving-baseline (s) */
@@ -12,8 +13,10 @@
 /* constants/global variables ------------------------------------------------*/
 static pcvs_t pcvss = {0}; /* receiver antenna parameters */
 static pcvs_t pcvsr = {0}; /* satellite antenna parameters */
-static obs_t obss = {0};   /* observation data */
+static obs_t obss = {0};   /* observation data window */
+static obsstr_t strs[2];   /* observation streams (0:rover,1:reference) */
 static nav_t navs = {0};   /* navigation data */
+static satsto_t stos = {0}; /* precomputed satellite states */
 static stas_t stas = {0};  /* station list */
 static int nepoch = 0;     /* number of observation epochs */
 static int iobsu = 0;      /* current rover observation data index */
@@ -96,6 +99,22 @@ static int nextobsb(const obs_t *obs, int *i, int rcv)
     return n;
 }
 
+/* input next obs data window ------------------------------------------------*/
+static int inputwin(const prcopt_t *popt)
+{
+    int n;
+
+    navs.sto = NULL;
+    if ((n = readobsw(strs, 2, NEPWIN, &obss)) <= 0)
+        return 0;
+    nepoch += n;
+    iobsu = iobsr = 0;
+
+    /* precompute satellite states of window */
+    if (popt->satpre > 0 && satprecomp(&obss, &navs, popt->sateph, popt->satpre, &stos))
+        navs.sto = &stos;
+    return n;
+}
 /* input obs data, navigation messages and sbas correction -------------------*/
 static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
 {
@@ -115,7 +134,7 @@ static int inputobs(obsd_t *obs, int solq, const prcopt_t *popt)
     }
     if (!revs)
     { /* input forward data */
-        if ((nu = nextobsf(&obss, &iobsu, 1)) <= 0)
+        if ((nu = nextobsf(&obss, &iobsu, 1)) <= 0 && (!inputwin(popt) || (nu = nextobsf(&obss, &iobsu, 1)) <= 0))
             return -1;
         if (popt->intpref)
         {
@@ -276,7 +295,7 @@ int main(int argc, char *argv[])
     solopt_t solopt = solopt_default;
     filopt_t filopt = {""};
     unsigned int tick = tickget();
-    char solfile[MAXINFILE], relfile[MAXINFILE];
+    char solfile[MAXINFILE], relfile[MAXINFILE], rovfile[MAXINFILE], reffile[MAXINFILE];
 
     /* load conf */
     if (!loadopts(argv[1], sysopts))
@@ -287,17 +306,32 @@ int main(int argc, char *argv[])
     if (!readproduct(&prcopt, &filopt, &navs, &pcvss, &pcvsr, NULL))
         return 0;
 
-    /* read obs */
-    if (!readobs(filopt.rovobs, 1, &prcopt, &obss, stas, &nepoch))
+    /* open obs streams */
+    cacheobc(filopt.cachedir, filopt.rovobs, prcopt.rnxopt[0], rovfile);
+    cacheobc(filopt.cachedir, filopt.refobs, prcopt.rnxopt[0], reffile);
+    if (!open_obsstr(strs, rovfile, 1, prcopt.ts, prcopt.te, prcopt.ti, prcopt.rnxopt[0]))
         return 0;
-    if (!readobs(filopt.refobs, 2, &prcopt, &obss, stas + 1, &nepoch))
+    if (!open_obsstr(strs + 1, reffile, 2, prcopt.ts, prcopt.te, prcopt.ti, prcopt.rnxopt[0]))
+    {
+        close_obsstr(strs);
         return 0;
+    }
+    stas[0] = strs[0].rnx.sta;
+    stas[1] = strs[1].rnx.sta;
 
     /* set antenna &&  ocean tide && ref position */
-    setpcv(obss.n > 0 ? obss.data[0].time : timeget(), &prcopt, &navs, &pcvss, &pcvsr, stas);
+    setpcv(strs[0].rnx.obs.data[0].time, &prcopt, &navs, &pcvss, &pcvsr, stas);
     readblq(filopt.blq, stas[0].name, prcopt.odisp[0]);
     readblq(filopt.blq, stas[1].name, prcopt.odisp[1]);
 
+    /* read first obs data window */
+    if (!inputwin(&prcopt))
+    {
+        close_obsstr(strs);
+        close_obsstr(strs + 1);
+        return 0;
+    }
+
     /* open outfile */
     // sprintf(solfile, "%s%s%s", filopt.outdir, stas[0].name, "-%y-%m-%d.sol");
     // sprintf(relfile, "%s%s%s", filopt.outdir, stas[0].name, "-%y-%m-%d.rtk");
@@ -317,7 +351,11 @@ int main(int argc, char *argv[])
     }
     closefile(fp_sol);
     closefile(fp_rel);
+    navs.sto = NULL;
+    freesatsto(&stos);
     freeobs(&obss);
+    close_obsstr(strs);
+    close_obsstr(strs + 1);
 
     freeproduct(&navs, &pcvss, &pcvsr, NULL);
 
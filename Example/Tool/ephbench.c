@@ -0,0 +1,104 @@
+/*------------------------------------------------------------------------------
+ * ephbench.c : micro-benchmark of broadcast ephemeris evaluation
+ *
+ * compare eph2pos() for each satellite with eph2posb() for all satellites of
+ * an epoch over a synthetic full GPS/Galileo/BeiDou/QZSS constellation
+ *
+ * usage : ephbench [nepoch]
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define NEPH (MAXPRNGPS + MAXPRNGAL + MAXPRNCMP + MAXPRNQZS)
+
+/* synthetic ephemeris -------------------------------------------------------*/
+static int seteph(eph_t *eph, gtime_t toe)
+{
+    const int sys[] = {SYS_GPS, SYS_GAL, SYS_CMP, SYS_QZS};
+    const int nprn[] = {MAXPRNGPS, MAXPRNGAL, MAXPRNCMP, MAXPRNQZS};
+    const int prn0[] = {MINPRNGPS, MINPRNGAL, MINPRNCMP, MINPRNQZS};
+    const double A[] = {26560E3, 29600E3, 27906E3, 42164E3};
+    double a;
+    int i, j, n = 0, week, prn;
+
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < nprn[i]; j++)
+        {
+            prn = prn0[i] + j;
+            memset(eph + n, 0, sizeof(eph_t));
+            eph[n].sat = satno(sys[i], prn);
+            a = A[i];
+            if (sys[i] == SYS_CMP && (prn <= 5 || prn >= 59))
+                a = 42164E3; /* geo */
+            else if (sys[i] == SYS_CMP && prn <= 10)
+                a = 42164E3; /* igso */
+            eph[n].A = a;
+            eph[n].e = sys[i] == SYS_QZS ? 0.075 : 0.002 + 0.0005 * (j % 20);
+            eph[n].i0 = (sys[i] == SYS_CMP && (prn <= 5 || prn >= 59) ? 0.5 : 55.0) * D2R;
+            eph[n].OMG0 = 2.0 * PI * (j % 6) / 6.0;
+            eph[n].omg = 0.3 * j;
+            eph[n].M0 = 0.7 * j;
+            eph[n].deln = 4.5E-9;
+            eph[n].OMGd = -8.0E-9;
+            eph[n].idot = 1.0E-10;
+            eph[n].crc = 200.0;
+            eph[n].crs = -50.0;
+            eph[n].cuc = -2.0E-6;
+            eph[n].cus = 8.0E-6;
+            eph[n].cic = 1.0E-7;
+            eph[n].cis = -5.0E-8;
+            eph[n].toes = time2gpst(toe, &week);
+            eph[n].toe = eph[n].toc = toe;
+            eph[n].f0 = 1.0E-4 * (j - 10) / 10.0;
+            eph[n].f1 = 1.0E-12;
+            eph[n].sva = 2;
+            n++;
+        }
+    return n;
+}
+int main(int argc, char **argv)
+{
+    static eph_t eph[NEPH];
+    static const eph_t *peph[NEPH];
+    static gtime_t time[NEPH];
+    static double rs1[NEPH * 3], dts1[NEPH], var1[NEPH], rs2[NEPH * 3], dts2[NEPH], var2[NEPH];
+    double ep[] = {2024, 1, 1, 0, 0, 0}, d, drmax = 0.0, dtmax = 0.0, t1, t2;
+    gtime_t toe = epoch2time(ep);
+    clock_t c;
+    int i, j, k, n, nep = argc > 1 ? atoi(argv[1]) : 2000;
+
+    n = seteph(eph, toe);
+
+    /* eph2pos() for each satellite */
+    c = clock();
+    for (k = 0; k < nep; k++)
+        for (i = 0; i < n; i++)
+            eph2pos(timeadd(toe, k * 1.0 - 3600.0 + i * 1E-3), eph + i, rs1 + i * 3, dts1 + i, var1 + i);
+    t1 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    /* eph2posb() for all satellites of epoch */
+    c = clock();
+    for (k = 0; k < nep; k++)
+    {
+        for (i = 0; i < n; i++)
+        {
+            time[i] = timeadd(toe, k * 1.0 - 3600.0 + i * 1E-3);
+            peph[i] = eph + i;
+        }
+        eph2posb(time, peph, n, rs2, dts2, var2);
+    }
+    t2 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < 3; j++)
+            if ((d = fabs(rs1[i * 3 + j] - rs2[i * 3 + j])) > drmax)
+                drmax = d;
+        if ((d = fabs(dts1[i] - dts2[i])) > dtmax)
+            dtmax = d;
+    }
+    printf("satellites=%d epochs=%d\n", n, nep);
+    printf("eph2pos : %8.3f ms (%6.1f ns/sat)\n", t1 * 1E3, t1 * 1E9 / n / nep);
+    printf("eph2posb: %8.3f ms (%6.1f ns/sat) speedup=%.2f\n", t2 * 1E3, t2 * 1E9 / n / nep, t1 / t2);
+    printf("max diff: pos=%.3e m clk=%.3e s\n", drmax, dtmax);
+    return 0;
+}
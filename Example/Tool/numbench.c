@@ -0,0 +1,158 @@
+/*------------------------------------------------------------------------------
+ * numbench.c : regression test and micro-benchmark of fixed-width number parser
+ *
+ * compare str2num() and str2time() with the former sscanf() implementations
+ * bit by bit over synthetic RINEX obs/nav/clk fields and edge cases, and over
+ * every field of an optional RINEX file, then time both
+ *
+ * usage : numbench [file]
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define NFIELD 200000 /* number of synthetic fields */
+
+/* former str2num() ----------------------------------------------------------*/
+static double str2num_ref(const char *s, int i, int n)
+{
+    double value;
+    char str[256], *p = str;
+
+    if (i < 0 || (int)strlen(s) < i || (int)sizeof(str) - 1 < n)
+        return 0.0;
+    for (s += i; *s && --n >= 0; s++)
+        *p++ = *s == 'd' || *s == 'D' ? 'E' : *s;
+    *p = '\0';
+    return sscanf(str, "%lf", &value) == 1 ? value : 0.0;
+}
+/* former str2time() for "yyyy mm dd hh mm ss" -------------------------------*/
+static int str2time_ref(const char *s, int i, int n, gtime_t *t)
+{
+    double ep[6];
+    char str[256], *p = str;
+
+    if (i < 0 || (int)strlen(s) < i || (int)sizeof(str) - 1 < i)
+        return -1;
+    for (s += i; *s && --n >= 0;)
+        *p++ = *s++;
+    *p = '\0';
+    if (sscanf(str, "%lf %lf %lf %lf %lf %lf", ep, ep + 1, ep + 2, ep + 3, ep + 4, ep + 5) < 6)
+        return -1;
+    if (ep[0] < 100.0)
+        ep[0] += ep[0] < 80.0 ? 2000.0 : 1900.0;
+    *t = epoch2time(ep);
+    return 0;
+}
+/* synthetic field -----------------------------------------------------------*/
+static void genfield(char *buff, int k)
+{
+    static const char *edge[] = {"",          "              ", "-0.000",      "+1",          "1.",
+                                 ".5",        "-.5e3",          "1e",          "1.0D",        "12.3 4",
+                                 "1.5-2",     "0x1A",           "inf",         "nan",         "- 1",
+                                 "1.2.3",     "1e400",          "1e-400",      "9007199254740993",
+                                 "1234567890123456789012", "0.000000000000000000000000123", "  \t7\n",
+                                 "1.234567890123D-04",     "-2.345678901234d+05",           "5E22",
+                                 "5E23",      "3a",             "00000000000000000000001.5"};
+    double v;
+    int r = rand();
+
+    switch (k % 5)
+    {
+    case 0: /* obs F14.3 + lli + snr */
+        v = (r % 2 ? 1.0 : -1.0) * (rand() % 1000000000) * 1E-3 * (rand() % 100 + 1);
+        sprintf(buff, "%14.3f%d%d", v, rand() % 8, rand() % 10);
+        break;
+    case 1: /* nav D19.12 */
+        v = (r % 2 ? 1.0 : -1.0) * (rand() + 1.0) / RAND_MAX * pow(10.0, rand() % 30 - 15);
+        sprintf(buff, "%19.12E", v);
+        buff[15] = 'D';
+        break;
+    case 2: /* clk E19.12 */
+        sprintf(buff, "%19.12E", (rand() - RAND_MAX / 2.0) / RAND_MAX * 1E-3);
+        break;
+    case 3: /* integer */
+        sprintf(buff, "%6d", rand() % 200000 - 100000);
+        break;
+    default:
+        strcpy(buff, edge[r % (int)(sizeof(edge) / sizeof(*edge))]);
+        break;
+    }
+}
+/* compare converted numbers -------------------------------------------------*/
+static int cmpnum(const char *s, int i, int n)
+{
+    double v1 = str2num_ref(s, i, n), v2 = str2num(s, i, n);
+
+    if (!memcmp(&v1, &v2, sizeof(double)))
+        return 0;
+    printf("mismatch: \"%s\" i=%d n=%d ref=%.17g new=%.17g\n", s, i, n, v1, v2);
+    return 1;
+}
+/* compare epoch time --------------------------------------------------------*/
+static int cmptime(const char *s, int i, int n)
+{
+    gtime_t t1 = {0}, t2 = {0};
+    int s1 = str2time_ref(s, i, n, &t1), s2 = str2time(s, i, n, &t2);
+
+    if (s1 == 0 && (s2 != 0 || t1.time != t2.time || t1.sec != t2.sec))
+    {
+        printf("mismatch: \"%s\" i=%d n=%d time\n", s, i, n);
+        return 1;
+    }
+    return 0;
+}
+int main(int argc, char **argv)
+{
+    static char field[NFIELD][32];
+    static const int width[] = {1, 3, 14, 16, 19};
+    char buff[1024], line[1024];
+    double sum1 = 0.0, sum2 = 0.0, t1, t2;
+    clock_t c;
+    FILE *fp;
+    int i, j, k, n = 0, nerr = 0, nline = 0;
+
+    srand(1);
+    for (k = 0; k < NFIELD; k++)
+    {
+        genfield(field[k], k);
+        for (i = 0; i <= (int)strlen(field[k]) + 1; i++)
+            for (j = 0; j < (int)(sizeof(width) / sizeof(*width)); j++, n++)
+                nerr += cmpnum(field[k], i, width[j]);
+    }
+    for (k = 0; k < 10000; k++)
+    {
+        sprintf(buff, "> %04d %02d %02d %02d %02d%11.7f  0 40", 2000 + rand() % 50, rand() % 12 + 1, rand() % 28 + 1,
+                rand() % 24, rand() % 60, rand() % 60000000 * 1E-6);
+        nerr += cmptime(buff, 1, 28);
+        sprintf(buff, " %02d %2d %2d %2d %2d%11.7f  0 12", rand() % 100, rand() % 12 + 1, rand() % 28 + 1, rand() % 24,
+                rand() % 60, rand() % 60000000 * 1E-6);
+        nerr += cmptime(buff, 0, 26);
+        n += 2;
+    }
+    /* every field of rinex file */
+    if (argc > 1 && (fp = fopen(argv[1], "r")))
+    {
+        while (fgets(line, sizeof(line), fp))
+        {
+            for (i = 0; i < (int)strlen(line); i++)
+                for (j = 0; j < (int)(sizeof(width) / sizeof(*width)); j++, n++)
+                    nerr += cmpnum(line, i, width[j]);
+            nline++;
+        }
+        fclose(fp);
+    }
+    /* timing of obs/nav/clk fields */
+    c = clock();
+    for (k = 0; k < NFIELD; k++)
+        sum1 += str2num_ref(field[k], 0, 14) + str2num_ref(field[k], 14, 1) + str2num_ref(field[k], 0, 19);
+    t1 = (double)(clock() - c) / CLOCKS_PER_SEC;
+    c = clock();
+    for (k = 0; k < NFIELD; k++)
+        sum2 += str2num(field[k], 0, 14) + str2num(field[k], 14, 1) + str2num(field[k], 0, 19);
+    t2 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    printf("fields=%d file lines=%d mismatches=%d\n", n, nline, nerr);
+    printf("sscanf : %8.3f ms (%6.1f ns/field)\n", t1 * 1E3, t1 * 1E9 / NFIELD / 3);
+    printf("scannum: %8.3f ms (%6.1f ns/field) speedup=%.2f %s\n", t2 * 1E3, t2 * 1E9 / NFIELD / 3, t1 / t2,
+           sum1 == sum2 || (sum1 != sum1 && sum2 != sum2) ? "" : "(sum differs)");
+    return nerr ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*------------------------------------------------------------------------------
+ * obcbench.c : regression test and benchmark of binary observation container
+ *
+ * read a RINEX obs file by readobs(), write it to a binary observation
+ * container by writeobc(), read the container back by readobc() and compare
+ * all obs data field by field, then compare epochs read after seek_obc() to
+ * random times and time RINEX and container reads
+ *
+ * usage : obcbench rinexfile [obcfile]
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define NSEEK 200 /* number of random seeks */
+
+static obs_t obs1, obs2;
+static obsd_t data[MAXOBS];
+
+/* compare obs data ----------------------------------------------------------*/
+static int cmpobs(const obsd_t *a, const obsd_t *b)
+{
+    int i;
+
+    if (timediff(a->time, b->time) != 0.0 || a->sat != b->sat || a->rcv != b->rcv)
+        return 1;
+    for (i = 0; i < NFREQ + NEXOBS; i++)
+    {
+        if (a->L[i] != b->L[i] || a->P[i] != b->P[i] || a->D[i] != b->D[i] || a->SNR[i] != b->SNR[i] ||
+            a->LLI[i] != b->LLI[i] || a->code[i] != b->code[i])
+            return 1;
+    }
+    return 0;
+}
+/* size of file --------------------------------------------------------------*/
+static long filesize(const char *file)
+{
+    FILE *fp;
+    long size;
+
+    if (!(fp = fopen(file, "rb")))
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+int main(int argc, char **argv)
+{
+    prcopt_t popt = prcopt_default;
+    obc_t obc;
+    sta_t sta;
+    const char *file = argc > 2 ? argv[2] : "obcbench.obc";
+    double t1, t2;
+    clock_t c;
+    int i, j, k, n, ne, bad = 0, bads = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage : obcbench rinexfile [obcfile]\n");
+        return -1;
+    }
+    /* rinex read */
+    c = clock();
+    if (!readobs(argv[1], 1, &popt, &obs1, &sta, &ne))
+    {
+        fprintf(stderr, "rinex read error : %s\n", argv[1]);
+        return -1;
+    }
+    t1 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    if (writeobc(file, &obs1, &sta) != ne)
+    {
+        fprintf(stderr, "container write error : %s\n", file);
+        return -1;
+    }
+    /* container read */
+    c = clock();
+    if (!readobs(file, 1, &popt, &obs2, NULL, NULL))
+    {
+        fprintf(stderr, "container read error : %s\n", file);
+        return -1;
+    }
+    t2 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    if (obs1.n != obs2.n)
+        bad = abs(obs1.n - obs2.n);
+    for (i = 0; i < obs1.n && i < obs2.n; i++)
+        bad += cmpobs(obs1.data + i, obs2.data + i);
+
+    /* random seek */
+    if (!open_obc(&obc, file))
+        return -1;
+    srand(1);
+    for (k = 0; k < NSEEK && obs1.n > 0; k++)
+    {
+        i = rand() % obs1.n;
+        seek_obc(&obc, obs1.data[i].time);
+        if ((n = read_obc(&obc, data, MAXOBS)) <= 0)
+        {
+            bads++;
+            continue;
+        }
+        for (; i > 0 && timediff(obs1.data[i - 1].time, data[0].time) == 0.0; i--)
+            ;
+        for (j = 0; j < n; j++)
+        {
+            data[j].rcv = 1;
+            bads += i + j >= obs1.n || cmpobs(obs1.data + i + j, data + j);
+        }
+    }
+    printf("epochs=%d obs=%d signals=%d\n", ne, obs1.n, obc.nsig);
+    close_obc(&obc);
+
+    printf("size  : rinex=%ld container=%ld (%.1f%%) %.1f bytes/obs\n", filesize(argv[1]), filesize(file),
+           100.0 * filesize(file) / filesize(argv[1]), (double)filesize(file) / obs1.n);
+    printf("read  : rinex=%.3f s container=%.3f s speedup=%.1f\n", t1, t2, t1 / t2);
+    printf("check : mismatch=%d seek mismatch=%d (%d seeks)\n", bad, bads, NSEEK);
+    return bad || bads ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*------------------------------------------------------------------------------
+ * sunbench.c : micro-benchmark of sun/moon position cache
+ *
+ * time satantoff() and model_phw() for all satellites of an epoch, once in
+ * epoch order (sun/moon position reused within the epoch) and once with the
+ * calls of two distant epochs interleaved (sun/moon position computed at
+ * every call as without cache), and check the direction error of cached
+ * positions against positions computed at the exact (off-grid) time
+ *
+ * usage : sunbench [nepoch]
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define NSAT 40    /* number of satellites in an epoch */
+#define THRES 1E-6 /* claimed error of cached sun/moon direction (rad) */
+
+static nav_t nav;
+static double rs[NSAT * 6], rr[3], phw[NSAT];
+
+/* angle between vectors ----------------------------------------------------*/
+static double angle(const double *a, const double *b)
+{
+    double c[3];
+
+    cross3(a, b, c);
+    return atan2(norm(c, 3), dot(a, b, 3));
+}
+/* error of cached sun/moon position at time ---------------------------------*/
+static void cacheerr(gtime_t t, const double *erpv, double *err)
+{
+    double rs[3], rm[3], rse[3], rme[3], rsun[3], rmoon[3], U[9], g, ge;
+
+    /* cached */
+    sunmoonpos(t, erpv, rsun, rmoon, &g);
+
+    /* exact without cache (eci2ecef() reuses matrix within 0.01 s) */
+    sunmoonpos_eci(timeadd(t, erpv[2]), rs, rm);
+    eci2ecef(timeadd(t, 1.0), erpv, U, &ge);
+    eci2ecef(t, erpv, U, &ge);
+    matmul("NN", 3, 1, 3, 1.0, U, rs, 0.0, rse);
+    matmul("NN", 3, 1, 3, 1.0, U, rm, 0.0, rme);
+
+    err[0] = angle(rsun, rse);
+    err[1] = angle(rmoon, rme);
+    err[2] = fabs(g - ge);
+}
+/* satellite models of satellite i at epoch k --------------------------------*/
+static void satmodel(gtime_t t0, int k, int i)
+{
+    gtime_t time = timeadd(t0, k * 30.0 + 0.07 + i * 1E-3);
+    double dant[3];
+
+    satantoff(time, rs + i * 6, i + 1, &nav, dant);
+    model_phw(time, i + 1, "", 2, rs + i * 6, rr, phw + i);
+}
+int main(int argc, char **argv)
+{
+    double ep[] = {2024, 1, 1, 0, 0, 0}, erpv[5] = {0}, err[3], emax[3] = {0}, dt, t1, t2;
+    gtime_t t0 = epoch2time(ep);
+    clock_t c;
+    int i, j, k, nep = argc > 1 ? atoi(argv[1]) : 200;
+
+    rr[0] = -2.0E6;
+    rr[1] = 5.0E6;
+    rr[2] = 3.0E6;
+    for (i = 0; i < NSAT; i++)
+    {
+        rs[i * 6] = 2.6E7 * cos(i * 0.3);
+        rs[i * 6 + 1] = 2.6E7 * sin(i * 0.3);
+        rs[i * 6 + 2] = 1.0E6 * i;
+        rs[i * 6 + 3] = -3.0E3 * sin(i * 0.3);
+        rs[i * 6 + 4] = 3.0E3 * cos(i * 0.3);
+        rs[i * 6 + 5] = 500.0;
+    }
+    /* epoch order */
+    c = clock();
+    for (k = 0; k < nep; k++)
+        for (i = 0; i < NSAT; i++)
+            satmodel(t0, k, i);
+    t1 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    /* interleaved epochs */
+    c = clock();
+    for (k = 0; k < nep; k += 2)
+        for (i = 0; i < NSAT; i++)
+        {
+            satmodel(t0, k, i);
+            satmodel(t0, k + 1, i);
+        }
+    t2 = (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    /* worst error of cached position at off-grid times (t0+0.01,...,0.25 s) */
+    erpv[2] = 0.0123;
+    for (k = 0; k < nep; k++)
+        for (j = 1; j <= 25; j++)
+        {
+            dt = k * 30.0 + j * 0.01;
+            cacheerr(timeadd(t0, dt), erpv, err);
+            for (i = 0; i < 3; i++)
+            {
+                if (err[i] > emax[i])
+                    emax[i] = err[i];
+            }
+        }
+
+    printf("satellites=%d epochs=%d\n", NSAT, nep);
+    printf("epoch order : %8.3f ms (%6.2f us/sat)\n", t1 * 1E3, t1 * 1E6 / NSAT / nep);
+    printf("interleaved : %8.3f ms (%6.2f us/sat) ratio=%.2f\n", t2 * 1E3, t2 * 1E6 / NSAT / nep, t2 / t1);
+    printf("cache error : sun=%.3e rad moon=%.3e rad gmst=%.3e rad (max, threshold=%.0e rad) %s\n", emax[0],
+           emax[1], emax[2], THRES, emax[0] < THRES && emax[1] < THRES ? "OK" : "NG");
+    return emax[0] < THRES && emax[1] < THRES ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+/*------------------------------------------------------------------------------
+ * symbench.c : regression test and micro-benchmark of symmetric ekf products
+ *
+ * compare symmul() with matmul() for all transpose flags and beta values, and
+ * filter() with the former Joseph form update by full matmul() products on
+ * random symmetric positive definite covariances with diagonal (sequential
+ * update) and correlated (batch update) measurement noise, then time both
+ *
+ * usage : symbench [ntest]
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define THRES 1E-10 /* threshold of relative difference */
+
+/* uniform random number in [-1,1] -------------------------------------------*/
+static double urand(void)
+{
+    return 2.0 * rand() / RAND_MAX - 1.0;
+}
+/* random matrix -------------------------------------------------------------*/
+static void randmat(double *A, int n, int m)
+{
+    int i;
+
+    for (i = 0; i < n * m; i++)
+        A[i] = urand();
+}
+/* random symmetric positive definite matrix (A*A'+n*I) ----------------------*/
+static void randspd(double *P, int n, double scale)
+{
+    double *A = mat(n, n);
+    int i;
+
+    randmat(A, n, n);
+    matmul("NT", n, n, n, scale, A, A, 0.0, P);
+    for (i = 0; i < n; i++)
+        P[i + i * n] += scale * n;
+    free(A);
+}
+/* max relative difference of matrices ---------------------------------------*/
+static double maxdiff(const double *A, const double *B, int n)
+{
+    double d = 0.0, a = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (fabs(A[i] - B[i]) > d)
+            d = fabs(A[i] - B[i]);
+        if (fabs(A[i]) > a)
+            a = fabs(A[i]);
+    }
+    return a > 0.0 ? d / a : d;
+}
+/* former filter_() by full matmul() products --------------------------------*/
+static int filter_ref_(const double *x, const double *P, const double *H, const double *v, const double *R, int n,
+                       int m, double *xp, double *Pp)
+{
+    double *F = mat(n, m), *Q = mat(m, m), *K = mat(n, m), *I = eye(n), *P1 = mat(n, n), *P2 = mat(n, n),
+           *R1 = mat(n, m);
+    int info;
+
+    matcpy(Q, R, m, m);
+    matcpy(xp, x, n, 1);
+    matmul("NN", n, m, n, 1.0, P, H, 0.0, F); /* Q=H'*P*H+R */
+    matmul("TN", m, m, n, 1.0, H, F, 1.0, Q);
+    if (!(info = matinv(Q, m)))
+    {
+        matmul("NN", n, m, m, 1.0, F, Q, 0.0, K);  /* K=P*H*Q^-1 */
+        matmul("NN", n, 1, m, 1.0, K, v, 1.0, xp); /* xp=x+K*v */
+        matmul("NT", n, n, m, -1.0, K, H, 1.0, I); /* Pp=(I-K*H')*P */
+        matmul("NN", n, n, n, 1.0, I, P, 0.0, P1);
+        matmul("NT", n, n, n, 1.0, P1, I, 0.0, P2); /* P2=(I-K*H')*P*(I-K*H')' */
+        matcpy(Pp, P2, n, n);
+        matmul("NN", n, m, m, 1.0, K, R, 0.0, R1);  /* R1=K*R */
+        matmul("NT", n, n, m, 1.0, R1, K, 1.0, Pp); /* Pp=P2+K*R*K' */
+    }
+    free(F);
+    free(Q);
+    free(K);
+    free(I);
+    free(P1);
+    free(P2);
+    free(R1);
+    return info;
+}
+/* former filter() -----------------------------------------------------------*/
+static int filter_ref(double *x, double *P, const double *H, const double *v, const double *R, int n, int m)
+{
+    double *x_, *xp_, *P_, *Pp_, *H_;
+    int i, j, k, info, *ix;
+
+    ix = imat(n, 1);
+    for (i = k = 0; i < n; i++)
+        if (x[i] != 0.0 && P[i + i * n] > 0.0)
+            ix[k++] = i;
+    x_ = mat(k, 1);
+    xp_ = mat(k, 1);
+    P_ = mat(k, k);
+    Pp_ = mat(k, k);
+    H_ = mat(k, m);
+    for (i = 0; i < k; i++)
+    {
+        x_[i] = x[ix[i]];
+        for (j = 0; j < k; j++)
+            P_[i + j * k] = P[ix[i] + ix[j] * n];
+        for (j = 0; j < m; j++)
+            H_[i + j * k] = H[ix[i] + j * n];
+    }
+    info = filter_ref_(x_, P_, H_, v, R, k, m, xp_, Pp_);
+    for (i = 0; i < k; i++)
+    {
+        x[ix[i]] = xp_[i];
+        for (j = 0; j < k; j++)
+            P[ix[i] + ix[j] * n] = Pp_[i + j * k];
+    }
+    free(ix);
+    free(x_);
+    free(xp_);
+    free(P_);
+    free(Pp_);
+    free(H_);
+    return info;
+}
+/* compare symmul() with matmul() --------------------------------------------
+ * symmetric C=op(A)*op(B)=X*S*X' with X (n x m), S (m x m) and Y=X*S
+ *----------------------------------------------------------------------------*/
+static double testsymmul(int n, int m, int *bad)
+{
+    static const char *tr[] = {"NT", "NN", "TN", "TT"};
+    static const double beta[] = {0.0, 1.0, 0.5};
+    double *X = mat(n, m), *Xt = mat(m, n), *Y = mat(n, m), *Yt = mat(m, n), *S = mat(m, m), *C0 = mat(n, n);
+    double *C1 = mat(n, n), *C2 = mat(n, n), d, dmax = 0.0;
+    const double *A, *B;
+    int i, j, k;
+
+    randmat(X, n, m);
+    randspd(S, m, 1.0);
+    randspd(C0, n, 1.0);
+    for (k = 0; k < 2; k++)
+    {
+        /* k=0: C=X*X' (syrk), k=1: C=(X*S)*X' (symm) */
+        if (k == 0)
+            matcpy(Y, X, n, m);
+        else
+            matmul("NN", n, m, m, 1.0, X, S, 0.0, Y);
+        for (i = 0; i < n; i++)
+            for (j = 0; j < m; j++)
+            {
+                Xt[j + i * m] = X[i + j * n];
+                Yt[j + i * m] = Y[i + j * n];
+            }
+        for (i = 0; i < 4; i++)
+        {
+            A = tr[i][0] == 'N' ? Y : Yt;
+            B = tr[i][1] == 'T' ? X : Xt;
+            for (j = 0; j < 3; j++)
+            {
+                matcpy(C1, C0, n, n);
+                matcpy(C2, C0, n, n);
+                matmul(tr[i], n, n, m, 1.3, A, B, beta[j], C1);
+                symmul(tr[i], n, m, 1.3, A, B, beta[j], C2);
+                if ((d = maxdiff(C1, C2, n * n)) > dmax)
+                    dmax = d;
+                if (d > THRES)
+                {
+                    printf("symmul mismatch : tr=%s n=%d m=%d beta=%.1f diff=%.3e\n", tr[i], n, m, beta[j], d);
+                    (*bad)++;
+                }
+            }
+        }
+    }
+    free(X);
+    free(Xt);
+    free(Y);
+    free(Yt);
+    free(S);
+    free(C0);
+    free(C1);
+    free(C2);
+    return dmax;
+}
+/* compare filter() with former filter() -------------------------------------*/
+static double testfilter(int n, int m, int diag, int *bad, double *t1, double *t2)
+{
+    double *x = mat(n, 1), *x1 = mat(n, 1), *x2 = mat(n, 1), *P = mat(n, n), *P1 = mat(n, n), *P2 = mat(n, n);
+    double *H = zeros(n, m), *v = mat(m, 1), *R = mat(m, m), d, dmax;
+    clock_t c;
+    int i, j, info1, info2;
+
+    randspd(P, n, 0.1);
+    for (i = 0; i < n; i++)
+    {
+        x[i] = i % 7 == 3 ? 0.0 : 1.0 + urand(); /* inactive states */
+    }
+    for (j = 0; j < m; j++)
+    {
+        for (i = 0; i < n; i++)
+            if (i < 4 || rand() % 4 == 0)
+                H[i + j * n] = urand();
+        v[j] = urand();
+    }
+    if (diag)
+    {
+        for (i = 0; i < m * m; i++)
+            R[i] = 0.0;
+        for (j = 0; j < m; j++)
+            R[j + j * m] = 0.01 + 0.1 * fabs(urand());
+    }
+    else
+    {
+        randspd(R, m, 0.01);
+    }
+    matcpy(x1, x, n, 1);
+    matcpy(x2, x, n, 1);
+    matcpy(P1, P, n, n);
+    matcpy(P2, P, n, n);
+
+    c = clock();
+    info1 = filter_ref(x1, P1, H, v, R, n, m);
+    *t1 += (double)(clock() - c) / CLOCKS_PER_SEC;
+    c = clock();
+    info2 = filter(x2, P2, H, v, R, n, m);
+    *t2 += (double)(clock() - c) / CLOCKS_PER_SEC;
+
+    dmax = maxdiff(x1, x2, n);
+    if ((d = maxdiff(P1, P2, n * n)) > dmax)
+        dmax = d;
+    for (j = 0; j < n; j++)
+        for (i = 0; i < j; i++)
+            if (P2[i + j * n] != P2[j + i * n])
+                dmax = 1.0; /* asymmetric */
+    if (info1 || info2 || dmax > THRES)
+    {
+        printf("filter mismatch : n=%d m=%d R=%s info=%d/%d diff=%.3e\n", n, m, diag ? "diag" : "full", info1, info2,
+               dmax);
+        (*bad)++;
+    }
+    free(x);
+    free(x1);
+    free(x2);
+    free(P);
+    free(P1);
+    free(P2);
+    free(H);
+    free(v);
+    free(R);
+    return dmax;
+}
+int main(int argc, char **argv)
+{
+    static const int ns[] = {1, 3, 8, 17, 40, 64, 90}, ms[] = {1, 4, 12, 30, 60};
+    double d, ds = 0.0, df[2] = {0}, t1[2] = {0}, t2[2] = {0};
+    int i, j, k, diag, ntest = argc > 1 ? atoi(argv[1]) : 3, bad = 0, nt = 0;
+
+    srand(1);
+    for (k = 0; k < ntest; k++)
+        for (i = 0; i < 7; i++)
+            for (j = 0; j < 5; j++)
+            {
+                if ((d = testsymmul(ns[i], ms[j], &bad)) > ds)
+                    ds = d;
+                for (diag = 0; diag < 2; diag++)
+                {
+                    if ((d = testfilter(ns[i], ms[j], diag, &bad, t1 + diag, t2 + diag)) > df[diag])
+                        df[diag] = d;
+                }
+                nt++;
+            }
+    printf("tests   : %d (symmul 2 products x 4 tr x 3 beta, filter diag/full R)\n", nt);
+    printf("symmul  : max diff=%.3e\n", ds);
+    printf("filter  : diag R max diff=%.3e former=%.3f s new=%.3f s speedup=%.1f\n", df[1], t1[1], t2[1],
+           t2[1] > 0.0 ? t1[1] / t2[1] : 0.0);
+    printf("filter  : full R max diff=%.3e former=%.3f s new=%.3f s speedup=%.1f\n", df[0], t1[0], t2[0],
+           t2[0] > 0.0 ? t1[0] / t2[0] : 0.0);
+    printf("check   : mismatch=%d\n", bad);
+    return bad ? 1 : 0;
+}
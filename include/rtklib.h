@@ -54,6 +54,12 @@ extern "C"
 #define EXPORT __declspec(dllexport) /* for Windows DLL */
 #else
 #define EXPORT
+#endif
+
+#ifdef WIN32
+#define THREADLOCAL __declspec(thread) /* thread-local storage */
+#else
+#define THREADLOCAL __thread
 #endif
 
     /* constants -----------------------------------------------------------------*/
@@ -232,6 +238,7 @@ extern "C"
 #define MAXSTA 255
 
 #ifndef MAXOBS
+#define NCHEB 10  /* degree of chebyshev polynomial of precise orbit */
 #define MAXOBS 96 /* max number of obs in an epoch */ // 2021-1-9 64->70
 #endif
 #define MAXRCV 200 /* max receiver number (1 to MAXRCV) */ // 2021-5-24 150->400
@@ -415,6 +422,9 @@ extern "C"
 #define TROPOPT_ESTG 4 /* troposphere option: ZTD+grad estimation */
 #define TROPOPT_ZTD 5  /* troposphere option: ZTD correction */
 
+#define ROBUST_OFF 0  /* robust filter update: off */
+#define ROBUST_IGG3 1 /* robust filter update: IGG-III reweighting */
+
 #define EPHOPT_BRDC 0   /* ephemeris option: broadcast ephemeris */
 #define EPHOPT_PREC 1   /* ephemeris option: precise ephemeris */
 #define EPHOPT_SBAS 2   /* ephemeris option: broadcast + SBAS */
@@ -691,6 +701,22 @@ typedef struct
         float vco[MAXSAT][3];  /* satellite velocity covariance (m^2) */
     } peph_t;
 
+    typedef struct
+    {                              /* precise orbit chebyshev segment type */
+        gtime_t t0;                /* center time of fitted window (GPST) */
+        double h;                  /* half span of fitted window (s) */
+        double ts, te;             /* start/end of segment relative to t0 (s) */
+        double coef[3][NCHEB + 1]; /* chebyshev coefficients of position (ecef at t0) (m) */
+    } pephseg_t;
+
+    typedef struct
+    {                        /* precise orbit chebyshev fit type */
+        int ne;              /* number of fitted precise ephemeris (0:none) */
+        gtime_t time;        /* time of first fitted precise ephemeris */
+        int off[MAXSAT + 1]; /* offset of satellite in segments (seg[off[sat-1]]..seg[off[sat]-1]) */
+        pephseg_t *seg;      /* segments sorted by satellite and time */
+    } pephfit_t;
+
     typedef struct
     {                          /* precise clock type */
         gtime_t time;          /* time (GPST) */
@@ -699,6 +725,30 @@ typedef struct
         float std[MAXSAT][1];  /* satellite clock std (s) */
     } pclk_t;
 
+    typedef struct
+    {                     /* compact precise ephemeris type */
+        int ne, ns;       /* number of epochs/satellites */
+        gtime_t *time;    /* epoch time (GPST) */
+        int *index;       /* ephemeris index for multiple files */
+        int slot[MAXSAT]; /* slot of satellite (-1:none) */
+        double *pos;      /* satellite position/clock (ecef) (m|s) {pos[(slot*ne+i)*4+j]} */
+        float *std;       /* satellite position/clock std (m|s) (NULL:none) */
+        double *vel;      /* satellite velocity/clk-rate (m/s|s/s) (NULL:none) */
+        float *vst;       /* satellite velocity/clk-rate std (m/s|s/s) (NULL:none) */
+        float *cov;       /* satellite position covariance (m^2) {cov[(slot*ne+i)*3+j]} (NULL:none) */
+        float *vco;       /* satellite velocity covariance (m^2) (NULL:none) */
+    } pephc_t;
+
+    typedef struct
+    {                     /* compact precise clock type */
+        int nc, ns;       /* number of epochs/satellites */
+        gtime_t *time;    /* epoch time (GPST) */
+        int *index;       /* clock index for multiple files */
+        int slot[MAXSAT]; /* slot of satellite (-1:none) */
+        double *clk;      /* satellite clock (s) {clk[slot*nc+i]} */
+        float *std;       /* satellite clock std (s) (NULL:none) */
+    } pclkc_t;
+
     typedef struct
     {                    /* SBAS ephemeris type */
         int sat;         /* satellite number */
@@ -913,6 +963,28 @@ typedef struct
         stec_t *data; /* stec data */
     } corrstec_t;
 
+    typedef struct
+    {                        /* per-satellite ephemeris index type */
+        int n;               /* number of indexed ephemeris (0:none) */
+        int off[MAXSAT + 1]; /* offset of satellite in index (idx[off[sat-1]]..idx[off[sat]-1]) */
+        int *idx;            /* index of ephemeris sorted by satellite and toe */
+    } ephidx_t;
+
+    typedef struct
+    {                   /* precomputed satellite states type */
+        int ephopt;     /* ephemeris option (EPHOPT_???) */
+        int n, ne;      /* number of records/epochs (ne=0: not available) */
+        gtime_t *time;  /* epoch time {time[k]} */
+        int *rcv;       /* receiver of epoch {rcv[k]} */
+        int *off;       /* records of epoch {off[k]..off[k+1]-1} */
+        int *sat;       /* satellite number of record {sat[i]} */
+        double *pr;     /* pseudorange for transmission time (m) {pr[i]} */
+        double *rs;     /* satellite position/velocity (ecef) {rs[i*6+j]} (m|m/s) */
+        double *dts;    /* satellite clock bias/drift {dts[i*2+j]} (s|s/s) */
+        double *var;    /* satellite position and clock variance (m^2) {var[i]} */
+        int *svh;       /* satellite health flag {svh[i]} */
+    } satsto_t;
+
     typedef struct
     {                      /* navigation data type */
         int n, nmax;       /* number of broadcast ephemeris */
@@ -927,8 +999,11 @@ typedef struct
         eph_t *eph;        /* GPS/QZS/GAL ephemeris */
         geph_t *geph;      /* GLONASS ephemeris */
         seph_t *seph;      /* SBAS ephemeris */
-        peph_t *peph;      /* precise ephemeris */
-        pclk_t *pclk;      /* precise clock */
+        peph_t *peph;      /* precise ephemeris (while reading) */
+        pclk_t *pclk;      /* precise clock (while reading) */
+        pephc_t pe;        /* compact precise ephemeris */
+        pclkc_t pc;        /* compact precise clock */
+        const satsto_t *sto; /* precomputed satellite states (NULL: none) */
         alm_t *alm;        /* almanac data */
         tec_t *tec;        /* tec grid data */
         fcbd_t *fcb;       /* satellite fcb data */
@@ -959,6 +1034,8 @@ typedef struct
         int nstec, ntrop;
         corrtrop_t corrtrop[25];
         corrstec_t corrstec[25];
+        ephidx_t ie, ig; /* per-satellite index of broadcast/glonass ephemeris */
+        pephfit_t pf;    /* chebyshev fit of precise orbit */
     } nav_t;
 
     typedef struct
@@ -1089,6 +1166,35 @@ typedef struct
         char opt[256];               /* rinex dependent options */
     } rnxctr_t;
 
+    typedef struct
+    {                         /* binary observation container type */
+        const uint8_t *p;     /* mapped container */
+        size_t size;          /* size of container (bytes) */
+        int ne, nsig;         /* number of epochs/signals */
+        const uint8_t *index; /* epoch index table (in container) */
+        const uint8_t *sig;   /* signal table (in container) */
+        sta_t sta;            /* station parameters */
+        int ie;               /* index of next epoch to read */
+        int id;               /* index of last decoded epoch */
+        int64_t *val;         /* decoded values of signals */
+        uint16_t *vmask;      /* valid decoded values of signals */
+        int *iep;             /* last decoded epoch of signals */
+    } obc_t;
+
+    typedef struct
+    {                                 /* observation epoch stream type */
+        rnxctr_t rnx;                 /* rinex control (rnx.obs: current epoch) */
+        obc_t obc;                    /* binary obs container (obc.p==NULL: rinex) */
+        FILE *fp;                     /* rinex obs file pointer */
+        char path[1024];              /* rinex obs file path (wild-card * expanded) */
+        char tmpfile[1024];           /* uncompressed temporary file ("":none) */
+        int ifile;                    /* index of current expanded file */
+        int rcv;                      /* receiver number */
+        gtime_t ts, te;               /* time start/end */
+        double tint;                  /* time interval (s) */
+        uint8_t slips[MAXSAT][NFREQ]; /* cycle-slips of screened epochs */
+    } obsstr_t;
+
     typedef struct
     {                    /* download url type */
         char type[32];   /* data type */
@@ -1175,6 +1281,11 @@ typedef struct
         int posopt[9];                /* positioning options */
         double odisp[2][6 * 11];      /* ocean tide loading parameters {rov,base} */
         exterr_t exterr;              /* extended receiver error model */
+        int nslot;                    /* number of per-satellite ppp state slots (0:one per satellite) */
+        int orbfit;                   /* precise orbit fit option (0:lagrange,1:chebyshev) */
+        int robust;                   /* robust filter update (ROBUST_???) */
+        double robthres[2];           /* robust update thresholds of standardized innovation {k0,k1} */
+        int satpre;                   /* threads of satellite state precomputation (0:off) */
     } prcopt_t;
 
     typedef struct
@@ -1226,6 +1337,7 @@ typedef struct
         char outdir[MAXSTRPATH];
         char outfile1[MAXSTRPATH];
         char outfile2[MAXSTRPATH];
+        char cachedir[MAXSTRPATH]; /* product/obs cache directory ("":no cache) */
     } filopt_t;
 
     typedef struct
@@ -1307,6 +1419,31 @@ typedef struct
         double prev_dts[2];
     } ssat_t;
 
+    typedef struct
+    {                    /* sparse matrix type (compressed sparse row) */
+        int m, nnz;      /* number of rows/non-zero elements */
+        int mmax, nzmax; /* allocated number of rows/non-zero elements */
+        int *rp;         /* index of first element of rows (m+1 x 1) */
+        int *ci;         /* column index of elements (nnz x 1) */
+        double *val;     /* values of elements (nnz x 1) */
+    } spmat_t;
+
+    typedef struct
+    {                       /* kalman filter workspace type */
+        int nmax, nxmax;    /* allocated number of compressed/full states */
+        double *x, *P;      /* compressed states/packed covariance */
+        double *F, *dx;     /* work vectors */
+        double *x0, *P0;    /* snapshot of compressed states/packed covariance */
+        const int *ix;      /* index of active states of snapshot */
+        int k;              /* number of active states of snapshot */
+        double rob[2];      /* robust update thresholds {k0,k1} (k0<=0:off) */
+        double *w;          /* robust weight factors of measurements (0:rejected) */
+        int mmax;           /* allocated number of measurements */
+        int nrob[2];        /* number of downweighted/rejected measurements */
+        int *jx;            /* compressed index of full states (-1:inactive) */
+        spmat_t H;          /* compressed design matrix */
+    } filtws_t;
+
     typedef struct
     {                                                            /* RTK control/result type */
         sol_t sol;                                               /* RTK solution */
@@ -1322,6 +1459,12 @@ typedef struct
         prcopt_t opt;                                            /* processing options */
         double dr[3];                                            /* earth tides correction */
         uint8_t reset;                                           /* reset pos & vel & acc & trp flag */
+        int slot[MAXSAT];                                        /* ppp state slot of satellite (0:none) */
+        int *ix, nix;                                            /* index/number of active float states */
+        filtws_t ws;                                             /* kalman filter workspace */
+        int niter;                                               /* number of filter iterations of last epoch */
+        int nrob[2];                                             /* downweighted/rejected obs by robust update */
+        int nsave;                                               /* robust filter re-runs skipped (no pos-fit rejection) */
     } rtk_t;
 
     typedef struct
@@ -1521,6 +1664,13 @@ typedef struct
     EXPORT int *imat(int n, int m);
     EXPORT double *zeros(int n, int m);
     EXPORT double *eye(int n);
+    EXPORT void *arenamark(void);
+    EXPORT void arenarelease(void *mark);
+    EXPORT void arenastat(size_t *peak, size_t *size);
+    EXPORT double *amat(int n, int m);
+    EXPORT int *aimat(int n, int m);
+    EXPORT double *azeros(int n, int m);
+    EXPORT double *aeye(int n);
     EXPORT double dot(const double *a, const double *b, int n);
     EXPORT double norm(const double *a, int n);
     EXPORT void cross3(const double *a, const double *b, double *c);
@@ -1531,10 +1681,29 @@ typedef struct
     EXPORT void Linv(double *L, int n);
     EXPORT void matmul(const char *tr, int n, int k, int m, double alpha, const double *A, const double *B, double beta,
                        double *C);
+    EXPORT void symmul(const char *tr, int n, int m, double alpha, const double *A, const double *B, double beta,
+                       double *C);
     EXPORT int matinv(double *A, int n);
     EXPORT int solve(const char *tr, const double *A, const double *Y, int n, int m, double *X);
     EXPORT int lsq(const double *A, const double *y, int n, int m, double *x, double *Q);
+    EXPORT void spclear(spmat_t *A);
+    EXPORT void spadd(spmat_t *A, int j, double a);
+    EXPORT void sprow(spmat_t *A);
+    EXPORT void spdrop(spmat_t *A);
+    EXPORT void spkeep(spmat_t *A, const int *flag);
+    EXPORT void spfree(spmat_t *A);
     EXPORT int filter(double *x, double *P, const double *H, const double *v, const double *R, int n, int m);
+    EXPORT int filterd(double *x, double *P, const double *H, const double *v, const double *r, int n, int m);
+    EXPORT int filterix(double *x, double *P, const double *H, const double *v, const double *r, int n, int m,
+                        const int *ix, int k, filtws_t *ws);
+    EXPORT void freefiltws(filtws_t *ws);
+    EXPORT int filterspix(double *x, double *P, const spmat_t *H, const double *v, const double *r, int n, int m,
+                          const int *ix, int k, filtws_t *ws);
+    EXPORT int filtersp(double *x, double *P, const spmat_t *H, const double *v, const double *R, int n, int m);
+    EXPORT void filterbegin(const double *x, const double *P, int n, const int *ix, int k, filtws_t *ws);
+    EXPORT int filterstep(double *x, const spmat_t *H, const double *v, const double *r, const int *rf, int n, int m,
+                          filtws_t *ws);
+    EXPORT void filtercommit(double *P, int n, filtws_t *ws);
     EXPORT int smoother(const double *xf, const double *Qf, const double *xb, const double *Qb, int n, double *xs,
                         double *Qs);
     EXPORT void matprint(const double *A, int n, int m, int p, int q);
@@ -1604,6 +1773,16 @@ typedef struct
                            stas_t *stas);
     EXPORT void freeproduct(nav_t *nav, pcvs_t *pcvs, pcvs_t *pcvr, stas_t *stas);
     EXPORT int readobs(const char *infile, int rcv, const prcopt_t *prcopt, obs_t *obs, sta_t *sta, int *nepoch);
+    EXPORT int readobsw(obsstr_t *str, int nstr, int nep, obs_t *obs);
+
+    /* binary observation container functions ---------------------------------*/
+    EXPORT int writeobc(const char *file, const obs_t *obs, const sta_t *sta);
+    EXPORT int readobc(const char *file, int rcv, const prcopt_t *popt, obs_t *obs, sta_t *sta, int *nepoch);
+    EXPORT int open_obc(obc_t *obc, const char *file);
+    EXPORT void close_obc(obc_t *obc);
+    EXPORT int seek_obc(obc_t *obc, gtime_t time);
+    EXPORT int read_obc(obc_t *obc, obsd_t *data, int nmax);
+    EXPORT int cacheobc(const char *dir, const char *file, const char *opt, char *path);
     EXPORT int readstas(const char *file, stas_t *stas);
     EXPORT void freestas(stas_t *stas);
     EXPORT void readsnx(const char *snxfile, const char *infile, const char *outfile);
@@ -1627,6 +1806,8 @@ typedef struct
     EXPORT int execcmd(const char *cmd);
     EXPORT int expath(const char *path, char *paths[], int nmax);
     EXPORT void createdir(const char *path);
+    EXPORT int filestat(const char *path, int64_t *mtime, int64_t *size);
+    EXPORT void cachepath(const char *dir, const char *path, const char *ext, char *file);
 
     /* positioning models --------------------------------------------------------*/
     EXPORT double satazel(const double *pos, const double *e, double *azel);
@@ -1654,6 +1835,7 @@ typedef struct
 
     /* earth tide models ---------------------------------------------------------*/
     EXPORT void sunmoonpos(gtime_t tutc, const double *erpv, double *rsun, double *rmoon, double *gmst);
+    EXPORT void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon);
     EXPORT void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp, const double *odisp, double *dr);
 
     /* geiod models --------------------------------------------------------------*/
@@ -1671,6 +1853,7 @@ typedef struct
     EXPORT int readrnxt(const char *file, int rcv, gtime_t ts, gtime_t te, double tint, const char *opt, obs_t *obs,
                         nav_t *nav, sta_t *sta);
     EXPORT int readrnxc(const char *file, nav_t *nav);
+    EXPORT int addobsdata(obs_t *obs, const obsd_t *data);
     EXPORT int outrnxobsh(FILE *fp, const rnxopt_t *opt, const nav_t *nav);
     EXPORT int outrnxobsb(FILE *fp, const rnxopt_t *opt, const obsd_t *obs, int n, int epflag);
     EXPORT int outrnxnavh(FILE *fp, const rnxopt_t *opt, const nav_t *nav);
@@ -1684,11 +1867,16 @@ typedef struct
     EXPORT int outrnxgnavb(FILE *fp, const rnxopt_t *opt, const geph_t *geph);
     EXPORT int outrnxhnavb(FILE *fp, const rnxopt_t *opt, const seph_t *seph);
     EXPORT int rtk_uncompress(const char *file, char *uncfile);
+    EXPORT FILE *rtk_fopen(const char *file, char *tmpfile);
     EXPORT int convrnx(int format, rnxopt_t *opt, const char *file, char **ofile);
     EXPORT int init_rnxctr(rnxctr_t *rnx);
     EXPORT void free_rnxctr(rnxctr_t *rnx);
     EXPORT int open_rnxctr(rnxctr_t *rnx, FILE *fp);
     EXPORT int input_rnxctr(rnxctr_t *rnx, FILE *fp);
+    EXPORT int open_obsstr(obsstr_t *str, const char *file, int rcv, gtime_t ts, gtime_t te, double tint,
+                           const char *opt);
+    EXPORT int next_obsstr(obsstr_t *str);
+    EXPORT void close_obsstr(obsstr_t *str);
 
     /* ephemeris and clock functions ---------------------------------------------*/
     EXPORT double eph2clk(gtime_t time, const eph_t *eph);
@@ -1696,17 +1884,29 @@ typedef struct
     EXPORT double seph2clk(gtime_t time, const seph_t *seph);
     EXPORT double uravalue(int ura, int sys);
     EXPORT void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts, double *var);
+    EXPORT void eph2posb(const gtime_t *time, const eph_t *const *eph, int n, double *rs, double *dts, double *var);
     EXPORT void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts, double *var);
     EXPORT void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts, double *var);
     EXPORT int peph2pos(gtime_t time, int sat, const nav_t *nav, int opt, double *rs, double *dts, double *var);
     EXPORT void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav, double *dant);
     EXPORT int satpos(gtime_t time, gtime_t teph, int sat, int ephopt, const nav_t *nav, double *rs, double *dts,
                       double *var, int *svh);
+    EXPORT int satprecomp(const obs_t *obs, const nav_t *nav, int ephopt, int nthread, satsto_t *sto);
+    EXPORT void freesatsto(satsto_t *sto);
     EXPORT void satposs(gtime_t time, const obsd_t *obs, int n, const nav_t *nav, int sateph, double *rs, double *dts,
                         double *var, int *svh);
     EXPORT void setseleph(int sys, int sel);
     EXPORT int getseleph(int sys);
+    EXPORT void ephindex(nav_t *nav);
+    EXPORT void satcachestat(uint32_t *hit, uint32_t *miss);
     EXPORT void readsp3(const char *file, nav_t *nav, int opt);
+    EXPORT void fitpeph(nav_t *nav);
+    EXPORT int packpeph(nav_t *nav);
+    EXPORT int unpackpeph(nav_t *nav);
+    EXPORT void trimpeph(nav_t *nav, gtime_t ts, gtime_t te);
+    EXPORT int packpclk(nav_t *nav);
+    EXPORT int unpackpclk(nav_t *nav);
+    EXPORT void trimpclk(nav_t *nav, gtime_t ts, gtime_t te);
     EXPORT int readsap(const char *file, gtime_t time, nav_t *nav);
     EXPORT int readdcb(const char *file, nav_t *nav);
     EXPORT void alm2pos(gtime_t time, const alm_t *alm, double *rs, double *dts);
@@ -53,6 +53,7 @@ int CGNSSConfig::LoadYAML(const char *file)
             if (it["outfile2"])      strcpy(filopt.outfile2, it["outfile2"].as<std::string>().c_str());
             if (it["tracefile"])     strcpy(filopt.trace,    it["tracefile"].as<std::string>().c_str());
             if (it["geexefile"])     strcpy(filopt.geexe,    it["geexefile"].as<std::string>().c_str());
+            if (it["cachedir"])      strcpy(filopt.cachedir, it["cachedir"].as<std::string>().c_str());
         }
 
         if (first_layer->first.as<std::string>() == "gnss") {
@@ -74,6 +75,7 @@ int CGNSSConfig::LoadYAML(const char *file)
             if (it["pos1-ionoopt"])      prcopt.ionoopt  =   it["pos1-ionoopt"].as<int>();
             if (it["pos1-tropopt"])      prcopt.tropopt  =   it["pos1-tropopt"].as<int>();
             if (it["pos1-sateph"])       prcopt.sateph   =   it["pos1-sateph"].as<int>();
+            if (it["pos1-orbfit"])       prcopt.orbfit   =   it["pos1-orbfit"].as<int>();
             if (it["pos1-posopt"])       intcpy(prcopt.posopt,it["pos1-posopt"].as<std::vector<int>>().data(),9,1);
             if (it["pos1-exclsats"])     strcpy(exsats_,     it["pos1-exclsats"].as<std::string>().c_str());
             if (it["pos1-navsys"])       prcopt.navsys   =   it["pos1-navsys"].as<int>();
@@ -100,6 +102,11 @@ int CGNSSConfig::LoadYAML(const char *file)
             if (it["pos2-arthres"])      prcopt.threscheck[5]  = it["pos2-arthres"].as<double>();
             if (it["pos2-baselinelen"])  prcopt.baseline[0]    = it["pos2-baselinelen"].as<double>();
             if (it["pos2-baselinesig"])  prcopt.baseline[1]    = it["pos2-baselinesig"].as<double>();
+            if (it["pos2-nslot"])        prcopt.nslot    =   it["pos2-nslot"].as<int>();
+            if (it["pos2-satpre"])       prcopt.satpre   =   it["pos2-satpre"].as<int>();
+            if (it["pos2-robust"])       prcopt.robust   =   it["pos2-robust"].as<int>();
+            if (it["pos2-robk0"])        prcopt.robthres[0] = it["pos2-robk0"].as<double>();
+            if (it["pos2-robk1"])        prcopt.robthres[1] = it["pos2-robk1"].as<double>();
 
             if (it["pos3-armode"])       prcopt.modear   =   it["pos3-armode"].as<int>();
             if (it["pos3-artype"])       prcopt.typear   =   it["pos3-artype"].as<int>();
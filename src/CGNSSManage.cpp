@@ -267,8 +267,6 @@ static int screent(gtime_t time, gtime_t ts, gtime_t te)
 void removeUnusedData(gtime_t &ts, gtime_t &te, nav_t *nav, pcvs_t *pcvss, pcvs_t *pcvsr)
 {
     int i, k, ind, ii;
-    peph_t *nav_peph;
-    pclk_t *nav_pclk;
     stec_t *nav_stec;
     trop_t *nav_trop;
     gtime_t tss;
@@ -280,50 +278,15 @@ void removeUnusedData(gtime_t &ts, gtime_t &te, nav_t *nav, pcvs_t *pcvss, pcvs_
     /* 删除冗余的精密星历数据 */
     tss = timeadd(ts, -1500);
     tee = timeadd(te, 1500);
-    for (i = 0, k = 0; k < nav->ne; k++)
-    {
-        if (screent(nav->peph[k].time, tss, tee))
-        {
-            nav->peph[i++] = nav->peph[k];
-        }
-    }
-    nav->ne = i;
-    if (!(nav_peph = (peph_t *)realloc(nav->peph, sizeof(peph_t) * nav->ne)))
-    {
-        free(nav->peph);
-        nav->peph = NULL;
-        nav->ne = nav->nemax = 0;
-        trace(1, "combpeph malloc error ne=%d\n", nav->ne);
-    }
-    else
-    {
-        nav->peph = nav_peph;
-        nav->nemax = nav->ne;
-    }
+    trimpeph(nav, tss, tee);
+    /* 重新拟合切比雪夫轨道 */
+    if (nav->pf.seg)
+        fitpeph(nav);
 
     /* 删除冗余的精密钟差数据 */
     tss = timeadd(ts, -900);
     tee = timeadd(te, 900);
-    for (i = 0, k = 0; k < nav->nc; k++)
-    {
-        if (screent(nav->pclk[k].time, tss, tee))
-        {
-            nav->pclk[i++] = nav->pclk[k];
-        }
-    }
-    nav->nc = i;
-    if (!(nav_pclk = (pclk_t *)realloc(nav->pclk, sizeof(pclk_t) * nav->nc)))
-    {
-        free(nav->pclk);
-        nav->pclk = NULL;
-        nav->nc = nav->ncmax = 0;
-        trace(1, "combpclk malloc error nc=%d\n", nav->nc);
-    }
-    else
-    {
-        nav->pclk = nav_pclk;
-        nav->ncmax = nav->nc;
-    }
+    trimpclk(nav, tss, tee);
 
     /* 删除冗余的区域增强-对流层数据 */
     tss = timeadd(ts, -60);
@@ -0,0 +1,591 @@
+/*------------------------------------------------------------------------------
+ * crinex.c : compact rinex and compressed file input functions
+ *
+ * options : -DZLIB  use zlib for gzip-compressed files
+ *
+ * reference :
+ *     [1] Y.Hatanaka, A Compression Format and Tools for GNSS Observation
+ *         Data, Bulletin of the Geographical Survey Institute, 55, 21-30, 2008
+ *     [2] Y.Hatanaka, Compact RINEX Format and Tools (beta-test version for
+ *         RINEX 3.00), 2009
+ *
+ * version : $Revision:$
+ * history : 2026/10/16 1.0  new
+ *-----------------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include "rtklib.h"
+#ifdef ZLIB
+#include <zlib.h>
+#endif
+
+#define MAXCRXLEN 8192          /* max compact rinex record length */
+#define MAXCRXORD 9             /* max order of difference */
+#define MAXCRXSLOT 1000         /* number of satellite slots (system x 100) */
+#define CRXSYS " GRECJSI"       /* satellite system codes of slots */
+#define NCRXBUF 65536           /* size of input/output buffer */
+
+/* type definitions ----------------------------------------------------------*/
+typedef struct
+{                              /* differenced data type */
+    long long u[MAXCRXORD + 1]; /* differences of order 0-n (x 1000) */
+    int order;                 /* current order (-1:no data) */
+    int arc;                   /* arc order */
+} crxdif_t;
+
+typedef struct
+{                                 /* satellite state type */
+    int epoch;                    /* last epoch count */
+    crxdif_t d[MAXOBSTYPE];       /* obs data */
+    char flag[MAXOBSTYPE * 2 + 1]; /* lli and ssi flags */
+} crxsat_t;
+
+typedef struct
+{                                 /* compact rinex/compressed file stream type */
+#ifdef ZLIB
+    gzFile gz;                    /* input file (gzip or plain) */
+#else
+    FILE *fp;                     /* input file */
+#endif
+    int crx;                      /* compact rinex version (0:not compact,1,3) */
+    int head;                     /* in header */
+    int epoch;                    /* epoch count */
+    int ntype;                    /* number of obs types (rinex 2) */
+    int ntypes[128];              /* number of obs types by system (rinex 3) */
+    int sys;                      /* system code of obs types record */
+    char ibuf[NCRXBUF];           /* input buffer */
+    int ni, pi;                   /* input bytes/read position */
+    char line[MAXCRXLEN];         /* input record */
+    char epln[MAXCRXLEN];         /* current epoch record */
+    crxdif_t clk;                 /* receiver clock offset */
+    crxsat_t *sat[MAXCRXSLOT];    /* satellite states */
+    char *buff;                   /* output buffer */
+    int nb, nbmax, pb;            /* output bytes/allocated/read position */
+    int pend;                     /* pending first record */
+} crxstr_t;
+
+/* read input bytes ----------------------------------------------------------*/
+static int crxread_in(crxstr_t *str, char *buff, int size)
+{
+    int n;
+
+#ifdef ZLIB
+    n = gzread(str->gz, buff, (unsigned int)size);
+#else
+    n = (int)fread(buff, 1, (size_t)size, str->fp);
+#endif
+    return n > 0 ? n : 0;
+}
+/* read input record (without new line) --------------------------------------*/
+static int crxgets(crxstr_t *str)
+{
+    char *p, *q;
+    int n = 0, m;
+
+    if (str->pend)
+    {
+        str->pend = 0;
+        return 1;
+    }
+    while (n < MAXCRXLEN - 1)
+    {
+        if (str->pi >= str->ni)
+        {
+            str->pi = 0;
+            if ((str->ni = crxread_in(str, str->ibuf, NCRXBUF)) <= 0)
+            {
+                if (n <= 0)
+                    return 0;
+                break;
+            }
+        }
+        p = str->ibuf + str->pi;
+        m = str->ni - str->pi < MAXCRXLEN - 1 - n ? str->ni - str->pi : MAXCRXLEN - 1 - n;
+        q = (char *)memchr(p, '\n', m);
+        m = q ? (int)(q - p) : m;
+        memcpy(str->line + n, p, m);
+        n += m;
+        str->pi += m;
+        if (q)
+        {
+            str->pi++;
+            break;
+        }
+    }
+    if (n > 0 && str->line[n - 1] == '\r')
+        n--;
+    str->line[n] = '\0';
+    return 1;
+}
+/* add output ----------------------------------------------------------------*/
+static int crxput(crxstr_t *str, const char *s, int n)
+{
+    char *p;
+
+    if (str->nb + n + 1 > str->nbmax)
+    {
+        str->nbmax = str->nbmax <= 0 ? NCRXBUF : str->nbmax * 2;
+        if (str->nbmax < str->nb + n + 1)
+            str->nbmax = str->nb + n + 1;
+        if (!(p = (char *)realloc(str->buff, str->nbmax)))
+            return 0;
+        str->buff = p;
+    }
+    memcpy(str->buff + str->nb, s, n);
+    str->nb += n;
+    return 1;
+}
+/* add output record with tail spaces removed --------------------------------*/
+static int crxputl(crxstr_t *str, const char *s, int n)
+{
+    while (n > 0 && s[n - 1] == ' ')
+        n--;
+    return crxput(str, s, n) && crxput(str, "\n", 1);
+}
+/* repair string by differenced string ---------------------------------------*/
+static void repair(char *s, const char *ds)
+{
+    for (; *s && *ds; s++, ds++)
+    {
+        if (*ds != ' ')
+            *s = *ds == '&' ? ' ' : *ds;
+    }
+    if (!*ds)
+        return;
+    for (; *ds; s++, ds++)
+        *s = *ds == '&' ? ' ' : *ds;
+    *s = '\0';
+}
+/* decode differenced field --------------------------------------------------*/
+static int decdif(crxdif_t *d, const char *s)
+{
+    int i;
+
+    if (!*s)
+    {
+        d->order = -1; /* no data */
+        return 1;
+    }
+    if (s[1] == '&')
+    { /* arc initialization */
+        if ((d->arc = s[0] - '0') < 0 || d->arc > MAXCRXORD)
+            return 0;
+        d->order = 0;
+        d->u[0] = strtoll(s + 2, NULL, 10);
+        return 1;
+    }
+    if (d->order < 0)
+        return 0; /* not initialized */
+    if (d->order < d->arc)
+        d->order++;
+    d->u[d->order] = strtoll(s, NULL, 10);
+    for (i = d->order; i > 0; i--)
+        d->u[i - 1] += d->u[i];
+    return 1;
+}
+/* print scaled integer as fixed-point number (%w.decf) ---------------------*/
+static void putfix(char *p, int w, long long u, int dec)
+{
+    char str[32], *q = str + sizeof(str);
+    unsigned long long a = u < 0 ? -(unsigned long long)u : (unsigned long long)u;
+    int i;
+
+    for (i = 0; i < dec || a > 0 || i <= dec; i++)
+    {
+        if (i == dec)
+            *--q = '.';
+        *--q = (char)('0' + a % 10);
+        a /= 10;
+    }
+    if (u < 0)
+        *--q = '-';
+    for (i = w - (int)(str + sizeof(str) - q); i > 0; i--)
+        *p++ = ' ';
+    memcpy(p, q, str + sizeof(str) - q);
+    p[str + sizeof(str) - q] = '\0';
+}
+/* satellite state slot ------------------------------------------------------*/
+static crxsat_t *satslot(crxstr_t *str, const char *id)
+{
+    const char *p;
+    int i, prn;
+
+    if (!(p = strchr(CRXSYS, id[0])) || !*p || id[1] < ' ' || id[2] < '0' || id[2] > '9')
+        return NULL;
+    prn = (id[1] == ' ' ? 0 : id[1] - '0') * 10 + id[2] - '0';
+    if (prn < 0 || prn > 99)
+        return NULL;
+    i = (int)(p - CRXSYS) * 100 + prn;
+    if (!str->sat[i] && !(str->sat[i] = (crxsat_t *)calloc(1, sizeof(crxsat_t))))
+        return NULL;
+    return str->sat[i];
+}
+/* decode header record ------------------------------------------------------*/
+static void dechead(crxstr_t *str, const char *buff)
+{
+    const char *label = buff + 60;
+    int n;
+
+    if (strlen(buff) <= 60)
+        return;
+    if (strstr(label, "# / TYPES OF OBSERV"))
+    {
+        if ((n = (int)str2num(buff, 0, 6)) > 0)
+            str->ntype = n < MAXOBSTYPE ? n : MAXOBSTYPE;
+    }
+    else if (strstr(label, "SYS / # / OBS TYPES"))
+    {
+        if (buff[0] != ' ')
+            str->sys = (unsigned char)buff[0] & 0x7F;
+        if (buff[0] != ' ' && (n = (int)str2num(buff, 3, 3)) > 0)
+            str->ntypes[str->sys] = n < MAXOBSTYPE ? n : MAXOBSTYPE;
+    }
+    else if (strstr(label, "END OF HEADER"))
+        str->head = 0;
+}
+/* decode epoch of compact rinex ---------------------------------------------*/
+static int decepoch(crxstr_t *str)
+{
+    crxsat_t *s;
+    char *fld[MAXOBSTYPE], *dflag, *p, out[MAXCRXLEN], id[4] = "";
+    int i, j, k, n, nsat, ntype, flag, clk, pid, pf, v3 = str->crx == 3;
+
+    /* epoch record */
+    if ((v3 && str->line[0] == '>') || (!v3 && str->line[0] == '&'))
+    {
+        strcpy(str->epln, str->line);
+        if (!v3)
+            str->epln[0] = ' ';
+    }
+    else
+        repair(str->epln, str->line);
+
+    pf = v3 ? 31 : 28; /* position of epoch flag */
+    pid = v3 ? 41 : 32; /* position of satellite list */
+    if ((int)strlen(str->epln) <= pf + 3)
+    {
+        trace(2, "crinex invalid epoch: %s\n", str->epln);
+        return 0;
+    }
+    flag = str->epln[pf] - '0';
+    nsat = (int)str2num(str->epln, pf + 1, 3);
+    str->epoch++;
+
+    /* special event with header records */
+    if (flag > 1)
+    {
+        if (!crxputl(str, str->epln, v3 ? 35 : 32))
+            return 0;
+        for (i = 0; i < nsat && crxgets(str); i++)
+        {
+            if (!crxputl(str, str->line, (int)strlen(str->line)))
+                return 0;
+        }
+        return 1;
+    }
+    /* receiver clock offset */
+    if (!crxgets(str))
+        return 0;
+    if (!*str->line)
+        str->clk.order = -1;
+    else if (!decdif(&str->clk, str->line))
+    {
+        trace(2, "crinex clock not initialized: %s\n", str->epln);
+        str->clk.order = -1;
+    }
+    clk = str->clk.order >= 0;
+
+    /* output epoch record */
+    if (v3)
+    {
+        n = sprintf(out, "%-35.35s", str->epln);
+        if (clk)
+        {
+            n += sprintf(out + n, "      ");
+            putfix(out + n, 15, str->clk.u[0], 12);
+            n += (int)strlen(out + n);
+        }
+        if (!crxputl(str, out, n))
+            return 0;
+    }
+    else
+    {
+        for (i = 0; i < nsat || i == 0; i += 12)
+        {
+            n = sprintf(out, "%-32.32s", i == 0 ? str->epln : "");
+            for (j = i; j < i + 12 && j < nsat; j++)
+                n += sprintf(out + n, "%-3.3s", (int)strlen(str->epln) > pid + j * 3 ? str->epln + pid + j * 3 : "");
+            if (i == 0 && clk)
+            {
+                n += sprintf(out + n, "%*s", 68 - n, "");
+                putfix(out + n, 12, str->clk.u[0], 9);
+                n += (int)strlen(out + n);
+            }
+            if (!crxputl(str, out, n))
+                return 0;
+        }
+    }
+    /* observation data records */
+    for (i = 0; i < nsat; i++)
+    {
+        if (!crxgets(str))
+            return 0;
+        sprintf(id, "%-3.3s", (int)strlen(str->epln) > pid + i * 3 ? str->epln + pid + i * 3 : "");
+        if (!v3 && id[0] == ' ')
+            id[0] = 'G';
+        ntype = v3 ? str->ntypes[(unsigned char)id[0] & 0x7F] : str->ntype;
+
+        if (!(s = satslot(str, id)))
+        {
+            trace(2, "crinex invalid satellite: %s\n", id);
+            continue;
+        }
+        if (s->epoch != str->epoch - 1)
+        { /* new arc of satellite */
+            for (j = 0; j < MAXOBSTYPE; j++)
+                s->d[j].order = -1;
+            s->flag[0] = '\0';
+        }
+        s->epoch = str->epoch;
+
+        /* separate fields and flags */
+        for (j = 0, p = str->line; j < ntype; j++)
+        {
+            fld[j] = p;
+            while (*p && *p != ' ')
+                p++;
+            if (*p == ' ')
+                *p++ = '\0';
+        }
+        dflag = p;
+        repair(s->flag, dflag);
+
+        for (j = 0; j < ntype; j++)
+        {
+            if (!decdif(s->d + j, fld[j]))
+            {
+                trace(2, "crinex data not initialized: sat=%s type=%d\n", id, j);
+                s->d[j].order = -1;
+            }
+        }
+        /* output obs data record */
+        n = v3 ? sprintf(out, "%.3s", id) : 0;
+        k = (int)strlen(s->flag);
+        for (j = 0; j < ntype; j++)
+        {
+            if (!v3 && j > 0 && j % 5 == 0)
+            {
+                if (!crxputl(str, out, n))
+                    return 0;
+                n = 0;
+            }
+            if (s->d[j].order >= 0)
+                putfix(out + n, 14, s->d[j].u[0], 3);
+            else
+                sprintf(out + n, "%14s", "");
+            n += (int)strlen(out + n);
+            out[n++] = j * 2 < k ? s->flag[j * 2] : ' ';
+            out[n++] = j * 2 + 1 < k ? s->flag[j * 2 + 1] : ' ';
+        }
+        if (!crxputl(str, out, n))
+            return 0;
+    }
+    return 1;
+}
+/* decode next records to output buffer (0:end of file) ----------------------*/
+static int decrecs(crxstr_t *str)
+{
+    int n;
+
+    str->nb = str->pb = 0;
+
+    /* not compact rinex */
+    if (!str->crx)
+    {
+        if (str->pend)
+        {
+            str->pend = 0;
+            n = (int)strlen(str->line);
+            return crxput(str, str->line, n) && crxput(str, "\n", 1);
+        }
+        if (str->pi < str->ni)
+        { /* rest of input buffer */
+            n = str->ni - str->pi;
+            str->pi = str->ni;
+            return crxput(str, str->ibuf + str->ni - n, n);
+        }
+        if (!crxput(str, "", 0) || str->nbmax < NCRXBUF)
+            return 0;
+        return (str->nb = crxread_in(str, str->buff, NCRXBUF)) > 0;
+    }
+    while (str->nb <= 0)
+    {
+        if (!crxgets(str))
+            return 0;
+        if (str->head)
+        {
+            dechead(str, str->line);
+            if (!crxputl(str, str->line, (int)strlen(str->line)))
+                return 0;
+        }
+        else if (!*str->line)
+            continue;
+        else if (!decepoch(str))
+            return 0;
+    }
+    return 1;
+}
+/* read decoded stream -------------------------------------------------------*/
+static long crxread(crxstr_t *str, char *buff, size_t size)
+{
+    size_t n;
+
+    if (str->pb >= str->nb && !decrecs(str))
+        return 0;
+    n = (size_t)(str->nb - str->pb) < size ? (size_t)(str->nb - str->pb) : size;
+    memcpy(buff, str->buff + str->pb, n);
+    str->pb += (int)n;
+    return (long)n;
+}
+/* close stream --------------------------------------------------------------*/
+static void crxfree(crxstr_t *str)
+{
+    int i;
+
+#ifdef ZLIB
+    gzclose(str->gz);
+#else
+    fclose(str->fp);
+#endif
+    for (i = 0; i < MAXCRXSLOT; i++)
+        free(str->sat[i]);
+    free(str->buff);
+    free(str);
+}
+#ifdef __GLIBC__
+static ssize_t cookie_read(void *cookie, char *buff, size_t size)
+{
+    return (ssize_t)crxread((crxstr_t *)cookie, buff, size);
+}
+static int cookie_close(void *cookie)
+{
+    crxfree((crxstr_t *)cookie);
+    return 0;
+}
+#endif
+/* open compact rinex/compressed file stream ---------------------------------*/
+static FILE *crxopen(const char *file)
+{
+    crxstr_t *str;
+    FILE *fp;
+#ifdef __GLIBC__
+    cookie_io_functions_t io = {cookie_read, NULL, NULL, cookie_close};
+#else
+    char buff[4096];
+    long n;
+#endif
+
+    if (!(str = (crxstr_t *)calloc(1, sizeof(crxstr_t))))
+        return NULL;
+#ifdef ZLIB
+    if (!(str->gz = gzopen(file, "rb")))
+    {
+        free(str);
+        return NULL;
+    }
+    gzbuffer(str->gz, NCRXBUF);
+#else
+    if (!(str->fp = fopen(file, "r")))
+    {
+        free(str);
+        return NULL;
+    }
+#endif
+    /* first record to detect compact rinex */
+    if (!crxgets(str))
+        *str->line = '\0';
+    str->pend = 1;
+
+    if (strlen(str->line) > 60 && strstr(str->line + 60, "CRINEX VERS   / TYPE"))
+    {
+        str->crx = str2num(str->line, 0, 9) >= 3.0 ? 3 : 1;
+        str->head = 1;
+        str->pend = 0;
+        crxgets(str); /* CRINEX PROG / DATE */
+    }
+#ifdef ZLIB
+    else if (gzdirect(str->gz))
+#else
+    else
+#endif
+    { /* plain text file */
+        crxfree(str);
+        return fopen(file, "r");
+    }
+    trace(3, "crxopen: file=%s crx=%d\n", file, str->crx);
+
+#ifdef __GLIBC__
+    if ((fp = fopencookie(str, "r", io)))
+        return fp;
+#else
+    /* decode to anonymous temporary file */
+    if ((fp = tmpfile()))
+    {
+        while ((n = crxread(str, buff, sizeof(buff))) > 0)
+            fwrite(buff, 1, (size_t)n, fp);
+        rewind(fp);
+    }
+#endif
+    crxfree(str);
+    return fp;
+}
+/* open file with uncompression ------------------------------------------------
+ * open file for reading with uncompression of gzip and compact rinex
+ * args   : char   *file     I   input file
+ *          char   *tmpfile  O   uncompressed temporary file ("":none)
+ * return : file pointer (NULL:error)
+ * notes  : gzip-compressed (-DZLIB) and compact rinex (hatanaka-compressed)
+ *          files are decoded in the process while reading without temporary
+ *          file (or by anonymous temporary file except for glibc).
+ *          compact rinex is detected by header instead of file extension.
+ *          the other compressed files (.Z,.zip,.tar, and .gz without zlib)
+ *          are uncompressed by rtk_uncompress() to tmpfile, which should be
+ *          removed after fclose()
+ *-----------------------------------------------------------------------------*/
+extern FILE *rtk_fopen(const char *file, char *tmpfile)
+{
+    FILE *fp;
+    const char *p;
+    int cstat;
+
+    trace(3, "rtk_fopen: file=%s\n", file);
+
+    *tmpfile = '\0';
+
+    if ((p = strrchr(file, '.')) &&
+        (!strcmp(p, ".z") || !strcmp(p, ".Z") || !strcmp(p, ".zip") || !strcmp(p, ".ZIP") || strstr(file, ".tar") ||
+#ifndef ZLIB
+         !strcmp(p, ".gz") || !strcmp(p, ".GZ") ||
+#endif
+         0))
+    {
+        if ((cstat = rtk_uncompress(file, tmpfile)) < 0)
+        {
+            trace(2, "file uncompact error: %s\n", file);
+            *tmpfile = '\0';
+            return NULL;
+        }
+        if (!cstat)
+            *tmpfile = '\0';
+        if (!(fp = fopen(cstat ? tmpfile : file, "r")))
+        {
+            trace(2, "file open error: %s\n", cstat ? tmpfile : file);
+            if (cstat)
+                remove(tmpfile);
+            *tmpfile = '\0';
+        }
+        return fp;
+    }
+    if (!(fp = crxopen(file)))
+        trace(2, "file open error: %s\n", file);
+    return fp;
+}
@@ -70,6 +70,16 @@
  *                           fix bug on clock reference time in satpos_ssr()
  *                           fix bug on wrong value with ura=15 in var_ura()
  *                           use integer types in stdint.h
+ *                           add api ephindex() for per-satellite index of
+ *                           ephemeris used by seleph() and selgeph()
+ *                           add satellite state cache in satpos()
+ *                           add api satcachestat()
+ *                           add api eph2posb() for batch evaluation of
+ *                           broadcast ephemeris used by satposs()
+ *                           continue glonass orbit integration from last
+ *                           state in geph2pos()
+ *                           add api satprecomp(),freesatsto() for parallel
+ *                           precomputation of satellite states
  *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
 
@@ -104,8 +114,44 @@
 #define STD_GAL_NAPA 500.0         /* error of galileo ephemeris for NAPA (m) */
 
 #define MAX_ITER_KEPLER 30 /* max number of iteration of Kelpler */
+#define NBATCH 64          /* lanes of batch broadcast ephemeris evaluation */
+#define MAXPRETHREAD 64    /* max threads of satellite state precomputation */
 
 /* ephemeris selections ------------------------------------------------------*/
+typedef struct
+{             /* ephemeris index key type */
+    int sat;  /* satellite number */
+    int i;    /* index of ephemeris */
+    double t; /* toe relative to first ephemeris (s) */
+} ephkey_t;
+
+typedef struct
+{                      /* satellite state cache entry type */
+    const nav_t *nav;  /* navigation data (NULL: empty) */
+    gtime_t time;      /* transmission time (gpst) */
+    gtime_t teph;      /* time to select ephemeris (ssr) */
+    const void *eph;   /* selected ephemeris (brdc) */
+    int ephopt;        /* ephemeris option (EPHOPT_???) */
+    int stat;          /* status of satpos() */
+    int svh;           /* sat health flag */
+    double rs[6];      /* sat position and velocity (ecef) */
+    double dts[2];     /* sat clock {bias,drift} */
+    double var;        /* sat position and clock error variance (m^2) */
+} satcache_t;
+
+typedef struct
+{                   /* glonass orbit integration state type */
+    int sat;        /* satellite number (0: empty) */
+    gtime_t toe;    /* epoch of ephemeris (gpst) */
+    double eph[9];  /* ephemeris position/velocity/acceleration {pos,vel,acc} */
+    double t;       /* integrated time relative to toe on TSTEP grid (s) */
+    double x[6];    /* integrated position/velocity (ecef) (m|m/s) */
+} glostate_t;
+
+static THREADLOCAL satcache_t satcache[MAXSAT][2]; /* satellite state cache {brdc,others} */
+static THREADLOCAL glostate_t glostate[MAXSAT];    /* glonass orbit integration state */
+static THREADLOCAL uint32_t satcache_hit, satcache_miss;
+
 static int eph_sel[] = {/* GPS,GLO,GAL,QZS,BDS,IRN,SBS */
                         0, 0, 0, 0, 0, 0, 0};
 
@@ -322,6 +368,183 @@ extern void eph2pos(gtime_t time, const eph_t *eph, double *rs, double *dts, dou
     /* position and clock error variance */
     *var = var_uraeph(sys, eph->sva); //����svaʵ�ַ����趨
 }
+/* sin and cos of angles in batch ----------------------------------------------
+ * Cody-Waite reduction to [-pi/4,pi/4] and fdlibm kernel polynomials without
+ * branches, so the loop is vectorized by the compiler (error < 2 ulp for
+ * |x| < 1E5)
+ *-----------------------------------------------------------------------------*/
+static void sincosb(const double *x, double *s, double *c, int n)
+{
+    const double P1 = 1.57079632673412561417E+00; /* pi/2 (33 bits) */
+    const double P2 = 6.07710050630396597660E-11; /* pi/2-P1 (33 bits) */
+    const double P3 = 2.02226624871116645580E-21; /* pi/2-P1-P2 */
+    double k, r, z, sr, cr;
+    int i, q;
+
+    for (i = 0; i < n; i++)
+    {
+        k = floor(x[i] * (2.0 / PI) + 0.5);
+        r = ((x[i] - k * P1) - k * P2) - k * P3;
+        z = r * r;
+        sr = r + r * z *
+                     (-1.66666666666666324348E-01 +
+                      z * (8.33333333332248946124E-03 +
+                           z * (-1.98412698298579493134E-04 +
+                                z * (2.75573137070700676789E-06 +
+                                     z * (-2.50507602534068634195E-08 + z * 1.58969099521155010221E-10)))));
+        cr = 1.0 - 0.5 * z +
+             z * z *
+                 (4.16666666666666019037E-02 +
+                  z * (-1.38888888888741095749E-03 +
+                       z * (2.48015872894767294178E-05 +
+                            z * (-2.75573143513906633035E-07 +
+                                 z * (2.08757232129817482790E-09 - z * 1.13596475577881948265E-11)))));
+        q = (int)k & 3;
+        s[i] = ((q & 1) ? cr : sr) * ((q & 2) ? -1.0 : 1.0);
+        c[i] = ((q & 1) ? sr : cr) * (((q + 1) & 2) ? -1.0 : 1.0);
+    }
+}
+/* broadcast ephemerides to satellite positions and clock biases in batch ------
+ * compute satellite positions and clock biases with broadcast ephemerides
+ * (gps, galileo, qzss, beidou) for a batch of satellites
+ * args   : gtime_t *time    I   times (gpst) {time[i]}
+ *          eph_t **eph      I   broadcast ephemerides {eph[i]}
+ *          int    n         I   number of satellites
+ *          double *rs       O   satellite positions (ecef) {x,y,z} (m) {rs[i*3+j]}
+ *          double *dts      O   satellite clock biases (s) {dts[i]}
+ *          double *var      O   satellite position and clock variances (m^2)
+ * return : none
+ * notes  : same as eph2pos() for each satellite. the batch is processed in
+ *          structure-of-arrays blocks of NBATCH with the Kepler iteration run
+ *          for all lanes together and trigonometric functions by sincosb().
+ *          true anomaly and argument of latitude are composed with sine and
+ *          cosine instead of atan2() of eph2pos()
+ *-----------------------------------------------------------------------------*/
+extern void eph2posb(const gtime_t *time, const eph_t *const *eph, int n, double *rs, double *dts, double *var)
+{
+    const eph_t *p;
+    double tk[NBATCH], tc[NBATCH], M[NBATCH], E[NBATCH], e[NBATCH], A[NBATCH], mu[NBATCH], omge[NBATCH];
+    double sE[NBATCH], cE[NBATCH], dE[NBATCH], xo[NBATCH], yo[NBATCH], ang[NBATCH * 3], sa[NBATCH * 3], ca[NBATCH * 3];
+    double su0, cu0, s2u, c2u, du, sdu, cdu, su, cu, r, x, y, d, dmax, xg, yg, zg;
+    int i, j, k, m, it, prn, idx[NBATCH], geo[NBATCH];
+
+    for (i = 0; i < n; i += NBATCH)
+    {
+        /* gather valid ephemerides */
+        for (j = i, m = 0; j < n && j < i + NBATCH; j++)
+        {
+            rs[j * 3] = rs[j * 3 + 1] = rs[j * 3 + 2] = dts[j] = var[j] = 0.0;
+            if ((p = eph[j])->A <= 0.0)
+                continue;
+            switch (satsys(p->sat, &prn))
+            {
+            case SYS_GAL:
+                mu[m] = MU_GAL;
+                omge[m] = OMGE_GAL;
+                geo[m] = 0;
+                break;
+            case SYS_CMP:
+                mu[m] = MU_CMP;
+                omge[m] = OMGE_CMP;
+                geo[m] = prn <= 5 || prn >= 59;
+                break;
+            default:
+                mu[m] = MU_GPS;
+                omge[m] = OMGE;
+                geo[m] = 0;
+                break;
+            }
+            tk[m] = timediff(time[j], p->toe);
+            tc[m] = timediff(time[j], p->toc);
+            A[m] = p->A;
+            e[m] = p->e;
+            M[m] = p->M0 + (sqrt(mu[m] / (p->A * p->A * p->A)) + p->deln) * tk[m];
+            ang[m] = p->omg;
+            idx[m++] = j;
+        }
+        trace(4, "eph2posb: n=%d m=%d\n", j - i, m);
+
+        /* Kepler equation by Newton's method for all lanes */
+        for (k = 0; k < m; k++)
+            E[k] = M[k];
+        for (it = 0; it < MAX_ITER_KEPLER; it++)
+        {
+            sincosb(E, sE, cE, m);
+            for (k = 0, dmax = 0.0; k < m; k++)
+            {
+                dE[k] = (E[k] - e[k] * sE[k] - M[k]) / (1.0 - e[k] * cE[k]);
+                E[k] -= dE[k];
+                d = fabs(dE[k]);
+                dmax = d > dmax ? d : dmax;
+            }
+            if (dmax <= RTOL_KEPLER)
+                break;
+        }
+        sincosb(E, sE, cE, m);
+        sincosb(ang, sa, ca, m); /* argument of perigee */
+
+        for (k = 0; k < m; k++)
+        {
+            p = eph[idx[k]];
+
+            /* argument of latitude by true anomaly and argument of perigee */
+            d = 1.0 - e[k] * cE[k];
+            x = sqrt(1.0 - e[k] * e[k]) * sE[k] / d;
+            y = (cE[k] - e[k]) / d;
+            su0 = x * ca[k] + y * sa[k];
+            cu0 = y * ca[k] - x * sa[k];
+            s2u = 2.0 * su0 * cu0;
+            c2u = cu0 * cu0 - su0 * su0;
+            du = p->cus * s2u + p->cuc * c2u;
+            sdu = du * (1.0 - du * du / 6.0);
+            cdu = 1.0 - du * du * (0.5 - du * du / 24.0);
+            su = su0 * cdu + cu0 * sdu;
+            cu = cu0 * cdu - su0 * sdu;
+            r = A[k] * d + p->crs * s2u + p->crc * c2u;
+            xo[k] = r * cu;
+            yo[k] = r * su;
+
+            /* inclination, longitude of ascending node and earth rotation */
+            ang[k] = p->i0 + p->idot * tk[k] + p->cis * s2u + p->cic * c2u;
+            ang[k + m] = p->OMG0 + (p->OMGd - (geo[k] ? 0.0 : omge[k])) * tk[k] - omge[k] * p->toes;
+            ang[k + m * 2] = omge[k] * tk[k];
+        }
+        sincosb(ang, sa, ca, m * 3);
+
+        for (k = 0; k < m; k++)
+        {
+            p = eph[idx[k]];
+            j = idx[k];
+
+            if (fabs(dE[k]) > RTOL_KEPLER)
+            {
+                trace(2, "eph2posb: kepler iteration overflow sat=%2d\n", p->sat);
+                continue;
+            }
+            xg = xo[k] * ca[k + m] - yo[k] * ca[k] * sa[k + m];
+            yg = xo[k] * sa[k + m] + yo[k] * ca[k] * ca[k + m];
+            zg = yo[k] * sa[k];
+
+            if (geo[k])
+            { /* beidou geo satellite, ref [9] table 4-1 */
+                rs[j * 3] = xg * ca[k + m * 2] + yg * sa[k + m * 2] * COS_5 + zg * sa[k + m * 2] * SIN_5;
+                rs[j * 3 + 1] = -xg * sa[k + m * 2] + yg * ca[k + m * 2] * COS_5 + zg * ca[k + m * 2] * SIN_5;
+                rs[j * 3 + 2] = -yg * SIN_5 + zg * COS_5;
+            }
+            else
+            {
+                rs[j * 3] = xg;
+                rs[j * 3 + 1] = yg;
+                rs[j * 3 + 2] = zg;
+            }
+            /* clock with relativity correction */
+            dts[j] = p->f0 + p->f1 * tc[k] + p->f2 * tc[k] * tc[k] -
+                     2.0 * sqrt(mu[k] * A[k]) * e[k] * sE[k] / SQR(CLIGHT);
+
+            var[j] = var_uraeph(satsys(p->sat, NULL), p->sva);
+        }
+    }
+}
 /* glonass orbit differential equations --------------------------------------*/
 static void deq(const double *x, double *xdot, const double *acc)
 {
@@ -362,6 +585,18 @@ static void glorbit(double t, double *x, const double *acc)
     for (i = 0; i < 6; i++)
         x[i] += (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]) * t / 6.0;
 }
+/* integrate glonass orbit by t (s) in steps of TSTEP ------------------------*/
+static void glointeg(double t, double *x, const double *acc)
+{
+    double tt;
+
+    for (tt = t < 0.0 ? -TSTEP : TSTEP; fabs(t) > 1E-9; t -= tt)
+    {
+        if (fabs(t) < TSTEP)
+            tt = t;
+        glorbit(tt, x, acc);
+    }
+}
 /* glonass ephemeris to satellite clock bias -----------------------------------
  * compute satellite clock bias with glonass ephemeris
  * args   : gtime_t time     I   time by satellite clock (gpst)
@@ -393,29 +628,66 @@ extern double geph2clk(gtime_t time, const geph_t *geph)
  *          double *var      O   satellite position and clock variance (m^2)
  * return : none
  * notes  : see ref [2]
+ *          the orbit is integrated from toe in steps of TSTEP to the last grid
+ *          point toe+n*TSTEP before time and then to time. the state at the
+ *          grid point is kept in thread-local storage and later calls continue
+ *          from it, so successive epochs cost a few RK4 steps and the result
+ *          does not depend on call order or thread split. the state is reset
+ *          when the ephemeris changes
  *-----------------------------------------------------------------------------*/
 extern void geph2pos(gtime_t time, const geph_t *geph, double *rs, double *dts, double *var)
 {
-    double t, tt, x[6];
+    glostate_t *s = NULL;
+    double t, tg, t0 = 0.0, x[6];
     int i;
 
     trace(4, "geph2pos: time=%s sat=%2d\n", time_str(time, 3), geph->sat);
 
     t = timediff(time, geph->toe);
+    tg = (t < 0.0 ? -TSTEP : TSTEP) * floor(fabs(t) / TSTEP);
 
     *dts = -geph->taun + geph->gamn * t;
 
-    for (i = 0; i < 3; i++)
+    if (geph->sat > 0 && geph->sat <= MAXSAT)
     {
-        x[i] = geph->pos[i];
-        x[i + 3] = geph->vel[i];
+        s = glostate + geph->sat - 1;
     }
-    for (tt = t < 0.0 ? -TSTEP : TSTEP; fabs(t) > 1E-9; t -= tt)
+    if (s && s->sat == geph->sat && timediff(s->toe, geph->toe) == 0.0 && s->eph[0] == geph->pos[0] &&
+        s->eph[1] == geph->pos[1] && s->eph[2] == geph->pos[2] && s->eph[3] == geph->vel[0] &&
+        s->eph[4] == geph->vel[1] && s->eph[5] == geph->vel[2] && s->eph[6] == geph->acc[0] &&
+        s->eph[7] == geph->acc[1] && s->eph[8] == geph->acc[2] && s->t * tg >= 0.0 && fabs(s->t) <= fabs(tg))
     {
-        if (fabs(t) < TSTEP)
-            tt = t;
-        glorbit(tt, x, geph->acc);
+        /* continue from integrated state on grid */
+        t0 = s->t;
+        for (i = 0; i < 6; i++)
+            x[i] = s->x[i];
+    }
+    else
+    {
+        for (i = 0; i < 3; i++)
+        {
+            x[i] = geph->pos[i];
+            x[i + 3] = geph->vel[i];
+        }
     }
+    glointeg(tg - t0, x, geph->acc);
+
+    if (s)
+    {
+        s->sat = geph->sat;
+        s->toe = geph->toe;
+        for (i = 0; i < 3; i++)
+        {
+            s->eph[i] = geph->pos[i];
+            s->eph[i + 3] = geph->vel[i];
+            s->eph[i + 6] = geph->acc[i];
+        }
+        s->t = tg;
+        for (i = 0; i < 6; i++)
+            s->x[i] = x[i];
+    }
+    glointeg(t - tg, x, geph->acc);
+
     for (i = 0; i < 3; i++)
         rs[i] = x[i];
 
@@ -470,11 +742,42 @@ extern void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts,
 
     *var = var_uraeph(SYS_SBS, seph->sva);
 }
+/* test ephemeris for selection ---------------------------------------------*/
+static int testeph(const eph_t *eph, gtime_t time, int sys, int sel, int iode, double tmax, double *t)
+{
+    if (iode >= 0 && eph->iode != iode)
+        return 0;
+    if (sys == SYS_GAL)
+    {
+        if (sel == 0 && !(eph->code & (1 << 9)))
+            return 0; /* I/NAV */
+        if (sel == 1 && !(eph->code & (1 << 8)))
+            return 0; /* F/NAV */
+        if (timediff(eph->toe, time) >= 0.0)
+            return 0; /* AOD<=0 */
+    }
+    return (*t = fabs(timediff(eph->toe, time))) <= tmax;
+}
+/* first indexed ephemeris with toe>=time-tmax -------------------------------*/
+static int lowereph(const ephidx_t *ie, int sat, gtime_t time, double tmax, const gtime_t *toe, size_t size)
+{
+    int lo = ie->off[sat - 1], hi = ie->off[sat], mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (timediff(*(const gtime_t *)((const char *)toe + size * ie->idx[mid]), time) < -tmax)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
 /* select ephememeris --------------------------------------------------------*/
 static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
 {
     double t, tmax, tmin;
-    int i, j = -1, sys, sel;
+    int i, j = -1, k, sys, sel = 0;
 
     trace(4, "seleph  : time=%s sat=%2d iode=%d\n", time_str(time, 3), sat, iode);
 
@@ -483,23 +786,19 @@ static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
     {
     case SYS_GPS:
         tmax = MAXDTOE + 1.0;
-        sel = eph_sel[0];
         break;
     case SYS_GAL:
         tmax = MAXDTOE_GAL;
-        sel = eph_sel[2];
+        sel = getseleph(SYS_GAL);
         break;
     case SYS_QZS:
         tmax = MAXDTOE_QZS + 1.0;
-        sel = eph_sel[3];
         break;
     case SYS_CMP:
         tmax = MAXDTOE_CMP + 1.0;
-        sel = eph_sel[4];
         break;
     case SYS_IRN:
         tmax = MAXDTOE_IRN + 1.0;
-        sel = eph_sel[5];
         break;
     default:
         tmax = MAXDTOE + 1.0;
@@ -507,33 +806,46 @@ static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
     }
     tmin = tmax + 1.0;
 
-    for (i = 0; i < nav->n; i++)
+    if (nav->ie.idx && nav->ie.n == nav->n && sat > 0 && sat <= MAXSAT)
     {
-        if (nav->eph[i].sat != sat)
-            continue;
-        if (iode >= 0 && nav->eph[i].iode != iode)
-            continue;
-        if (sys == SYS_GAL)
+        /* scan ephemeris of the satellite within toe window by index */
+        for (k = lowereph(&nav->ie, sat, time, tmax, &nav->eph[0].toe, sizeof(eph_t)); k < nav->ie.off[sat]; k++)
         {
-            sel = getseleph(SYS_GAL);
-            if (sel == 0 && !(nav->eph[i].code & (1 << 9)))
-                continue; /* I/NAV */
-            if (sel == 1 && !(nav->eph[i].code & (1 << 8)))
-                continue; /* F/NAV */
-            if (timediff(nav->eph[i].toe, time) >= 0.0)
-                continue; /* AOD<=0 */
+            i = nav->ie.idx[k];
+            if (timediff(nav->eph[i].toe, time) > tmax)
+                break;
+            if (!testeph(nav->eph + i, time, sys, sel, iode, tmax, &t))
+                continue;
+            if (iode >= 0)
+            {
+                if (j < 0 || i < j)
+                    j = i; /* first in ephemeris order */
+            }
+            else if (t < tmin || (t == tmin && i > j))
+            {
+                j = i;
+                tmin = t;
+            } /* toe closest to time, last in ephemeris order */
         }
-        if ((t = fabs(timediff(nav->eph[i].toe, time))) > tmax)
-            continue;
-        if (iode >= 0)
-            return nav->eph + i;
-        if (t <= tmin)
+    }
+    else
+    {
+        for (i = 0; i < nav->n; i++)
         {
-            j = i;
-            tmin = t;
-        } /* toe closest to time */
+            if (nav->eph[i].sat != sat)
+                continue;
+            if (!testeph(nav->eph + i, time, sys, sel, iode, tmax, &t))
+                continue;
+            if (iode >= 0)
+                return nav->eph + i;
+            if (t <= tmin)
+            {
+                j = i;
+                tmin = t;
+            } /* toe closest to time */
+        }
     }
-    if (iode >= 0 || j < 0)
+    if (j < 0)
     {
         trace(3, "no broadcast ephemeris: %s sat=%2d iode=%3d\n", time_str(time, 0), sat, iode);
         return NULL;
@@ -544,27 +856,53 @@ static eph_t *seleph(gtime_t time, int sat, int iode, const nav_t *nav)
 static geph_t *selgeph(gtime_t time, int sat, int iode, const nav_t *nav)
 {
     double t, tmax = MAXDTOE_GLO, tmin = tmax + 1.0;
-    int i, j = -1;
+    int i, j = -1, k;
 
     trace(4, "selgeph : time=%s sat=%2d iode=%2d\n", time_str(time, 3), sat, iode);
 
-    for (i = 0; i < nav->ng; i++)
+    if (nav->ig.idx && nav->ig.n == nav->ng && sat > 0 && sat <= MAXSAT)
     {
-        if (nav->geph[i].sat != sat)
-            continue;
-        if (iode >= 0 && nav->geph[i].iode != iode)
-            continue;
-        if ((t = fabs(timediff(nav->geph[i].toe, time))) > tmax)
-            continue;
-        if (iode >= 0)
-            return nav->geph + i;
-        if (t <= tmin)
+        /* scan ephemeris of the satellite within toe window by index */
+        for (k = lowereph(&nav->ig, sat, time, tmax, &nav->geph[0].toe, sizeof(geph_t)); k < nav->ig.off[sat]; k++)
         {
-            j = i;
-            tmin = t;
-        } /* toe closest to time */
+            i = nav->ig.idx[k];
+            if (timediff(nav->geph[i].toe, time) > tmax)
+                break;
+            if (iode >= 0 && nav->geph[i].iode != iode)
+                continue;
+            t = fabs(timediff(nav->geph[i].toe, time));
+            if (iode >= 0)
+            {
+                if (j < 0 || i < j)
+                    j = i; /* first in ephemeris order */
+            }
+            else if (t < tmin || (t == tmin && i > j))
+            {
+                j = i;
+                tmin = t;
+            } /* toe closest to time, last in ephemeris order */
+        }
+    }
+    else
+    {
+        for (i = 0; i < nav->ng; i++)
+        {
+            if (nav->geph[i].sat != sat)
+                continue;
+            if (iode >= 0 && nav->geph[i].iode != iode)
+                continue;
+            if ((t = fabs(timediff(nav->geph[i].toe, time))) > tmax)
+                continue;
+            if (iode >= 0)
+                return nav->geph + i;
+            if (t <= tmin)
+            {
+                j = i;
+                tmin = t;
+            } /* toe closest to time */
+        }
     }
-    if (iode >= 0 || j < 0)
+    if (j < 0)
     {
         trace(3, "no glonass ephemeris  : %s sat=%2d iode=%2d\n", time_str(time, 0), sat, iode);
         return NULL;
@@ -789,6 +1127,83 @@ static int satpos_ssr(gtime_t time, gtime_t teph, int sat, const nav_t *nav, int
 
     return 1;
 }
+/* selected broadcast ephemeris as cache key --------------------------------*/
+static const void *selephkey(gtime_t teph, int sat, const nav_t *nav)
+{
+    int sys = satsys(sat, NULL);
+
+    if (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS || sys == SYS_CMP || sys == SYS_IRN)
+        return seleph(teph, sat, -1, nav);
+    if (sys == SYS_GLO)
+        return selgeph(teph, sat, -1, nav);
+    return NULL;
+}
+/* satellite position and clock without cache --------------------------------*/
+static int satpos_(gtime_t time, gtime_t teph, int sat, int ephopt, const nav_t *nav, double *rs, double *dts,
+                   double *var, int *svh)
+{
+    *svh = 0;
+
+    switch (ephopt)
+    {
+    case EPHOPT_BRDC:
+        return ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
+    case EPHOPT_SBAS:
+        return 0;
+    case EPHOPT_SSRAPC:
+        return satpos_ssr(time, teph, sat, nav, 0, rs, dts, var, svh);
+    case EPHOPT_SSRCOM:
+        return satpos_ssr(time, teph, sat, nav, 1, rs, dts, var, svh);
+    case EPHOPT_PREC:
+        if (!peph2pos(time, sat, nav, 1, rs, dts, var))
+            break;
+        else
+            return 1;
+    }
+    *svh = -1;
+    return 0;
+}
+/* get satellite state from cache (0:miss) -----------------------------------*/
+static int getsatcache(const satcache_t *c, gtime_t time, gtime_t teph, int ephopt, const nav_t *nav, const void *eph,
+                       double *rs, double *dts, double *var, int *svh, int *stat)
+{
+    int i;
+
+    if (c->nav != nav || c->ephopt != ephopt || c->eph != eph || timediff(c->time, time) != 0.0 ||
+        ((ephopt == EPHOPT_SSRAPC || ephopt == EPHOPT_SSRCOM) && timediff(c->teph, teph) != 0.0))
+    {
+        satcache_miss++;
+        return 0;
+    }
+    for (i = 0; i < 6; i++)
+        rs[i] = c->rs[i];
+    dts[0] = c->dts[0];
+    dts[1] = c->dts[1];
+    *var = c->var;
+    *svh = c->svh;
+    *stat = c->stat;
+    satcache_hit++;
+    return 1;
+}
+/* set satellite state to cache ----------------------------------------------*/
+static void setsatcache(satcache_t *c, gtime_t time, gtime_t teph, int ephopt, const nav_t *nav, const void *eph,
+                        int stat, const double *rs, const double *dts, double var, int svh)
+{
+    int i;
+
+    c->stat = stat;
+    c->nav = nav;
+    c->time = time;
+    c->teph = teph;
+    c->eph = eph;
+    c->ephopt = ephopt;
+    for (i = 0; i < 6; i++)
+        c->rs[i] = rs[i];
+    c->dts[0] = dts[0];
+    c->dts[1] = dts[1];
+    c->var = var;
+    c->svh = svh;
+}
 /* satellite position and clock ------------------------------------------------
  * compute satellite position, velocity and clock
  * args   : gtime_t time     I   time (gpst)
@@ -804,33 +1219,240 @@ static int satpos_ssr(gtime_t time, gtime_t teph, int sat, const nav_t *nav, int
  * return : status (1:ok,0:error)
  * notes  : satellite position is referenced to antenna phase center
  *          satellite clock does not include code bias correction (tgd or bgd)
+ *          results are kept in thread-local cache keyed by satellite,
+ *          transmission time and ephemeris option, so satposs() in pntpos(),
+ *          ppppos() and relpos() of the same epoch evaluate the orbit and
+ *          clock once. broadcast entries are also keyed by the selected
+ *          ephemeris and ssr entries by teph
  *-----------------------------------------------------------------------------*/
 extern int satpos(gtime_t time, gtime_t teph, int sat, int ephopt, const nav_t *nav, double *rs, double *dts,
                   double *var, int *svh)
 {
-    trace(4, "satpos  : time=%s sat=%2d ephopt=%d\n", time_str(time, 3), sat, ephopt);
+    satcache_t *c;
+    const void *eph = NULL;
+    int stat;
 
-    *svh = 0;
+    trace(4, "satpos  : time=%s sat=%2d ephopt=%d\n", time_str(time, 3), sat, ephopt);
 
-    switch (ephopt)
+    if (sat <= 0 || sat > MAXSAT)
     {
-    case EPHOPT_BRDC:
-        return ephpos(time, teph, sat, nav, -1, rs, dts, var, svh);
-    case EPHOPT_SBAS:
+        *svh = -1;
         return 0;
-    case EPHOPT_SSRAPC:
-        return satpos_ssr(time, teph, sat, nav, 0, rs, dts, var, svh);
-    case EPHOPT_SSRCOM:
-        return satpos_ssr(time, teph, sat, nav, 1, rs, dts, var, svh);
-    case EPHOPT_PREC:
-        if (!peph2pos(time, sat, nav, 1, rs, dts, var))
-            break;
-        else
-            return 1;
     }
-    *svh = -1;
+    c = satcache[sat - 1] + (ephopt == EPHOPT_BRDC ? 0 : 1);
+
+    if (ephopt == EPHOPT_BRDC)
+        eph = selephkey(teph, sat, nav);
+
+    if (getsatcache(c, time, teph, ephopt, nav, eph, rs, dts, var, svh, &stat))
+        return stat;
+
+    stat = satpos_(time, teph, sat, ephopt, nav, rs, dts, var, svh);
+    setsatcache(c, time, teph, ephopt, nav, eph, stat, rs, dts, *var, *svh);
+    return stat;
+}
+/* pseudorange for transmission time -----------------------------------------*/
+static double obspr(const obsd_t *obs)
+{
+    int j;
+
+    for (j = 0; j < NFREQ; j++)
+        if (obs->P[j] != 0.0)
+            return obs->P[j];
+    return 0.0;
+}
+/* get precomputed satellite states (0: not precomputed) ---------------------*/
+static int getsatsto(const satsto_t *sto, const obsd_t *obs, int n, double *rs, double *dts, double *var, int *svh)
+{
+    int i, j, k = -1, lo, hi, mid;
+
+    for (i = 0; i < n && i < 2 * MAXOBS; i++)
+    {
+        /* search epoch by time and receiver */
+        if (k < 0 || sto->rcv[k] != obs[i].rcv || fabs(timediff(obs[i].time, sto->time[k])) > DTTOL)
+        {
+            for (lo = 0, hi = sto->ne; lo < hi;)
+            {
+                mid = (lo + hi) / 2;
+                if (timediff(sto->time[mid], obs[i].time) < -DTTOL)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for (k = lo; k < sto->ne && timediff(sto->time[k], obs[i].time) <= DTTOL; k++)
+                if (sto->rcv[k] == obs[i].rcv)
+                    break;
+            if (k >= sto->ne || timediff(sto->time[k], obs[i].time) > DTTOL)
+                return 0;
+        }
+        /* search record by satellite and pseudorange */
+        for (j = sto->off[k]; j < sto->off[k + 1]; j++)
+            if (sto->sat[j] == obs[i].sat)
+                break;
+        if (j >= sto->off[k + 1] || sto->pr[j] != obspr(obs + i))
+            return 0;
+
+        memcpy(rs + i * 6, sto->rs + j * 6, sizeof(double) * 6);
+        memcpy(dts + i * 2, sto->dts + j * 2, sizeof(double) * 2);
+        var[i] = sto->var[j];
+        svh[i] = sto->svh[j];
+    }
+    return 1;
+}
+/* free precomputed satellite states -------------------------------------------
+ * free precomputed satellite states
+ * args   : satsto_t *sto    IO  precomputed satellite states
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void freesatsto(satsto_t *sto)
+{
+    free(sto->time);
+    free(sto->rcv);
+    free(sto->off);
+    free(sto->sat);
+    free(sto->pr);
+    free(sto->rs);
+    free(sto->dts);
+    free(sto->var);
+    free(sto->svh);
+    memset(sto, 0, sizeof(satsto_t));
+}
+typedef struct
+{                     /* satellite state precomputation thread argument type */
+    const obs_t *obs; /* observation data */
+    const nav_t *nav; /* navigation data */
+    satsto_t *sto;    /* precomputed satellite states */
+    int ephopt;       /* ephemeris option */
+    int k0, k1;       /* epochs of thread {k0..k1-1} */
+} satprearg_t;
+
+/* satellite state precomputation thread -------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI satprethread(void *arg)
+#else
+static void *satprethread(void *arg)
+#endif
+{
+    satprearg_t *a = (satprearg_t *)arg;
+    satsto_t *sto = a->sto;
+    int k, i, n;
+
+    for (k = a->k0; k < a->k1; k++)
+    {
+        i = sto->off[k];
+        n = sto->off[k + 1] - i;
+        satposs(sto->time[k], a->obs->data + i, n, a->nav, a->ephopt, sto->rs + i * 6, sto->dts + i * 2,
+                sto->var + i, sto->svh + i);
+    }
     return 0;
 }
+/* precompute satellite states -------------------------------------------------
+ * compute satellite positions, velocities and clocks of all observation epochs
+ * in parallel for post-processing
+ * args   : obs_t  *obs      I   observation data (sorted by time and receiver)
+ *          nav_t  *nav      I   navigation data
+ *          int    ephopt    I   ephemeris option (EPHOPT_BRDC or EPHOPT_PREC)
+ *          int    nthread   I   number of threads
+ *          satsto_t *sto    O   precomputed satellite states
+ * return : status (1:ok,0:error)
+ * notes  : satellite states depend only on observation time, pseudorange and
+ *          products, so they are computed by satposs() before the filter. set
+ *          nav->sto=sto after return to use them by satposs() in pntpos(),
+ *          ppppos() and relpos(). records of an epoch are kept in the order of
+ *          obs->data and looked up by time, receiver, satellite and
+ *          pseudorange. ephemeris is selected by observation time instead of
+ *          solution time
+ *-----------------------------------------------------------------------------*/
+extern int satprecomp(const obs_t *obs, const nav_t *nav, int ephopt, int nthread, satsto_t *sto)
+{
+    satprearg_t arg[MAXPRETHREAD];
+    thread_t thread[MAXPRETHREAD];
+    int i, j, ne, run[MAXPRETHREAD] = {0};
+
+    trace(3, "satprecomp: n=%d ephopt=%d nthread=%d\n", obs->n, ephopt, nthread);
+
+    freesatsto(sto);
+
+    if (obs->n <= 0 || (ephopt != EPHOPT_BRDC && ephopt != EPHOPT_PREC))
+        return 0;
+
+    if (!(sto->time = (gtime_t *)malloc(sizeof(gtime_t) * obs->n)) ||
+        !(sto->rcv = (int *)malloc(sizeof(int) * obs->n)) || !(sto->off = (int *)malloc(sizeof(int) * (obs->n + 1))) ||
+        !(sto->sat = (int *)malloc(sizeof(int) * obs->n)) || !(sto->pr = (double *)malloc(sizeof(double) * obs->n)) ||
+        !(sto->rs = (double *)calloc(obs->n * 6, sizeof(double))) ||
+        !(sto->dts = (double *)calloc(obs->n * 2, sizeof(double))) ||
+        !(sto->var = (double *)calloc(obs->n, sizeof(double))) || !(sto->svh = (int *)calloc(obs->n, sizeof(int))))
+    {
+        trace(1, "satprecomp: malloc error n=%d\n", obs->n);
+        freesatsto(sto);
+        return 0;
+    }
+    /* epochs of observation data */
+    for (i = ne = 0; i < obs->n; i = j)
+    {
+        for (j = i + 1; j < obs->n && j - i < 2 * MAXOBS; j++)
+        {
+            if (obs->data[j].rcv != obs->data[i].rcv || timediff(obs->data[j].time, obs->data[i].time) > DTTOL)
+                break;
+        }
+        sto->time[ne] = obs->data[i].time;
+        sto->rcv[ne] = obs->data[i].rcv;
+        sto->off[ne++] = i;
+    }
+    sto->off[ne] = obs->n;
+    for (i = 0; i < obs->n; i++)
+    {
+        sto->sat[i] = obs->data[i].sat;
+        sto->pr[i] = obspr(obs->data + i);
+    }
+    sto->ephopt = ephopt;
+
+    /* satellite states by threads over contiguous blocks of epochs */
+    if (nthread < 1)
+        nthread = 1;
+    if (nthread > MAXPRETHREAD)
+        nthread = MAXPRETHREAD;
+    if (nthread > ne)
+        nthread = ne;
+
+    for (i = 0; i < nthread; i++)
+    {
+        arg[i].obs = obs;
+        arg[i].nav = nav;
+        arg[i].sto = sto;
+        arg[i].ephopt = ephopt;
+        arg[i].k0 = (int)((long long)ne * i / nthread);
+        arg[i].k1 = (int)((long long)ne * (i + 1) / nthread);
+    }
+    for (i = 1; i < nthread; i++)
+    {
+#ifdef WIN32
+        run[i] = (thread[i] = CreateThread(NULL, 0, satprethread, arg + i, 0, NULL)) != NULL;
+#else
+        run[i] = !pthread_create(thread + i, NULL, satprethread, arg + i);
+#endif
+        if (!run[i])
+            satprethread(arg + i);
+    }
+    satprethread(arg);
+
+    for (i = 1; i < nthread; i++)
+    {
+        if (!run[i])
+            continue;
+#ifdef WIN32
+        WaitForSingleObject(thread[i], INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i], NULL);
+#endif
+    }
+    sto->ne = ne;
+    sto->n = obs->n;
+
+    trace(2, "satprecomp: epochs=%d records=%d threads=%d\n", ne, obs->n, nthread);
+    return 1;
+}
 /* satellite positions and clocks ----------------------------------------------
  * compute satellite positions, velocities and clocks
  * args   : gtime_t teph     I   time to select ephemeris (gpst)
@@ -854,16 +1476,23 @@ extern int satpos(gtime_t time, gtime_t teph, int sat, int ephopt, const nav_t *
  *          satellite clock does not include code bias correction (tgd or bgd)
  *          any pseudorange and broadcast ephemeris are always needed to get
  *          signal transmission time���Ƿ����ź�ʱ��
+ *          states precomputed by satprecomp() in nav->sto are used if all
+ *          observation data are found in them
  *-----------------------------------------------------------------------------*/
 extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav, int ephopt, double *rs, double *dts,
                     double *var, int *svh)
 {
-    gtime_t time[2 * MAXOBS] = {{0}};
-    double dt, pr;
-    int i, j;
+    gtime_t time[2 * MAXOBS] = {{0}}, tb[4 * MAXOBS];
+    const eph_t *eb[4 * MAXOBS];
+    double dt, pr, rb[12 * MAXOBS], db[4 * MAXOBS], vb[4 * MAXOBS], tt = 1E-3;
+    int i, j, k, m = 0, sys, ib[2 * MAXOBS], stat[2 * MAXOBS] = {0};
 
     trace(3, "satposs : teph=%s n=%d ephopt=%d\n", time_str(teph, 3), n, ephopt);
 
+    /* precomputed satellite states of session */
+    if (nav->sto && nav->sto->ne > 0 && nav->sto->ephopt == ephopt && getsatsto(nav->sto, obs, n, rs, dts, var, svh))
+        return;
+
     for (i = 0; i < n && i < 2 * MAXOBS; i++)
     {
         for (j = 0; j < 6; j++)
@@ -894,21 +1523,62 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav, in
         }
         time[i] = timeadd(time[i], -dt);
 
+        /* defer broadcast ephemeris not in cache to batch evaluation */
+        sys = satsys(obs[i].sat, NULL);
+        if (ephopt == EPHOPT_BRDC &&
+            (sys == SYS_GPS || sys == SYS_GAL || sys == SYS_QZS || sys == SYS_CMP || sys == SYS_IRN) &&
+            (eb[m] = seleph(teph, obs[i].sat, -1, nav)))
+        {
+            if (getsatcache(satcache[obs[i].sat - 1], time[i], teph, ephopt, nav, eb[m], rs + i * 6, dts + i * 2,
+                            var + i, svh + i, stat + i))
+                continue;
+            tb[m] = time[i];
+            ib[m++] = i;
+            continue;
+        }
         /* satellite position and clock at transmission time */
-        if (!satpos(time[i], teph, obs[i].sat, ephopt, nav, rs + i * 6, dts + i * 2, var + i, svh + i))
+        if (!(stat[i] = satpos(time[i], teph, obs[i].sat, ephopt, nav, rs + i * 6, dts + i * 2, var + i, svh + i)))
         {
             trace(3, "no ephemeris %s sat=%2d\n", time_str(time[i], 3), obs[i].sat);
-            continue;
         }
-        /* if no precise clock available, use broadcast clock instead */
-        if (dts[i * 2] == 0.0)
+    }
+    /* broadcast ephemeris in batch, velocity and clock drift by differential approx */
+    if (m > 0)
+    {
+        for (k = 0; k < m; k++)
         {
-            if (!ephclk(time[i], teph, obs[i].sat, nav, dts + i * 2))
-                continue;
-            dts[1 + i * 2] = 0.0;
-            *var = SQR(STD_BRDCCLK);
+            tb[k + m] = timeadd(tb[k], tt);
+            eb[k + m] = eb[k];
+        }
+        eph2posb(tb, eb, m * 2, rb, db, vb);
+
+        for (k = 0; k < m; k++)
+        {
+            i = ib[k];
+            for (j = 0; j < 3; j++)
+            {
+                rs[j + i * 6] = rb[j + k * 3];
+                rs[j + 3 + i * 6] = (rb[j + (k + m) * 3] - rb[j + k * 3]) / tt;
+            }
+            dts[i * 2] = db[k];
+            dts[1 + i * 2] = (db[k + m] - db[k]) / tt;
+            var[i] = vb[k];
+            svh[i] = eb[k]->svh;
+            stat[i] = 1;
+            setsatcache(satcache[obs[i].sat - 1], time[i], teph, ephopt, nav, eb[k], 1, rs + i * 6, dts + i * 2,
+                        var[i], svh[i]);
         }
     }
+    /* if no precise clock available, use broadcast clock instead */
+    for (i = 0; i < n && i < 2 * MAXOBS; i++)
+    {
+        if (!stat[i] || dts[i * 2] != 0.0)
+            continue;
+        if (!ephclk(time[i], teph, obs[i].sat, nav, dts + i * 2))
+            continue;
+        dts[1 + i * 2] = 0.0;
+        *var = SQR(STD_BRDCCLK);
+    }
     for (i = 0; i < n && i < 2 * MAXOBS; i++)
     {
         trace(2, "%s sat=%2d rs=%13.3f %13.3f %13.3f dts=%12.3f var=%7.3f svh=%02X\n", time_str(time[i], 6), obs[i].sat,
@@ -980,3 +1650,95 @@ extern int getseleph(int sys)
     }
     return 0;
 }
+/* compare ephemeris index key -----------------------------------------------*/
+static int cmpephkey(const void *p1, const void *p2)
+{
+    const ephkey_t *q1 = (const ephkey_t *)p1, *q2 = (const ephkey_t *)p2;
+    if (q1->sat != q2->sat)
+        return q1->sat - q2->sat;
+    if (q1->t != q2->t)
+        return q1->t < q2->t ? -1 : 1;
+    return q1->i - q2->i;
+}
+/* set ephemeris index from keys ---------------------------------------------*/
+static void setephidx(ephidx_t *ie, ephkey_t *key, int nkey, int n)
+{
+    int i;
+
+    free(ie->idx);
+    ie->idx = NULL;
+    ie->n = 0;
+    for (i = 0; i <= MAXSAT; i++)
+        ie->off[i] = 0;
+    if (n <= 0)
+        return;
+
+    qsort(key, nkey, sizeof(ephkey_t), cmpephkey);
+
+    ie->idx = imat(nkey > 0 ? nkey : 1, 1);
+    for (i = 0; i < nkey; i++)
+    {
+        ie->idx[i] = key[i].i;
+        ie->off[key[i].sat]++;
+    }
+    for (i = 0; i < MAXSAT; i++)
+        ie->off[i + 1] += ie->off[i];
+    ie->n = n;
+}
+/* index ephemeris by satellite ------------------------------------------------
+ * build per-satellite index of broadcast and glonass ephemeris sorted by toe
+ * for seleph() and selgeph()
+ * args   : nav_t  *nav      IO  navigation data
+ * return : none
+ * notes  : called by uniqnav(). the index is ignored if the number of ephemeris
+ *          is changed. call again if ephemeris are modified in place
+ *-----------------------------------------------------------------------------*/
+extern void ephindex(nav_t *nav)
+{
+    ephkey_t *key;
+    int i, n = 0;
+
+    trace(3, "ephindex: n=%d ng=%d\n", nav->n, nav->ng);
+
+    if (!(key = (ephkey_t *)malloc(sizeof(ephkey_t) * ((nav->n > nav->ng ? nav->n : nav->ng) + 1))))
+    {
+        trace(1, "ephindex malloc error n=%d ng=%d\n", nav->n, nav->ng);
+        return;
+    }
+    for (i = 0; i < nav->n; i++)
+    {
+        if (nav->eph[i].sat <= 0 || nav->eph[i].sat > MAXSAT)
+            continue;
+        key[n].sat = nav->eph[i].sat;
+        key[n].t = timediff(nav->eph[i].toe, nav->eph[0].toe);
+        key[n++].i = i;
+    }
+    setephidx(&nav->ie, key, n, nav->n);
+
+    for (i = n = 0; i < nav->ng; i++)
+    {
+        if (nav->geph[i].sat <= 0 || nav->geph[i].sat > MAXSAT)
+            continue;
+        key[n].sat = nav->geph[i].sat;
+        key[n].t = timediff(nav->geph[i].toe, nav->geph[0].toe);
+        key[n++].i = i;
+    }
+    setephidx(&nav->ig, key, n, nav->ng);
+
+    free(key);
+}
+/* status of satellite state cache --------------------------------------------
+ * get hit and miss counts of thread-local satellite state cache of satpos()
+ * args   : uint32_t *hit    O   number of cache hits since last call (NULL: no output)
+ *          uint32_t *miss   O   number of cache misses since last call (NULL: no output)
+ * return : none
+ * notes  : counters are reset
+ *-----------------------------------------------------------------------------*/
+extern void satcachestat(uint32_t *hit, uint32_t *miss)
+{
+    if (hit)
+        *hit = satcache_hit;
+    if (miss)
+        *miss = satcache_miss;
+    satcache_hit = satcache_miss = 0;
+}
@@ -1,4 +1,10 @@
 #include "rtklib.h"
+#include <sys/stat.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #define MAXRNXLEN (16 * MAXOBSTYPE + 4) /* max rinex record length */
 #define MAXPOSHEAD 1024
@@ -387,6 +393,368 @@ extern void freeproduct(nav_t *nav, pcvs_t *pcvs, pcvs_t *pcvr, stas_t *stas)
     }
 }
 
+/* product cache --------------------------------------------------------------
+ * parsed sp3/clk/dcb/fcb products are written to <cachedir>/<file>.cache after
+ * the first read and mapped on later runs. a cache is used only if version,
+ * build layout and source path/mtime/size in its header match.
+ *-----------------------------------------------------------------------------*/
+#define PCACHEVER 1 /* product cache format version */
+#define PC_SP3 1    /* product cache type: precise ephemeris */
+#define PC_CLK 2    /* product cache type: precise clock */
+#define PC_DCB 3    /* product cache type: dcb/bias */
+#define PC_FCB 4    /* product cache type: fcb */
+
+typedef struct
+{                       /* product cache header type */
+    char magic[8];      /* "RTKPCACH" */
+    int ver, type;      /* format version and product type */
+    int maxsat, maxrcv; /* MAXSAT/MAXRCV of writer */
+    int tsize, fsize;   /* sizeof(gtime_t)/sizeof(fcbd_t) of writer */
+    int n, ns, opt;     /* number of epochs/satellites, product options */
+    int64_t mtime;      /* modified time of source file */
+    int64_t size;       /* size of source file (bytes) */
+    char src[MAXSTRPATH]; /* source file path */
+} pcacheh_t;
+
+typedef struct
+{                           /* mapped product cache type */
+    const unsigned char *p; /* mapped data */
+    size_t size, pos;       /* size and read position (bytes) */
+} pcache_t;
+
+/* set product cache header --------------------------------------------------*/
+static int setpcacheh(pcacheh_t *h, const char *path, int type)
+{
+    memset(h, 0, sizeof(pcacheh_t));
+    memcpy(h->magic, "RTKPCACH", 8);
+    h->ver = PCACHEVER;
+    h->type = type;
+    h->maxsat = MAXSAT;
+    h->maxrcv = MAXRCV;
+    h->tsize = (int)sizeof(gtime_t);
+    h->fsize = (int)sizeof(fcbd_t);
+    strncpy(h->src, path, MAXSTRPATH - 1);
+    return filestat(path, &h->mtime, &h->size);
+}
+/* map product cache ---------------------------------------------------------*/
+static int mapcache(const char *file, pcache_t *c)
+{
+#ifndef WIN32
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(pcacheh_t))
+    {
+        close(fd);
+        return 0;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return 0;
+    c->p = (const unsigned char *)p;
+    c->size = (size_t)st.st_size;
+#else
+    FILE *fp;
+    unsigned char *p;
+    long size;
+
+    if (!(fp = fopen(file, "rb")))
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < (long)sizeof(pcacheh_t) || !(p = (unsigned char *)malloc(size)) || fread(p, size, 1, fp) != 1)
+    {
+        if (size >= (long)sizeof(pcacheh_t))
+            free(p);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    c->p = p;
+    c->size = (size_t)size;
+#endif
+    c->pos = 0;
+    return 1;
+}
+/* unmap product cache -------------------------------------------------------*/
+static void unmapcache(pcache_t *c)
+{
+#ifndef WIN32
+    munmap((void *)c->p, c->size);
+#else
+    free((void *)c->p);
+#endif
+    c->p = NULL;
+    c->size = c->pos = 0;
+}
+/* get block from product cache (NULL: out of data) --------------------------*/
+static const void *getblk(pcache_t *c, size_t n)
+{
+    const void *p;
+
+    if (c->pos + n > c->size)
+        return NULL;
+    p = c->p + c->pos;
+    c->pos += n;
+    return p;
+}
+/* copy block from product cache (NULL: out of data or no memory) ------------*/
+static void *dupblk(pcache_t *c, size_t n)
+{
+    const void *p;
+    void *q;
+
+    if (!(p = getblk(c, n)) || !(q = malloc(n + 1)))
+        return NULL;
+    memcpy(q, p, n);
+    return q;
+}
+/* copy optional block from product cache ------------------------------------*/
+static int dupopt(pcache_t *c, int opt, int mask, size_t n, void *q)
+{
+    if (!(opt & mask))
+        return 1;
+    return (*(void **)q = dupblk(c, n)) != NULL;
+}
+/* open product cache --------------------------------------------------------*/
+static int opencache(const char *dir, const char *path, int type, pcache_t *c, pcacheh_t *h)
+{
+    const pcacheh_t *hc;
+    char file[1024];
+
+    if (!*dir || !setpcacheh(h, path, type))
+        return 0;
+    cachepath(dir, path, ".cache", file);
+
+    if (!mapcache(file, c))
+        return 0;
+    hc = (const pcacheh_t *)getblk(c, sizeof(pcacheh_t));
+
+    if (memcmp(hc->magic, h->magic, 8) || hc->ver != h->ver || hc->type != h->type || hc->maxsat != h->maxsat ||
+        hc->maxrcv != h->maxrcv || hc->tsize != h->tsize || hc->fsize != h->fsize || hc->mtime != h->mtime ||
+        hc->size != h->size || strcmp(hc->src, h->src))
+    {
+        trace(3, "opencache: cache outdated %s\n", file);
+        unmapcache(c);
+        return 0;
+    }
+    h->n = hc->n;
+    h->ns = hc->ns;
+    h->opt = hc->opt;
+    return 1;
+}
+/* load precise ephemeris from product cache ---------------------------------*/
+static int loadpeph(pcache_t *c, const pcacheh_t *h, nav_t *nav)
+{
+    pephc_t *pe = &nav->pe;
+    const int *slot;
+    size_t n = (size_t)h->ns * h->n;
+
+    if (!(slot = (const int *)getblk(c, sizeof(int) * MAXSAT)))
+        return 0;
+    memcpy(pe->slot, slot, sizeof(int) * MAXSAT);
+    pe->ne = h->n;
+    pe->ns = h->ns;
+
+    return (pe->time = (gtime_t *)dupblk(c, sizeof(gtime_t) * h->n)) && (pe->index = (int *)dupblk(c, sizeof(int) * h->n)) &&
+           (pe->pos = (double *)dupblk(c, sizeof(double) * 4 * n)) && dupopt(c, h->opt, 1, sizeof(float) * 4 * n, &pe->std) &&
+           dupopt(c, h->opt, 2, sizeof(double) * 4 * n, &pe->vel) && dupopt(c, h->opt, 4, sizeof(float) * 4 * n, &pe->vst) &&
+           dupopt(c, h->opt, 8, sizeof(float) * 3 * n, &pe->cov) && dupopt(c, h->opt, 16, sizeof(float) * 3 * n, &pe->vco);
+}
+/* load precise clock from product cache -------------------------------------*/
+static int loadpclk(pcache_t *c, const pcacheh_t *h, nav_t *nav)
+{
+    pclkc_t *pc = &nav->pc;
+    const int *slot;
+    size_t n = (size_t)h->ns * h->n;
+
+    if (!(slot = (const int *)getblk(c, sizeof(int) * MAXSAT)))
+        return 0;
+    memcpy(pc->slot, slot, sizeof(int) * MAXSAT);
+    pc->nc = h->n;
+    pc->ns = h->ns;
+
+    return (pc->time = (gtime_t *)dupblk(c, sizeof(gtime_t) * h->n)) && (pc->index = (int *)dupblk(c, sizeof(int) * h->n)) &&
+           (pc->clk = (double *)dupblk(c, sizeof(double) * n)) && dupopt(c, h->opt, 1, sizeof(float) * n, &pc->std);
+}
+/* load dcb from product cache -----------------------------------------------*/
+static int loaddcb(pcache_t *c, nav_t *nav)
+{
+    const void *cbias, *rbias;
+
+    if (!(cbias = getblk(c, sizeof(nav->cbias))) || !(rbias = getblk(c, sizeof(nav->rbias))))
+        return 0;
+    memcpy(nav->cbias, cbias, sizeof(nav->cbias));
+    memcpy(nav->rbias, rbias, sizeof(nav->rbias));
+    return 1;
+}
+/* load fcb from product cache -----------------------------------------------*/
+static int loadfcb(pcache_t *c, const pcacheh_t *h, nav_t *nav)
+{
+    const void *wlbias, *elbias;
+
+    if (!(wlbias = getblk(c, sizeof(nav->wlbias))) || !(elbias = getblk(c, sizeof(nav->elbias))))
+        return 0;
+    memcpy(nav->wlbias, wlbias, sizeof(nav->wlbias));
+    memcpy(nav->elbias, elbias, sizeof(nav->elbias));
+
+    if (h->n > 0 && !(nav->fcb = (fcbd_t *)dupblk(c, sizeof(fcbd_t) * h->n)))
+        return 0;
+    nav->nf = nav->nfmax = h->n;
+    return 1;
+}
+/* load product from cache -----------------------------------------------------
+ * args   : char   *dir        I   cache directory ("": no cache)
+ *          char   *path       I   product file path
+ *          int    type        I   product type (PC_???)
+ *          nav_t  *nav        IO  navigation data
+ * return : status (1:loaded from cache,0:no valid cache)
+ *-----------------------------------------------------------------------------*/
+static int loadcache(const char *dir, const char *path, int type, nav_t *nav)
+{
+    pcache_t c = {0};
+    pcacheh_t h;
+    int stat = 0;
+
+    if (!opencache(dir, path, type, &c, &h))
+        return 0;
+
+    switch (type)
+    {
+    case PC_SP3:
+        if (!(stat = loadpeph(&c, &h, nav)))
+            freenav(nav, 0x008);
+        break;
+    case PC_CLK:
+        if (!(stat = loadpclk(&c, &h, nav)))
+            freenav(nav, 0x010);
+        break;
+    case PC_DCB:
+        stat = loaddcb(&c, nav);
+        break;
+    case PC_FCB:
+        if (!(stat = loadfcb(&c, &h, nav)))
+        {
+            free(nav->fcb);
+            nav->fcb = NULL;
+            nav->nf = nav->nfmax = 0;
+        }
+        break;
+    }
+    unmapcache(&c);
+
+    trace(2, "loadcache: type=%d n=%d stat=%d %s\n", type, h.n, stat, path);
+    return stat;
+}
+/* save product to cache -------------------------------------------------------
+ * args   : char   *dir        I   cache directory ("": no cache)
+ *          char   *path       I   product file path (wild-card not cached)
+ *          int    type        I   product type (PC_???)
+ *          nav_t  *nav        I   navigation data
+ * return : status (1:ok,0:error)
+ * notes  : cache is written to a temporary file and renamed to be safe for
+ *          concurrent jobs sharing the cache directory
+ *-----------------------------------------------------------------------------*/
+static int savecache(const char *dir, const char *path, int type, const nav_t *nav)
+{
+    const pephc_t *pe = &nav->pe;
+    const pclkc_t *pc = &nav->pc;
+    FILE *fp;
+    pcacheh_t h;
+    size_t n = 0;
+    char file[1024], tmp[1100];
+    int stat = 1;
+
+    if (!*dir || !setpcacheh(&h, path, type))
+        return 0;
+    cachepath(dir, path, ".cache", file);
+#ifndef WIN32
+    sprintf(tmp, "%s.%d", file, (int)getpid());
+#else
+    sprintf(tmp, "%s.tmp", file);
+#endif
+    switch (type)
+    {
+    case PC_SP3:
+        if (pe->ne <= 0)
+            return 0;
+        h.n = pe->ne;
+        h.ns = pe->ns;
+        h.opt = (pe->std ? 1 : 0) | (pe->vel ? 2 : 0) | (pe->vst ? 4 : 0) | (pe->cov ? 8 : 0) | (pe->vco ? 16 : 0);
+        n = (size_t)pe->ns * pe->ne;
+        break;
+    case PC_CLK:
+        if (pc->nc <= 0)
+            return 0;
+        h.n = pc->nc;
+        h.ns = pc->ns;
+        h.opt = pc->std ? 1 : 0;
+        n = (size_t)pc->ns * pc->nc;
+        break;
+    case PC_FCB:
+        h.n = nav->nf;
+        break;
+    }
+    if (!(fp = fopen(tmp, "wb")))
+    {
+        trace(2, "savecache: cache open error %s\n", tmp);
+        return 0;
+    }
+    stat &= fwrite(&h, sizeof(h), 1, fp) == 1;
+
+    switch (type)
+    {
+    case PC_SP3:
+        stat &= fwrite(pe->slot, sizeof(int), MAXSAT, fp) == MAXSAT;
+        stat &= fwrite(pe->time, sizeof(gtime_t), pe->ne, fp) == (size_t)pe->ne;
+        stat &= fwrite(pe->index, sizeof(int), pe->ne, fp) == (size_t)pe->ne;
+        stat &= fwrite(pe->pos, sizeof(double) * 4, n, fp) == n;
+        stat &= !pe->std || fwrite(pe->std, sizeof(float) * 4, n, fp) == n;
+        stat &= !pe->vel || fwrite(pe->vel, sizeof(double) * 4, n, fp) == n;
+        stat &= !pe->vst || fwrite(pe->vst, sizeof(float) * 4, n, fp) == n;
+        stat &= !pe->cov || fwrite(pe->cov, sizeof(float) * 3, n, fp) == n;
+        stat &= !pe->vco || fwrite(pe->vco, sizeof(float) * 3, n, fp) == n;
+        break;
+    case PC_CLK:
+        stat &= fwrite(pc->slot, sizeof(int), MAXSAT, fp) == MAXSAT;
+        stat &= fwrite(pc->time, sizeof(gtime_t), pc->nc, fp) == (size_t)pc->nc;
+        stat &= fwrite(pc->index, sizeof(int), pc->nc, fp) == (size_t)pc->nc;
+        stat &= fwrite(pc->clk, sizeof(double), n, fp) == n;
+        stat &= !pc->std || fwrite(pc->std, sizeof(float), n, fp) == n;
+        break;
+    case PC_DCB:
+        stat &= fwrite(nav->cbias, sizeof(nav->cbias), 1, fp) == 1;
+        stat &= fwrite(nav->rbias, sizeof(nav->rbias), 1, fp) == 1;
+        break;
+    case PC_FCB:
+        stat &= fwrite(nav->wlbias, sizeof(nav->wlbias), 1, fp) == 1;
+        stat &= fwrite(nav->elbias, sizeof(nav->elbias), 1, fp) == 1;
+        stat &= nav->nf <= 0 || fwrite(nav->fcb, sizeof(fcbd_t), nav->nf, fp) == (size_t)nav->nf;
+        break;
+    }
+    stat &= fclose(fp) == 0;
+
+    if (stat)
+    {
+#ifdef WIN32
+        remove(file);
+#endif
+        stat = rename(tmp, file) == 0;
+    }
+    if (!stat)
+    {
+        trace(2, "savecache: cache write error %s\n", file);
+        remove(tmp);
+        return 0;
+    }
+    trace(2, "savecache: type=%d n=%d %s\n", type, h.n, file);
+    return 1;
+}
 /* file to nav&pcv data ------------------------------------------------ */
 extern int readproduct(const prcopt_t *prcopt, const filopt_t *fopt, nav_t *nav, pcvs_t *pcvss, pcvs_t *pcvsr,
                        stas_t *stas)
@@ -420,21 +788,29 @@ extern int readproduct(const prcopt_t *prcopt, const filopt_t *fopt, nav_t *nav,
     /* read precise clk */
     if (*fopt->clk && (ext = strrchr(fopt->clk, '.')) && (!strcmp(ext, ".clk") || !strcmp(ext, ".CLK")))
     {
-        free(nav->pclk);
-        nav->pclk = NULL;
-        nav->nc = nav->ncmax = 0;
+        freenav(nav, 0x010);
         reppath(fopt->clk, path, ts, "", "");
-        readrnxc(path, nav);
+        if (!loadcache(fopt->cachedir, path, PC_CLK, nav) && readrnxc(path, nav) > 0)
+        {
+            savecache(fopt->cachedir, path, PC_CLK, nav);
+        }
     }
 
     /* read precise orb */
     if (*fopt->sp3 && (ext = strrchr(fopt->sp3, '.')) && (!strcmp(ext, ".sp3") || !strcmp(ext, ".SP3")))
     {
-        free(nav->peph);
-        nav->peph = NULL;
-        nav->ne = nav->nemax = 0;
+        freenav(nav, 0x008);
         reppath(fopt->sp3, path, ts, "", "");
-        readsp3(path, nav, 0);
+        if (loadcache(fopt->cachedir, path, PC_SP3, nav))
+        {
+            if (prcopt->orbfit)
+                fitpeph(nav);
+        }
+        else
+        {
+            readsp3(path, nav, prcopt->orbfit ? 8 : 0);
+            savecache(fopt->cachedir, path, PC_SP3, nav);
+        }
     }
 
     /* read erp data */
@@ -454,7 +830,10 @@ extern int readproduct(const prcopt_t *prcopt, const filopt_t *fopt, nav_t *nav,
     if (*fopt->dcb && (ext = strrchr(fopt->dcb, '.')) && ((!strcmp(ext, ".BIA")) || !strcmp(ext, ".DCB")))
     {
         reppath(fopt->dcb, path, ts, "", "");
-        readdcb(path, nav);
+        if (!loadcache(fopt->cachedir, path, PC_DCB, nav) && readdcb(path, nav))
+        {
+            savecache(fopt->cachedir, path, PC_DCB, nav);
+        }
     }
 
     /* read GIM inon */
@@ -475,9 +854,13 @@ extern int readproduct(const prcopt_t *prcopt, const filopt_t *fopt, nav_t *nav,
     if (*fopt->fcb && (ext = strrchr(fopt->fcb, '.')) /*&& (!strcmp(ext, ".fcb"))*/)
     {
         free(nav->fcb);
+        nav->fcb = NULL;
         nav->nf = nav->nfmax = 0;
         reppath(fopt->fcb, path, ts, "", "");
-        readfcb_sgg(path, nav);
+        if (!loadcache(fopt->cachedir, path, PC_FCB, nav) && readfcb_sgg(path, nav))
+        {
+            savecache(fopt->cachedir, path, PC_FCB, nav);
+        }
     }
     /* read ifcb file */
     if (*fopt->ifcb && (ext = strrchr(fopt->ifcb, '.')) && (!strcmp(ext, ".ifcb")))
@@ -527,6 +910,8 @@ extern int readproduct(const prcopt_t *prcopt, const filopt_t *fopt, nav_t *nav,
 /* read obs data ----------------------------------------------------- */
 extern int readobs(const char *infile, int rcv, const prcopt_t *popt, obs_t *obs, sta_t *sta, int *nepoch)
 {
+    int stat;
+
     trace(3, "readobs:  n=%d\n");
 
     if (nepoch)
@@ -535,6 +920,10 @@ extern int readobs(const char *infile, int rcv, const prcopt_t *popt, obs_t *obs
     if (checkbrk(""))
         return 0;
 
+    /* read binary obs container */
+    if ((stat = readobc(infile, rcv, popt, obs, sta, nepoch)) >= 0)
+        return stat;
+
     /* read rinex obs and nav file */
     if (readrnxt(infile, rcv, popt->ts, popt->te, popt->ti, popt->rnxopt[0], obs, NULL, sta) < 0)
     {
@@ -553,6 +942,97 @@ extern int readobs(const char *infile, int rcv, const prcopt_t *popt, obs_t *obs
 
     return 1;
 }
+/* add current epoch of obs stream to obs data -------------------------------*/
+static int addobsstr(obs_t *obs, const obsstr_t *str)
+{
+    obsd_t *obs_data;
+    int n = str->rnx.obs.n;
+
+    if (obs->nmax < obs->n + n)
+    {
+        obs->nmax = obs->nmax <= 0 ? MAXOBS * 64 : obs->nmax * 2;
+        if (obs->nmax < obs->n + n)
+            obs->nmax = obs->n + n;
+        if (!(obs_data = (obsd_t *)realloc(obs->data, sizeof(obsd_t) * obs->nmax)))
+        {
+            trace(1, "addobsstr: memalloc error n=%dx%d\n", sizeof(obsd_t), obs->nmax);
+            return 0;
+        }
+        obs->data = obs_data;
+    }
+    memcpy(obs->data + obs->n, str->rnx.obs.data, sizeof(obsd_t) * n);
+    obs->n += n;
+    return 1;
+}
+/* read obs data window --------------------------------------------------------
+ * read next window of obs data from obs streams
+ * args   : obsstr_t *str IO  obs streams (str[0]:rover,str[1-]:reference)
+ *          int    nstr   I   number of obs streams
+ *          int    nep    I   number of rover epochs in window
+ *          obs_t  *obs   IO  obs data window (replaced by next window)
+ * return : number of rover epochs in window (0:end of data,-1:error)
+ * notes  : obs data of reference streams are read up to the first epoch after
+ *          the last rover epoch of window and the last two epochs of them in
+ *          previous window are kept to select reference epochs by time.
+ *          obs data in window are sorted by sortobs() as readobs()
+ *-----------------------------------------------------------------------------*/
+extern int readobsw(obsstr_t *str, int nstr, int nep, obs_t *obs)
+{
+    gtime_t t0[MAXRCV] = {{0}}, t1 = {0}, t;
+    int i, j, k, n;
+
+    trace(3, "readobsw: nstr=%d nep=%d\n", nstr, nep);
+
+    if (nstr <= 0 || str[0].rnx.obs.n <= 0)
+        return 0;
+
+    /* keep last two epochs of reference streams */
+    for (i = 1; i < nstr; i++)
+    {
+        for (j = obs->n - 1, k = 0; j >= 0 && k < 2; j--)
+        {
+            if (obs->data[j].rcv != str[i].rcv || (k > 0 && timediff(obs->data[j].time, t0[i]) >= -DTTOL))
+                continue;
+            t0[i] = obs->data[j].time;
+            k++;
+        }
+    }
+    for (j = n = 0; j < obs->n; j++)
+    {
+        for (i = 1; i < nstr; i++)
+        {
+            if (obs->data[j].rcv == str[i].rcv && timediff(obs->data[j].time, t0[i]) >= -DTTOL)
+                break;
+        }
+        if (i < nstr)
+            obs->data[n++] = obs->data[j];
+    }
+    obs->n = n;
+
+    /* rover epochs */
+    for (k = 0; k < nep && str[0].rnx.obs.n > 0; k++)
+    {
+        if (!addobsstr(obs, str))
+            return -1;
+        t1 = str[0].rnx.obs.data[0].time;
+        next_obsstr(str);
+    }
+    /* reference epochs up to first epoch after window */
+    for (i = 1; i < nstr; i++)
+    {
+        while (str[i].rnx.obs.n > 0)
+        {
+            if (!addobsstr(obs, str + i))
+                return -1;
+            t = str[i].rnx.obs.data[0].time;
+            next_obsstr(str + i);
+            if (timediff(t, t1) > DTTOL)
+                break;
+        }
+    }
+    sortobs(obs);
+    return k;
+}
 
 extern void decode_corr(const char *file, nav_t *nav, int dt, int opt)
 {
@@ -9,6 +9,8 @@
 #define ERR_TROP 3.0       /* tropspheric delay std (m) */
 #define ERR_BRDCI 0.5      /* broadcast iono model error factor */
 #define MIN_EL (5.0 * D2R) /* min elevation for measurement error (rad) */
+#define ROB_K0 2.0         /* default IGG-III threshold k0 of standardized innovation */
+#define ROB_K1 6.0         /* default IGG-III threshold k1 of standardized innovation */
 
 #define SWAP_I(x, y)                                                                                                   \
     do                                                                                                                 \
@@ -124,6 +126,7 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
 {
     sol_t sol0 = {{0}};
     ssat_t ssat0 = {0};
+    filtws_t ws0 = {0};
     int i;
 
     trace(3, "rtkinit :\n");
@@ -138,11 +141,21 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     rtk->P = zeros(rtk->nx, rtk->nx);
     rtk->xa = zeros(rtk->na, 1);
     rtk->Pa = zeros(rtk->na, rtk->na);
+    rtk->ix = imat(rtk->nx, 1);
+    rtk->nix = 0;
+    rtk->ws = ws0;
+    if (opt->robust == ROBUST_IGG3)
+    {
+        rtk->ws.rob[0] = opt->robthres[0] > 0.0 ? opt->robthres[0] : ROB_K0;
+        rtk->ws.rob[1] = opt->robthres[1] > rtk->ws.rob[0] ? opt->robthres[1] : ROB_K1;
+    }
+    rtk->niter = rtk->nsave = rtk->nrob[0] = rtk->nrob[1] = 0;
     rtk->nfix = rtk->neb = 0;
     for (i = 0; i < MAXSAT; i++)
     {
         rtk->ssat[i] = ssat0;
         rtk->ssat[i].sys = satsys(i + 1, NULL);
+        rtk->slot[i] = NSLOT(opt) < MAXSAT ? 0 : i + 1; /* compact or one slot per satellite */
     }
     for (i = 0; i < MAXERRMSG; i++)
         rtk->errbuf[i] = 0;
@@ -168,6 +181,10 @@ extern void rtkfree(rtk_t *rtk)
     rtk->xa = NULL;
     free(rtk->Pa);
     rtk->Pa = NULL;
+    free(rtk->ix);
+    rtk->ix = NULL;
+    rtk->nix = 0;
+    freefiltws(&rtk->ws);
 }
 
 /* bd-2 satellite code multipath--------------------------------------------*/
@@ -367,7 +384,7 @@ extern int ionocorr(gtime_t time, const double *pos, const double *azel, const p
     }
     if (opt->ionoopt == IONOOPT_EST)
     {
-        *dion = x[II(sat, opt)];
+        *dion = x[0]; /* ionospheric state of the satellite */
         *var = 0.0;
         return 1;
     }
@@ -35,8 +35,9 @@
 /* LD factorization (Q=L'*diag(D)*L) -----------------------------------------*/
 extern int LD(int n, const double *Q, double *L, double *D)
 {
+    void *mk = arenamark();
     int i, j, k, info = 0;
-    double a, *A = mat(n, n);
+    double a, *A = amat(n, n);
 
     memcpy(A, Q, sizeof(double) * n * n);
     for (i = n - 1; i >= 0; i--)
@@ -56,7 +57,7 @@ extern int LD(int n, const double *Q, double *L, double *D)
         for (j = 0; j <= i; j++)
             L[i + j * n] /= L[i + i * n];
     }
-    free(A);
+    arenarelease(mk);
     if (info)
         fprintf(stderr, "%s : LD factorization error\n", __FILE__);
     return info;
@@ -130,9 +131,10 @@ static void reduction(int n, double *L, double *D, double *Z)
            s      O  sum of residuals for fixed solutions                    */
 static int search(int n, int m, const double *L, const double *D, const double *zs, double *zn, double *s)
 {
+    void *mk = arenamark();
     int i, j, k, c, nn = 0, imax = 0;
     double newdist, maxdist = 1E99, y;
-    double *S = zeros(n, n), *dist = mat(n, 1), *zb = mat(n, 1), *z = mat(n, 1), *step = mat(n, 1);
+    double *S = azeros(n, n), *dist = amat(n, 1), *zb = amat(n, 1), *z = amat(n, 1), *step = amat(n, 1);
 
     k = n - 1;
     dist[k] = 0.0;
@@ -210,11 +212,7 @@ static int search(int n, int m, const double *L, const double *D, const double *
                 SWAP(zn[k + i * n], zn[k + j * n]);
         }
     }
-    free(S);
-    free(dist);
-    free(zb);
-    free(z);
-    free(step);
+    arenarelease(mk);
 
     if (c >= LOOPMAX)
     {
@@ -261,16 +259,17 @@ extern double normcdf(double x)
  *-----------------------------------------------------------------------------*/
 extern int lambda(int n, int m, const double *a, const double *Q, double *F, double *s)
 {
+    void *mk = arenamark();
     int i, info;
     double *L, *D, *Z, *z, *E;
 
     if (n <= 0 || m <= 0)
         return -1;
-    L = zeros(n, n);
-    D = mat(n, 1);
-    Z = eye(n);
-    z = mat(n, 1);
-    E = mat(n, m);
+    L = azeros(n, n);
+    D = amat(n, 1);
+    Z = aeye(n);
+    z = amat(n, 1);
+    E = amat(n, m);
 
     /* LD (lower diaganol) factorization (Q=L'*diag(D)*L) */
     if (!(info = LD(n, Q, L, D)))
@@ -289,11 +288,7 @@ extern int lambda(int n, int m, const double *a, const double *Q, double *F, dou
             info = solve("T", Z, E, n, m, F); /* F=Z'\E */
         }
     }
-    free(L);
-    free(D);
-    free(Z);
-    free(z);
-    free(E);
+    arenarelease(mk);
     return info;
 }
 /* lambda reduction ------------------------------------------------------------
@@ -305,14 +300,15 @@ extern int lambda(int n, int m, const double *a, const double *Q, double *F, dou
  *-----------------------------------------------------------------------------*/
 extern int lambda_reduction(int n, const double *Q, double *Z)
 {
+    void *mk = arenamark();
     double *L, *D;
     int i, j, info;
 
     if (n <= 0)
         return -1;
 
-    L = zeros(n, n);
-    D = mat(n, 1);
+    L = azeros(n, n);
+    D = amat(n, 1);
 
     for (i = 0; i < n; i++)
         for (j = 0; j < n; j++)
@@ -322,15 +318,13 @@ extern int lambda_reduction(int n, const double *Q, double *Z)
     /* LD factorization */
     if ((info = LD(n, Q, L, D)))
     {
-        free(L);
-        free(D);
+        arenarelease(mk);
         return info;
     }
     /* lambda reduction */
     reduction(n, L, D, Z);
 
-    free(L);
-    free(D);
+    arenarelease(mk);
     return 0;
 }
 /* mlambda search --------------------------------------------------------------
@@ -345,33 +339,33 @@ extern int lambda_reduction(int n, const double *Q, double *Z)
  *-----------------------------------------------------------------------------*/
 extern int lambda_search(int n, int m, const double *a, const double *Q, double *F, double *s)
 {
+    void *mk = arenamark();
     double *L, *D;
     int info;
 
     if (n <= 0 || m <= 0)
         return -1;
 
-    L = zeros(n, n);
-    D = mat(n, 1);
+    L = azeros(n, n);
+    D = amat(n, 1);
 
     /* LD factorization */
     if ((info = LD(n, Q, L, D)))
     {
-        free(L);
-        free(D);
+        arenarelease(mk);
         return info;
     }
     /* mlambda search */
     info = search(n, m, L, D, a, F, s);
 
-    free(L);
-    free(D);
+    arenarelease(mk);
     return info;
 }
 /* lambda par */
 extern int lambda_PAR(rtk_t *rtk, int na, int nb, int m, const double *a, double *b, const double *Qaa, double *Qbb,
                       const double *Qba)
 {
+    void *mk = arenamark();
     int i, j, k, info, ufix, fixN = 0;
     double *F, *E, *Z, *Z2, *Qz2z2, *Qbz2, *Qbb_, *s, P, trj1, trj2;
     double *L, *D, *z, *Lp, *Dp, *zp, *dz2;
@@ -379,21 +373,21 @@ extern int lambda_PAR(rtk_t *rtk, int na, int nb, int m, const double *a, double
     if (na <= 0 || m <= 0)
         return 0;
 
-    F = mat(na, m);
-    E = mat(nb, nb);
-    Z = eye(na);
-    Z2 = mat(na, na);
-    s = mat(m, 1);
-    dz2 = mat(na, 1);
-    Qz2z2 = mat(na, na);
-    Qbz2 = mat(nb, na);
-    Qbb_ = mat(nb, nb);
-    L = zeros(na, na);
-    D = mat(na, 1);
-    z = mat(na, 1);
-    Lp = mat(na, na);
-    Dp = mat(na, 1);
-    zp = mat(na, 1);
+    F = amat(na, m);
+    E = amat(nb, nb);
+    Z = aeye(na);
+    Z2 = amat(na, na);
+    s = amat(m, 1);
+    dz2 = amat(na, 1);
+    Qz2z2 = amat(na, na);
+    Qbz2 = amat(nb, na);
+    Qbb_ = amat(nb, nb);
+    L = azeros(na, na);
+    D = amat(na, 1);
+    z = amat(na, 1);
+    Lp = amat(na, na);
+    Dp = amat(na, 1);
+    zp = amat(na, 1);
 
     /* LD (lower diaganol) factorization (Q=L'*diag(D)*L) */
     if (!(info = LD(na, Qaa, L, D)))
@@ -420,13 +414,13 @@ extern int lambda_PAR(rtk_t *rtk, int na, int nb, int m, const double *a, double
 
             matmul("NN", nb, k, na, 1.0, Qba, Z2, 0.0, Qbz2);
             matmul("TN", k, na, na, 1.0, Z2, Qaa, 0.0, E);
-            matmul("NN", k, k, na, 1.0, E, Z2, 0.0, Qz2z2);
+            symmul("NN", k, na, 1.0, E, Z2, 0.0, Qz2z2);
 
             if (info = matinv(Qz2z2, k))
                 continue; /*Qz2z2-1 */
 
             matmul("NN", nb, k, k, 1.0, Qbz2, Qz2z2, 0.0, E);
-            matmul("NT", nb, nb, k, 1.0, E, Qbz2, 0.0, Qbb_);
+            symmul("NT", nb, k, 1.0, E, Qbz2, 0.0, Qbb_);
 
             for (i = trj1 = trj2 = 0; i < 3; i++)
             {
@@ -467,20 +461,6 @@ extern int lambda_PAR(rtk_t *rtk, int na, int nb, int m, const double *a, double
         }
     }
 
-    free(F);
-    free(E);
-    free(Z);
-    free(Z2);
-    free(s);
-    free(dz2);
-    free(Qz2z2);
-    free(Qbz2);
-    free(Qbb_);
-    free(L);
-    free(D);
-    free(z);
-    free(Lp);
-    free(Dp);
-    free(zp);
+    arenarelease(mk);
     return fixN;
 }
\ No newline at end of file
@@ -0,0 +1,858 @@
+/*------------------------------------------------------------------------------
+ * obsbin.c : binary observation container functions
+ *
+ *          binary observation container (obc) keeps parsed observation data of
+ *          a receiver for repeated processing without parsing rinex text.
+ *
+ *          container layout (host byte order):
+ *
+ *          header      : obch_t (version, build layout, station parameters,
+ *                        source file path/mtime/size and rinex options)
+ *          epoch data  : obs records of epochs (padded to 8 bytes)
+ *          index table : obcidx_t x number of epochs (time, offset, records)
+ *          signal table: obcsig_t x number of signals (sat, codes)
+ *
+ *          an obs record is a signal index followed by flags, presence mask of
+ *          L/P/D/SNR and the values encoded as zigzag varints of L/P/D (x 1000)
+ *          and SNR differenced from the same signal in the previous epoch.
+ *          every OBCKEY epochs are key epochs without differences to decode
+ *          epochs after random seek by the index table. records with values
+ *          not exactly represented in 1E-3 are saved as raw double/float.
+ *
+ * version : $Revision:$
+ * history : 2026/10/16 1.0  new
+ *-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+#include <sys/stat.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define OBCVER 2           /* container format version */
+#define OBCKEY 60          /* interval of key epochs */
+#define NOBCF (NFREQ + NEXOBS) /* number of frequencies in record */
+#define NOBCQ 4            /* number of values per frequency (L,P,D,SNR) */
+#define NOBCM ((NOBCF * NOBCQ + 7) / 8) /* bytes of presence mask */
+#define MAXOBCREC (16 + NOBCM + NOBCF + NOBCF * NOBCQ * 10) /* max record length */
+
+#define OBCF_LLI 0x01      /* record flag: lli present */
+#define OBCF_RAW 0x02      /* record flag: raw values */
+#define OBCM_SNR 0x8888    /* presence mask of SNR */
+
+#if NOBCF * NOBCQ > 16
+#error "obs container supports up to 4 frequencies (NFREQ+NEXOBS)"
+#endif
+
+typedef struct
+{                            /* container header type */
+    char magic[8];           /* "RTKOBSBC" */
+    int ver, nf;             /* format version and number of frequencies */
+    int maxsat, stasize;     /* MAXSAT and sizeof(sta_t) of writer */
+    int ne, nsig, key, pad;  /* number of epochs/signals, key epoch interval */
+    int64_t pidx, psig;      /* offsets of index and signal tables (bytes) */
+    int64_t mtime, size;     /* modified time and size of source file */
+    char src[MAXSTRPATH];    /* source file path */
+    char opt[256];           /* rinex options of source */
+    sta_t sta;               /* station parameters */
+} obch_t;
+
+typedef struct
+{                /* container epoch index type */
+    int64_t time; /* epoch time (time_t) */
+    double sec;  /* epoch time (fraction of second) */
+    int64_t pos; /* offset of epoch data (bytes) */
+    int n, pad;  /* number of obs records */
+} obcidx_t;
+
+typedef struct
+{                         /* container signal type */
+    uint8_t sat;          /* satellite number */
+    uint8_t code[NOBCF];  /* code indicators */
+} obcsig_t;
+
+typedef struct
+{                        /* container writer type */
+    FILE *fp;            /* output file */
+    obch_t h;            /* header */
+    obcidx_t *index;     /* epoch index table */
+    obcsig_t *sig;       /* signal table */
+    int nemax, nsmax;    /* allocated index/signal table */
+    int first[MAXSAT];   /* first signal of satellite (-1:none) */
+    int *next;           /* next signal of same satellite (-1:none) */
+    int64_t pos;         /* current offset (bytes) */
+    int64_t *val;        /* predicted values of signals */
+    uint16_t *vmask;     /* valid predicted values of signals */
+    int *iep;            /* last epoch of signals */
+} obcw_t;
+
+/* zigzag varint -------------------------------------------------------------*/
+static int putvar(uint8_t *p, int64_t v)
+{
+    uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    int n = 0;
+
+    while (u >= 0x80)
+    {
+        p[n++] = (uint8_t)(u | 0x80);
+        u >>= 7;
+    }
+    p[n++] = (uint8_t)u;
+    return n;
+}
+static const uint8_t *getvar(const uint8_t *p, const uint8_t *e, int64_t *v)
+{
+    uint64_t u = 0;
+    int s = 0;
+
+    for (; p < e && s < 64; s += 7)
+    {
+        u |= (uint64_t)(*p & 0x7F) << s;
+        if (!(*p++ & 0x80))
+        {
+            *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return p;
+        }
+    }
+    return NULL;
+}
+/* obs value as scaled integer (0:not exact) ---------------------------------*/
+static int scaleval(double val, int isfloat, int64_t *q)
+{
+    if (fabs(val) >= 9E15 / 1E3)
+        return 0;
+    *q = (int64_t)floor(val * 1E3 + 0.5);
+    return isfloat ? (float)(*q / 1E3) == (float)val : *q / 1E3 == val;
+}
+/* set container header ------------------------------------------------------*/
+static void setobch(obch_t *h)
+{
+    memset(h, 0, sizeof(obch_t));
+    memcpy(h->magic, "RTKOBSBC", 8);
+    h->ver = OBCVER;
+    h->nf = NOBCF;
+    h->maxsat = MAXSAT;
+    h->stasize = (int)sizeof(sta_t);
+    h->key = OBCKEY;
+}
+/* free container writer -----------------------------------------------------*/
+static void freeobcw(obcw_t *w)
+{
+    free(w->index);
+    free(w->sig);
+    free(w->next);
+    free(w->val);
+    free(w->vmask);
+    free(w->iep);
+    w->index = NULL;
+    w->sig = NULL;
+    w->next = NULL;
+    w->val = NULL;
+    w->vmask = NULL;
+    w->iep = NULL;
+}
+/* open container writer -----------------------------------------------------*/
+static int openobcw(obcw_t *w, const char *file, const sta_t *sta)
+{
+    int i;
+
+    memset(w, 0, sizeof(obcw_t));
+    setobch(&w->h);
+    if (sta)
+        w->h.sta = *sta;
+    for (i = 0; i < MAXSAT; i++)
+        w->first[i] = -1;
+
+    if (!(w->fp = fopen(file, "wb")))
+    {
+        trace(2, "openobcw: file open error %s\n", file);
+        return 0;
+    }
+    if (fwrite(&w->h, sizeof(obch_t), 1, w->fp) != 1)
+    {
+        fclose(w->fp);
+        return 0;
+    }
+    w->pos = (int64_t)sizeof(obch_t);
+    return 1;
+}
+/* signal index of obs data (-1:error) ---------------------------------------*/
+static int sigobcw(obcw_t *w, const obsd_t *data)
+{
+    obcsig_t *sig;
+    int i, *next, *iep;
+    int64_t *val;
+    uint16_t *vmask;
+
+    for (i = w->first[data->sat - 1]; i >= 0; i = w->next[i])
+    {
+        if (!memcmp(w->sig[i].code, data->code, NOBCF))
+            return i;
+    }
+    if (w->h.nsig >= w->nsmax)
+    {
+        w->nsmax = w->nsmax <= 0 ? 256 : w->nsmax * 2;
+        if (!(sig = (obcsig_t *)realloc(w->sig, sizeof(obcsig_t) * w->nsmax)) ||
+            !(w->sig = sig, next = (int *)realloc(w->next, sizeof(int) * w->nsmax)) ||
+            !(w->next = next, iep = (int *)realloc(w->iep, sizeof(int) * w->nsmax)) ||
+            !(w->iep = iep, vmask = (uint16_t *)realloc(w->vmask, sizeof(uint16_t) * w->nsmax)) ||
+            !(w->vmask = vmask, val = (int64_t *)realloc(w->val, sizeof(int64_t) * NOBCF * NOBCQ * w->nsmax)))
+        {
+            trace(1, "sigobcw: memory allocation error nsig=%d\n", w->nsmax);
+            return -1;
+        }
+        w->val = val;
+    }
+    i = w->h.nsig++;
+    w->sig[i].sat = data->sat;
+    memcpy(w->sig[i].code, data->code, NOBCF);
+    w->next[i] = w->first[data->sat - 1];
+    w->first[data->sat - 1] = i;
+    w->iep[i] = -1;
+    w->vmask[i] = 0;
+    return i;
+}
+/* encode obs record ---------------------------------------------------------*/
+static int encobcrec(obcw_t *w, const obsd_t *data, int s, int ie, uint8_t *buff)
+{
+    int64_t q[NOBCF * NOBCQ], *val = w->val + (size_t)s * NOBCF * NOBCQ;
+    uint16_t mask = 0, vmask;
+    uint8_t flag = 0, *p = buff;
+    int i, j, k, pred;
+
+    pred = w->iep[s] == ie - 1 && ie % OBCKEY != 0;
+    vmask = pred ? w->vmask[s] : 0;
+
+    for (i = 0; i < NOBCF; i++)
+    {
+        if (data->L[i] != 0.0)
+            mask |= 1 << (i * NOBCQ);
+        if (data->P[i] != 0.0)
+            mask |= 1 << (i * NOBCQ + 1);
+        if (data->D[i] != 0.0f)
+            mask |= 1 << (i * NOBCQ + 2);
+        if (data->SNR[i] != 0)
+            mask |= 1 << (i * NOBCQ + 3);
+        if (data->LLI[i])
+            flag |= OBCF_LLI;
+        q[i * NOBCQ + 3] = data->SNR[i];
+        if ((data->L[i] != 0.0 && !scaleval(data->L[i], 0, q + i * NOBCQ)) ||
+            (data->P[i] != 0.0 && !scaleval(data->P[i], 0, q + i * NOBCQ + 1)) ||
+            (data->D[i] != 0.0f && !scaleval(data->D[i], 1, q + i * NOBCQ + 2)))
+            flag |= OBCF_RAW;
+    }
+    p += putvar(p, s);
+    *p++ = flag;
+    for (i = 0; i < NOBCM; i++)
+        *p++ = (uint8_t)(mask >> (i * 8));
+    if (flag & OBCF_LLI)
+    {
+        for (i = 0; i < NOBCF; i++)
+            *p++ = data->LLI[i];
+    }
+    for (i = 0; i < NOBCF; i++)
+        for (j = 0; j < NOBCQ; j++)
+        {
+            k = i * NOBCQ + j;
+            if (!(mask & (1 << k)))
+                continue;
+            if ((flag & OBCF_RAW) && j < 2)
+            {
+                memcpy(p, j == 0 ? data->L + i : data->P + i, 8);
+                p += 8;
+            }
+            else if ((flag & OBCF_RAW) && j == 2)
+            {
+                memcpy(p, data->D + i, 4);
+                p += 4;
+            }
+            else
+            {
+                p += putvar(p, q[k] - ((vmask & (1 << k)) ? val[k] : 0));
+                val[k] = q[k];
+            }
+        }
+    /* raw L/P/D are not used for prediction */
+    w->vmask[s] = (flag & OBCF_RAW) ? mask & OBCM_SNR : mask;
+    w->iep[s] = ie;
+    return (int)(p - buff);
+}
+/* add epoch to container writer ---------------------------------------------*/
+static int addobcw(obcw_t *w, const obsd_t *data, int n)
+{
+    obcidx_t *index;
+    uint8_t buff[MAXOBCREC];
+    int i, s, len;
+
+    if (n <= 0)
+        return 1;
+    if (w->h.ne >= w->nemax)
+    {
+        w->nemax = w->nemax <= 0 ? 4096 : w->nemax * 2;
+        if (!(index = (obcidx_t *)realloc(w->index, sizeof(obcidx_t) * w->nemax)))
+        {
+            trace(1, "addobcw: memory allocation error ne=%d\n", w->nemax);
+            return 0;
+        }
+        w->index = index;
+    }
+    index = w->index + w->h.ne;
+    index->time = (int64_t)data[0].time.time;
+    index->sec = data[0].time.sec;
+    index->pos = w->pos;
+    index->n = n;
+    index->pad = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        if (data[i].sat <= 0 || data[i].sat > MAXSAT || (s = sigobcw(w, data + i)) < 0)
+            return 0;
+        len = encobcrec(w, data + i, s, w->h.ne, buff);
+        if (fwrite(buff, len, 1, w->fp) != 1)
+            return 0;
+        w->pos += len;
+    }
+    w->h.ne++;
+    return 1;
+}
+/* close container writer ----------------------------------------------------*/
+static int closeobcw(obcw_t *w, int stat)
+{
+    static const uint8_t pad[8] = {0};
+    int np = (int)((8 - w->pos % 8) % 8);
+
+    /* index table aligned to 8 bytes for in-place access */
+    w->h.pidx = w->pos + np;
+    w->h.psig = w->h.pidx + (int64_t)sizeof(obcidx_t) * w->h.ne;
+
+    stat = stat && (np == 0 || fwrite(pad, np, 1, w->fp) == 1);
+    stat = stat && fwrite(w->index, sizeof(obcidx_t), w->h.ne, w->fp) == (size_t)w->h.ne;
+    stat = stat && fwrite(w->sig, sizeof(obcsig_t), w->h.nsig, w->fp) == (size_t)w->h.nsig;
+    stat = stat && fseek(w->fp, 0, SEEK_SET) == 0 && fwrite(&w->h, sizeof(obch_t), 1, w->fp) == 1;
+    stat = (fclose(w->fp) == 0) && stat;
+    freeobcw(w);
+    return stat;
+}
+/* rename temporary container ------------------------------------------------*/
+static int renameobc(const char *tmp, const char *file, int stat)
+{
+    if (stat)
+    {
+#ifdef WIN32
+        remove(file);
+#endif
+        stat = rename(tmp, file) == 0;
+    }
+    if (!stat)
+    {
+        trace(2, "obc write error %s\n", file);
+        remove(tmp);
+    }
+    return stat;
+}
+/* temporary container path --------------------------------------------------*/
+static void tmppath(const char *file, char *tmp)
+{
+#ifndef WIN32
+    sprintf(tmp, "%.1000s.%d", file, (int)getpid());
+#else
+    sprintf(tmp, "%.1000s.tmp", file);
+#endif
+}
+/* write binary observation container ------------------------------------------
+ * write observation data to binary observation container
+ * args   : char   *file    I   container file path
+ *          obs_t  *obs     I   observation data (sorted by sortobs())
+ *          sta_t  *sta     I   station parameters (NULL: no parameters)
+ * return : number of epochs written (0:error)
+ * notes  : obs data of all receivers in obs are written as one receiver.
+ *          container is written to a temporary file and renamed
+ *-----------------------------------------------------------------------------*/
+extern int writeobc(const char *file, const obs_t *obs, const sta_t *sta)
+{
+    obcw_t w;
+    char tmp[1100];
+    int i, j, stat;
+
+    trace(3, "writeobc: file=%s n=%d\n", file, obs->n);
+
+    tmppath(file, tmp);
+    if (!openobcw(&w, tmp, sta))
+        return 0;
+
+    for (i = 0, stat = 1; i < obs->n && stat; i = j)
+    {
+        for (j = i + 1; j < obs->n; j++)
+        {
+            if (obs->data[j].rcv != obs->data[i].rcv || timediff(obs->data[j].time, obs->data[i].time) > DTTOL)
+                break;
+        }
+        stat = addobcw(&w, obs->data + i, j - i);
+    }
+    i = w.h.ne;
+    if (!renameobc(tmp, file, closeobcw(&w, stat)))
+        return 0;
+    return i;
+}
+/* map container file --------------------------------------------------------*/
+static int mapobc(const char *file, obc_t *obc)
+{
+#ifndef WIN32
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+        return 0;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(obch_t))
+    {
+        close(fd);
+        return 0;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return 0;
+    obc->p = (const uint8_t *)p;
+    obc->size = (size_t)st.st_size;
+#else
+    FILE *fp;
+    uint8_t *p;
+    long size;
+
+    if (!(fp = fopen(file, "rb")))
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size < (long)sizeof(obch_t) || !(p = (uint8_t *)malloc(size)) || fread(p, size, 1, fp) != 1)
+    {
+        if (size >= (long)sizeof(obch_t))
+            free(p);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    obc->p = p;
+    obc->size = (size_t)size;
+#endif
+    return 1;
+}
+/* unmap container file ------------------------------------------------------*/
+static void unmapobc(obc_t *obc)
+{
+#ifndef WIN32
+    munmap((void *)obc->p, obc->size);
+#else
+    free((void *)obc->p);
+#endif
+    obc->p = NULL;
+    obc->size = 0;
+}
+/* test container header -----------------------------------------------------*/
+static int testobch(const obch_t *h, size_t size)
+{
+    obch_t h0;
+
+    setobch(&h0);
+
+    return !memcmp(h->magic, h0.magic, 8) && h->ver == h0.ver && h->nf == h0.nf && h->maxsat == h0.maxsat &&
+           h->stasize == h0.stasize && h->ne >= 0 && h->nsig >= 0 && h->key == h0.key &&
+           h->pidx >= (int64_t)sizeof(obch_t) && h->pidx % 8 == 0 && h->psig == h->pidx + (int64_t)sizeof(obcidx_t) * h->ne &&
+           h->psig + (int64_t)sizeof(obcsig_t) * h->nsig == (int64_t)size;
+}
+/* open binary observation container -------------------------------------------
+ * open binary observation container to read epochs
+ * args   : obc_t  *obc     O   binary observation container
+ *          char   *file    I   container file path
+ * return : status (1:ok,0:not container or error)
+ * notes  : container is mapped to memory and the index table, the signal
+ *          table and epoch data are accessed in place without copy
+ *-----------------------------------------------------------------------------*/
+extern int open_obc(obc_t *obc, const char *file)
+{
+    const obch_t *h;
+    int i;
+
+    trace(3, "open_obc: file=%s\n", file);
+
+    memset(obc, 0, sizeof(obc_t));
+
+    if (!mapobc(file, obc))
+        return 0;
+    h = (const obch_t *)obc->p;
+
+    if (!testobch(h, obc->size) || (uintptr_t)(obc->p + h->pidx) % sizeof(int64_t))
+    {
+        trace(2, "open_obc: not obs container %s\n", file);
+        unmapobc(obc);
+        return 0;
+    }
+    obc->ne = h->ne;
+    obc->nsig = h->nsig;
+    obc->index = obc->p + h->pidx;
+    obc->sig = obc->p + h->psig;
+    obc->sta = h->sta;
+    obc->ie = 0;
+    obc->id = -1;
+
+    if (!(obc->val = (int64_t *)malloc(sizeof(int64_t) * NOBCF * NOBCQ * (obc->nsig + 1))) ||
+        !(obc->vmask = (uint16_t *)malloc(sizeof(uint16_t) * (obc->nsig + 1))) ||
+        !(obc->iep = (int *)malloc(sizeof(int) * (obc->nsig + 1))))
+    {
+        close_obc(obc);
+        return 0;
+    }
+    for (i = 0; i <= obc->nsig; i++)
+    {
+        obc->iep[i] = -1;
+        obc->vmask[i] = 0;
+    }
+    return 1;
+}
+/* close binary observation container ------------------------------------------
+ * close binary observation container
+ * args   : obc_t  *obc     IO  binary observation container
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void close_obc(obc_t *obc)
+{
+    trace(3, "close_obc:\n");
+
+    if (obc->p)
+        unmapobc(obc);
+    free(obc->val);
+    free(obc->vmask);
+    free(obc->iep);
+    obc->val = NULL;
+    obc->vmask = NULL;
+    obc->iep = NULL;
+    obc->ne = obc->nsig = 0;
+}
+/* epoch time of index -------------------------------------------------------*/
+static gtime_t idxtime(const obcidx_t *index)
+{
+    gtime_t time;
+
+    time.time = (time_t)index->time;
+    time.sec = index->sec;
+    return time;
+}
+/* seek binary observation container -------------------------------------------
+ * seek binary observation container to epoch by time
+ * args   : obc_t  *obc     IO  binary observation container
+ *          gtime_t time    I   time (GPST)
+ * return : index of next epoch to read (first epoch at or after time)
+ *-----------------------------------------------------------------------------*/
+extern int seek_obc(obc_t *obc, gtime_t time)
+{
+    const obcidx_t *index = (const obcidx_t *)obc->index;
+    int i = 0, j = obc->ne, k;
+
+    while (i < j)
+    {
+        k = (i + j) / 2;
+        if (timediff(idxtime(index + k), time) < -DTTOL)
+            i = k + 1;
+        else
+            j = k;
+    }
+    trace(3, "seek_obc: time=%s ie=%d\n", time_str(time, 3), i);
+    return obc->ie = i;
+}
+/* decode epoch of container (data==NULL: only update predicted values) ------*/
+static int decobcep(obc_t *obc, int ie, obsd_t *data, int nmax)
+{
+    const obcidx_t *index = (const obcidx_t *)obc->index + ie;
+    const obcsig_t *sig = (const obcsig_t *)obc->sig;
+    const uint8_t *p = obc->p + index->pos, *e = obc->index;
+    obsd_t obs = {{0}};
+    int64_t v, *val;
+    uint16_t mask, vmask;
+    uint8_t flag;
+    int i, j, k, n, s, pred;
+
+    if (index->pos < (int64_t)sizeof(obch_t) || p > e)
+        return -1;
+
+    for (n = 0; n < index->n; n++)
+    {
+        if (!(p = getvar(p, e, &v)) || v < 0 || v >= obc->nsig || p + 1 + NOBCM > e)
+            return -1;
+        s = (int)v;
+        flag = *p++;
+        for (i = 0, mask = 0; i < NOBCM; i++)
+            mask |= (uint16_t)(*p++ << (i * 8));
+
+        if (data)
+        {
+            memset(&obs, 0, sizeof(obsd_t));
+            obs.time = idxtime(index);
+            obs.sat = sig[s].sat;
+            memcpy(obs.code, sig[s].code, NOBCF);
+        }
+        if (flag & OBCF_LLI)
+        {
+            if (p + NOBCF > e)
+                return -1;
+            memcpy(obs.LLI, p, NOBCF);
+            p += NOBCF;
+        }
+        pred = obc->iep[s] == ie - 1 && ie % OBCKEY != 0;
+        vmask = pred ? obc->vmask[s] : 0;
+        val = obc->val + (size_t)s * NOBCF * NOBCQ;
+
+        for (i = 0; i < NOBCF; i++)
+            for (j = 0; j < NOBCQ; j++)
+            {
+                k = i * NOBCQ + j;
+                if (!(mask & (1 << k)))
+                    continue;
+                if ((flag & OBCF_RAW) && j < 2)
+                {
+                    if (p + 8 > e)
+                        return -1;
+                    memcpy(j == 0 ? obs.L + i : obs.P + i, p, 8);
+                    p += 8;
+                    continue;
+                }
+                if ((flag & OBCF_RAW) && j == 2)
+                {
+                    if (p + 4 > e)
+                        return -1;
+                    memcpy(obs.D + i, p, 4);
+                    p += 4;
+                    continue;
+                }
+                if (!(p = getvar(p, e, &v)))
+                    return -1;
+                val[k] = v + ((vmask & (1 << k)) ? val[k] : 0);
+                if (j == 0)
+                    obs.L[i] = val[k] / 1E3;
+                else if (j == 1)
+                    obs.P[i] = val[k] / 1E3;
+                else if (j == 2)
+                    obs.D[i] = (float)(val[k] / 1E3);
+                else
+                    obs.SNR[i] = (uint16_t)val[k];
+            }
+        obc->vmask[s] = (flag & OBCF_RAW) ? mask & OBCM_SNR : mask;
+        obc->iep[s] = ie;
+
+        if (data && n < nmax)
+            data[n] = obs;
+    }
+    return n < nmax ? n : nmax;
+}
+/* read epoch of binary observation container ----------------------------------
+ * read next epoch of binary observation container
+ * args   : obc_t  *obc     IO  binary observation container
+ *          obsd_t *data    O   obs data of epoch (rcv=0)
+ *          int    nmax     I   max number of obs data
+ * return : number of obs data (-2:end of container,-1:error)
+ * notes  : epochs after seek_obc() are decoded from the previous key epoch
+ *-----------------------------------------------------------------------------*/
+extern int read_obc(obc_t *obc, obsd_t *data, int nmax)
+{
+    int i, n;
+
+    trace(4, "read_obc: ie=%d\n", obc->ie);
+
+    if (obc->ie < 0 || obc->ie >= obc->ne)
+        return -2;
+
+    /* decode from key epoch for random access */
+    if (obc->id != obc->ie - 1)
+    {
+        for (i = obc->ie - obc->ie % OBCKEY; i < obc->ie; i++)
+        {
+            if (decobcep(obc, i, NULL, 0) < 0)
+                return -1;
+        }
+    }
+    if ((n = decobcep(obc, obc->ie, data, nmax)) < 0)
+    {
+        trace(2, "read_obc: container data error ie=%d\n", obc->ie);
+        return -1;
+    }
+    obc->id = obc->ie++;
+    return n;
+}
+/* read binary observation container -------------------------------------------
+ * read obs data from binary observation container as readobs()
+ * args   : char   *file    I   container file path
+ *          int    rcv      I   receiver number for obs data
+ *          prcopt_t *popt  I   processing options (ts,te,ti)
+ *          obs_t  *obs     IO  observation data
+ *          sta_t  *sta     IO  station parameters (NULL: no input)
+ *          int    *nepoch  O   number of epochs (NULL: no output)
+ * return : status (1:ok,0:error,-1:not container)
+ * notes  : all epochs are decoded to carry cycle-slips of screened epochs as
+ *          readrnxobs(). use seek_obc() and read_obc() for random access
+ *-----------------------------------------------------------------------------*/
+extern int readobc(const char *file, int rcv, const prcopt_t *popt, obs_t *obs, sta_t *sta, int *nepoch)
+{
+    obc_t obc;
+    obsd_t *data;
+    uint8_t slips[MAXSAT][NFREQ] = {{0}};
+    int i, j, n;
+
+    trace(3, "readobc: file=%s rcv=%d\n", file, rcv);
+
+    if (nepoch)
+        *nepoch = 0;
+
+    if (!open_obc(&obc, file))
+        return -1;
+    if (sta)
+        *sta = obc.sta;
+
+    if (!(data = (obsd_t *)malloc(sizeof(obsd_t) * MAXOBS)))
+    {
+        close_obc(&obc);
+        return 0;
+    }
+    while ((n = read_obc(&obc, data, MAXOBS)) >= 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            for (j = 0; j < NFREQ; j++)
+            {
+                if (data[i].LLI[j] & 1)
+                    slips[data[i].sat - 1][j] |= LLI_SLIP;
+            }
+        }
+        if (n <= 0 || !screent(data[0].time, popt->ts, popt->te, popt->ti))
+        {
+            if (popt->te.time && timediff(data[0].time, popt->te) > DTTOL)
+                break;
+            continue;
+        }
+        for (i = 0; i < n; i++)
+        {
+            for (j = 0; j < NFREQ; j++)
+            {
+                if (slips[data[i].sat - 1][j] & 1)
+                    data[i].LLI[j] |= LLI_SLIP;
+                slips[data[i].sat - 1][j] = 0;
+            }
+            data[i].rcv = (uint8_t)rcv;
+            if (addobsdata(obs, data + i) < 0)
+            {
+                n = -1;
+                break;
+            }
+        }
+        if (n < 0)
+            break;
+    }
+    free(data);
+    close_obc(&obc);
+
+    if (n == -1)
+    {
+        checkbrk("error : obs container read error");
+        return 0;
+    }
+    if (obs->n <= 0)
+    {
+        checkbrk("error : no obs data");
+        return 0;
+    }
+    if (nepoch)
+        *nepoch = sortobs(obs);
+    return 1;
+}
+/* test container for source file --------------------------------------------*/
+static int testobc(const char *file, const obch_t *h)
+{
+    obc_t obc;
+    const obch_t *hc;
+    int stat;
+
+    if (!mapobc(file, &obc))
+        return 0;
+    hc = (const obch_t *)obc.p;
+    stat = testobch(hc, obc.size) && hc->mtime == h->mtime && hc->size == h->size && !strcmp(hc->src, h->src) &&
+           !strcmp(hc->opt, h->opt);
+    unmapobc(&obc);
+    return stat;
+}
+/* cache rinex obs file as binary observation container ------------------------
+ * convert rinex obs file to binary observation container in cache directory
+ * at the first call and return the container path at later calls
+ * args   : char   *dir     I   cache directory ("": no cache)
+ *          char   *file    I   rinex obs file path (wild-card not cached)
+ *          char   *opt     I   rinex options
+ *          char   *path    O   path to read obs data (container or file)
+ * return : status (1:container,0:no container (path=file))
+ * notes  : container is <dir>/<file>.obc and used only if source path/mtime/
+ *          size and rinex options in its header match
+ *-----------------------------------------------------------------------------*/
+extern int cacheobc(const char *dir, const char *file, const char *opt, char *path)
+{
+    obsstr_t *str;
+    gtime_t t0 = {0};
+    obcw_t w;
+    obch_t h;
+    char cfile[1024], tmp[1100];
+    int stat = 1;
+
+    trace(3, "cacheobc: dir=%s file=%s\n", dir, file);
+
+    setobch(&h);
+    strncpy(h.src, file, MAXSTRPATH - 1);
+    strncpy(h.opt, opt, sizeof(h.opt) - 1);
+
+    if (!*dir || !filestat(file, &h.mtime, &h.size))
+    {
+        if (path != file)
+            strcpy(path, file);
+        return 0;
+    }
+    cachepath(dir, file, ".obc", cfile);
+
+    if (!testobc(cfile, &h))
+    {
+        /* convert rinex obs file */
+        if (!(str = (obsstr_t *)malloc(sizeof(obsstr_t))) || !open_obsstr(str, file, 0, t0, t0, 0.0, opt))
+        {
+            free(str);
+            if (path != file)
+                strcpy(path, file);
+            return 0;
+        }
+        tmppath(cfile, tmp);
+        if (!openobcw(&w, tmp, &str->rnx.sta))
+        {
+            close_obsstr(str);
+            free(str);
+            if (path != file)
+                strcpy(path, file);
+            return 0;
+        }
+        memcpy(w.h.src, h.src, sizeof(h.src));
+        memcpy(w.h.opt, h.opt, sizeof(h.opt));
+        w.h.mtime = h.mtime;
+        w.h.size = h.size;
+
+        while (str->rnx.obs.n > 0 && stat)
+        {
+            stat = addobcw(&w, str->rnx.obs.data, str->rnx.obs.n);
+            next_obsstr(str);
+        }
+        close_obsstr(str);
+        free(str);
+
+        if (!renameobc(tmp, cfile, closeobcw(&w, stat)))
+        {
+            if (path != file)
+                strcpy(path, file);
+            return 0;
+        }
+        trace(2, "cacheobc: container written %s\n", cfile);
+    }
+    strcpy(path, cfile);
+    return 1;
+}
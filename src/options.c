@@ -57,6 +57,8 @@ static char snrmask_[NFREQ][1024];
 #define GEOOPT "0:internal,1:egm96,2:egm08_2.5,3:egm08_1,4:gsi2000"
 #define STAOPT "0:all,1:single"
 #define STSOPT "0:off,1:state,2:residual"
+#define ORBFIT "0:lagrange,1:chebyshev"
+#define ROBUST "0:off,1:igg3"
 #define ARMOPT "0:off,1:continuous,2:instantaneous,3:fix-and-hold,6:ppp-ar,7:ppp-ar-ils"
 #define ARTYPE "0:overall-ar,1:part-ar1,2:part-ar2"
 #define POSOPT "0:llh,1:xyz,2:single,3:posfile,4:rinexhead,5:rtcm,6:raw"
@@ -84,6 +86,7 @@ EXPORT opt_t sysopts[] = {
     {"pos1-ionoopt", 3, (void *)&prcopt_.ionoopt, IONOPT},
     {"pos1-tropopt", 3, (void *)&prcopt_.tropopt, TRPOPT},
     {"pos1-sateph", 3, (void *)&prcopt_.sateph, EPHOPT},
+    {"pos1-orbfit", 3, (void *)&prcopt_.orbfit, ORBFIT},
     {"pos1-posopt1", 3, (void *)&prcopt_.posopt[0], SWTOPT},
     {"pos1-posopt2", 3, (void *)&prcopt_.posopt[1], SWTOPT},
     {"pos1-posopt3", 3, (void *)&prcopt_.posopt[2], PHWOPT},
@@ -118,6 +121,11 @@ EXPORT opt_t sysopts[] = {
     {"pos2-arthres", 1, (void *)&prcopt_.threscheck[5], ""},
     {"pos2-baselinelen", 1, (void *)&prcopt_.baseline[0], "m"},
     {"pos2-baselinesig", 1, (void *)&prcopt_.baseline[1], "m"},
+    {"pos2-nslot", 0, (void *)&prcopt_.nslot, "n (0:all)"},
+    {"pos2-satpre", 0, (void *)&prcopt_.satpre, "n (0:off)"},
+    {"pos2-robust", 3, (void *)&prcopt_.robust, ROBUST},
+    {"pos2-robk0", 1, (void *)&prcopt_.robthres[0], ""},
+    {"pos2-robk1", 1, (void *)&prcopt_.robthres[1], ""},
 
     {"pos3-armode", 3, (void *)&prcopt_.modear, ARMOPT},
     {"pos3-artype", 3, (void *)&prcopt_.typear, ARTYPE},
@@ -219,6 +227,7 @@ EXPORT opt_t sysopts[] = {
     {"file-outdir", 2, (void *)&filopt_.outdir, ""},
     {"file-outfile1", 2, (void *)&filopt_.outfile1, ""},
     {"file-outfile2", 2, (void *)&filopt_.outfile2, ""},
+    {"file-cachedir", 2, (void *)&filopt_.cachedir, ""},
     {"", 0, NULL, ""} /* terminator */
 };
 /* discard space characters at tail ------------------------------------------*/
@@ -591,6 +600,7 @@ extern void resetsysopts(void)
     filopt_.blq[0] = '\0';
     filopt_.solstat[0] = '\0';
     filopt_.trace[0] = '\0';
+    filopt_.cachedir[0] = '\0';
     for (i = 0; i < 2; i++)
         antpostype_[i] = 0;
     elmask_ = 15.0;
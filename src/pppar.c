@@ -95,12 +95,13 @@ static int is_depend(int sat1, int sat2, int *flgs, int *max_flg)
 }
 static int ranking(double *Q, int *sat1, int *sat2, double *a, int *NW, int na, int *ia)
 {
+    void *mk = arenamark();
     int i, j, m, ind, flgs[MAXSAT] = {0}, max_flg = 0;
     double *q, *T, *F, min;
 
-    q = mat(na, 1);
-    T = mat(na, na);
-    F = mat(na, na);
+    q = amat(na, 1);
+    T = amat(na, na);
+    F = amat(na, na);
     for (i = 0; i < na; i++)
     {
         q[i] = Q[i + i * na];
@@ -144,11 +145,9 @@ static int ranking(double *Q, int *sat1, int *sat2, double *a, int *NW, int na,
         }
     }
     matmul("TN", m, na, na, 1.0, T, Q, 0.0, F);
-    matmul("NN", m, m, na, 1.0, F, T, 0.0, Q);
+    symmul("NN", m, na, 1.0, F, T, 0.0, Q);
 
-    free(q);
-    free(T);
-    free(F);
+    arenarelease(mk);
     return m;
 }
 /* select fcb data struct   --------------------------------------------------*/
@@ -184,6 +183,8 @@ static int sel_sat_SD(const rtk_t *rtk, const obsd_t *obs, int n, const nav_t *n
             continue;
         if (nav->wlbias[sat - 1] > 999)
             continue;
+        if (SLOT(sat, rtk) <= 0)
+            continue;
 
         switch (sys)
         {
@@ -276,19 +277,19 @@ static int sel_sat_SD(const rtk_t *rtk, const obsd_t *obs, int n, const nav_t *n
 #endif
     return m;
 }
-static int fix_EWL(const rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *isat1, const int *isat2, int n,
+static int fix_EWL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *isat1, const int *isat2, int n,
                    int *NE)
 {
-    int i, j, k, f, sat1, sat2, info, nv = 0;
-    double LC, BE, freq[NFREQ], lam2, lam3, el, cov[2], temp, *xp, *Pp, *v, *H, *R, *var;
+    void *mk = arenamark();
+    int i, j, k, jj, kk, f, sat1, sat2, info, nv = 0;
+    double LC, BE, freq[NFREQ], lam2, lam3, el, cov[2], temp, *xp, *Pp, *v, *H, *var;
     const prcopt_t *opt = &rtk->opt;
 
     xp = rtk->xa;
     Pp = rtk->Pa;
-    v = mat(n, 1);
-    H = zeros(rtk->nx, n);
-    R = mat(n, n);
-    var = mat(n, 1);
+    v = amat(n, 1);
+    H = azeros(rtk->nx, n);
+    var = amat(n, 1);
 
     for (i = 0; i < n; i++)
     {
@@ -306,11 +307,13 @@ static int fix_EWL(const rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const
         for (f = 0; f < NFREQ; f++)
             freq[f] = sat2freq(sat1, obs[isat1[i]].code[f], nav);
 
-        j = IB(sat1, 1, opt);
-        k = IB(sat2, 1, opt);
+        j = IB(sat1, 1, rtk);
+        k = IB(sat2, 1, rtk);
+        jj = IB(sat1, 2, rtk);
+        kk = IB(sat2, 2, rtk);
         lam2 = CLIGHT / freq[1];
         lam3 = CLIGHT / freq[2];
-        LC = (xp[j] - xp[k]) / lam2 - (xp[j + MAXSAT] - xp[k + MAXSAT]) / lam3;
+        LC = (xp[j] - xp[k]) / lam2 - (xp[jj] - xp[kk]) / lam3;
         el = (nav->elbias[sat1 - 1] - nav->elbias[sat2 - 1]);
 
         /* validation of integer wide-lane ambigyity */
@@ -322,13 +325,13 @@ static int fix_EWL(const rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const
             v[nv] = (NE[i] + el) - LC;
             H[j + nv * rtk->nx] = 1.0 / lam2;
             H[k + nv * rtk->nx] = -1.0 / lam2;
-            H[j + MAXSAT + nv * rtk->nx] = -1.0 / lam3;
-            H[k + MAXSAT + nv * rtk->nx] = 1.0 / lam3;
+            H[jj + nv * rtk->nx] = -1.0 / lam3;
+            H[kk + nv * rtk->nx] = 1.0 / lam3;
 
-            cov[0] = SQR(1 / lam2) * Pp[j + j * rtk->nx] + SQR(1 / lam3) * Pp[(j + MAXSAT) + (j + MAXSAT) * rtk->nx] -
-                     2 / (lam2 * lam3) * Pp[(j + MAXSAT) + j * rtk->nx];
-            cov[1] = SQR(1 / lam2) * Pp[k + k * rtk->nx] + SQR(1 / lam3) * Pp[(k + MAXSAT) + (k + MAXSAT) * rtk->nx] -
-                     2 / (lam2 * lam3) * Pp[(k + MAXSAT) + k * rtk->nx];
+            cov[0] = SQR(1 / lam2) * Pp[j + j * rtk->nx] + SQR(1 / lam3) * Pp[jj + jj * rtk->nx] -
+                     2 / (lam2 * lam3) * Pp[jj + j * rtk->nx];
+            cov[1] = SQR(1 / lam2) * Pp[k + k * rtk->nx] + SQR(1 / lam3) * Pp[kk + kk * rtk->nx] -
+                     2 / (lam2 * lam3) * Pp[kk + k * rtk->nx];
             temp = (cov[1] > cov[0]) ? cov[0] : cov[1];
 
             var[nv++] = (temp / 100 < SQR(1e-2)) ? temp / 100 : SQR(1e-2);
@@ -341,37 +344,28 @@ static int fix_EWL(const rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const
         }
     }
 
-    for (j = 0; j < nv; j++)
-        for (k = 0; k < nv; k++)
-        {
-            R[j + k * nv] = j == k ? var[j] : 0.0;
-        }
-
     /* update states with constraints */
-    if (nv > 0 && (info = filter(xp, Pp, H, v, R, rtk->nx, nv)))
+    if (nv > 0 && (info = filterix(xp, Pp, H, v, var, rtk->nx, nv, rtk->ix, rtk->nix, &rtk->ws)))
     {
         trace(1, "EL-filter error (info=%d)\n", info);
         nv = -1;
     }
 
-    free(v);
-    free(H);
-    free(R);
-    free(var);
+    arenarelease(mk);
     return nv;
 }
 static int fix_WL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *isat1, const int *isat2, int n, int *NW)
 {
-    int i, j, k, f, sat1, sat2, info, nv = 0;
-    double LC, BW, freq[NFREQ], lam1, lam2, wl, cov[2], temp, *xp, *Pp, *v, *H, *R, *var;
+    void *mk = arenamark();
+    int i, j, k, jj, kk, f, sat1, sat2, info, nv = 0;
+    double LC, BW, freq[NFREQ], lam1, lam2, wl, cov[2], temp, *xp, *Pp, *v, *H, *var;
     const prcopt_t *opt = &rtk->opt;
 
     xp = rtk->xa;
     Pp = rtk->Pa;
-    v = mat(n, 1);
-    H = zeros(rtk->nx, n);
-    R = mat(n, n);
-    var = mat(n, 1);
+    v = amat(n, 1);
+    H = azeros(rtk->nx, n);
+    var = amat(n, 1);
 
     for (i = 0; i < n; i++)
     {
@@ -381,11 +375,13 @@ static int fix_WL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *is
         /* wide-lane ambiguity */
         for (f = 0; f < NFREQ; f++)
             freq[f] = sat2freq(sat1, obs[isat1[i]].code[f], nav);
-        j = IB(sat1, 0, opt);
-        k = IB(sat2, 0, opt);
+        j = IB(sat1, 0, rtk);
+        k = IB(sat2, 0, rtk);
+        jj = IB(sat1, 1, rtk);
+        kk = IB(sat2, 1, rtk);
         lam1 = CLIGHT / freq[0];
         lam2 = CLIGHT / freq[1];
-        LC = (xp[j] - xp[k]) / lam1 - (xp[j + MAXSAT] - xp[k + MAXSAT]) / lam2;
+        LC = (xp[j] - xp[k]) / lam1 - (xp[jj] - xp[kk]) / lam2;
         wl = (nav->wlbias[sat1 - 1] - nav->wlbias[sat2 - 1]);
 
         /* validation of integer wide-lane ambigyity */
@@ -402,13 +398,13 @@ static int fix_WL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *is
             v[nv] = (NW[i] + wl) - LC;
             H[j + nv * rtk->nx] = 1.0 / lam1;
             H[k + nv * rtk->nx] = -1.0 / lam1;
-            H[j + MAXSAT + nv * rtk->nx] = -1.0 / lam2;
-            H[k + MAXSAT + nv * rtk->nx] = 1.0 / lam2;
+            H[jj + nv * rtk->nx] = -1.0 / lam2;
+            H[kk + nv * rtk->nx] = 1.0 / lam2;
 
-            cov[0] = SQR(1 / lam1) * Pp[j + j * rtk->nx] + SQR(1 / lam2) * Pp[(j + MAXSAT) + (j + MAXSAT) * rtk->nx] -
-                     2 / (lam1 * lam2) * Pp[(j + MAXSAT) + j * rtk->nx];
-            cov[1] = SQR(1 / lam1) * Pp[k + k * rtk->nx] + SQR(1 / lam2) * Pp[(k + MAXSAT) + (k + MAXSAT) * rtk->nx] -
-                     2 / (lam1 * lam2) * Pp[(k + MAXSAT) + k * rtk->nx];
+            cov[0] = SQR(1 / lam1) * Pp[j + j * rtk->nx] + SQR(1 / lam2) * Pp[jj + jj * rtk->nx] -
+                     2 / (lam1 * lam2) * Pp[jj + j * rtk->nx];
+            cov[1] = SQR(1 / lam1) * Pp[k + k * rtk->nx] + SQR(1 / lam2) * Pp[kk + kk * rtk->nx] -
+                     2 / (lam1 * lam2) * Pp[kk + k * rtk->nx];
             temp = (cov[1] > cov[0]) ? cov[0] : cov[1];
 
             var[nv++] = (temp / 100 < SQR(1e-2)) ? temp / 100 : SQR(1e-2);
@@ -434,30 +430,22 @@ static int fix_WL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *is
 #endif
         }
     }
-    for (j = 0; j < nv; j++)
-        for (k = 0; k < nv; k++)
-        {
-            R[j + k * nv] = j == k ? var[j] : 0.0;
-        }
-
     /* update states with constraints */
-    if (nv > 0 && (info = filter(xp, Pp, H, v, R, rtk->nx, nv)))
+    if (nv > 0 && (info = filterix(xp, Pp, H, v, var, rtk->nx, nv, rtk->ix, rtk->nix, &rtk->ws)))
     {
         trace(1, "WL-filter error (info=%d)\n", info);
         nv = -1;
     }
 
-    free(v);
-    free(H);
-    free(R);
-    free(var);
+    arenarelease(mk);
     return nv;
 }
 static int fix_sol(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *isat1, const int *isat2, const double *F,
                    int n);
 static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, int *isat2, int n, int *NW)
 {
-    int i, j, k, f, sat1, sat2, na, naa, *ia, info, fix, minfixsats, sys, stat = 0;
+    void *mk = arenamark();
+    int i, j, k, jj, kk, f, sat1, sat2, na, naa, *ia, info, fix, minfixsats, sys, stat = 0;
     double *xp, *Pp, *a, *D, *E, *F, *Qaa;
     double LC, nl, lam1, lam2, C1, C2, freq[NFREQ] = {0.0}, s[2];
     fcbd_t *fcb;
@@ -467,8 +455,8 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
 
     xp = rtk->xa;
     Pp = rtk->Pa;
-    a = zeros(n, 1);
-    D = zeros(rtk->nx, n);
+    a = azeros(n, 1);
+    D = azeros(rtk->nx, n);
     Qaa = E = F = NULL;
     ia = NULL;
 
@@ -489,13 +477,15 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
         /* float narrow-lane ambiguity (cycle) */
         for (f = 0; f < NFREQ; f++)
             freq[f] = sat2freq(sat1, obs[isat1[i]].code[f], nav);
-        j = IB(sat1, 0, &rtk->opt);
-        k = IB(sat2, 0, &rtk->opt);
+        j = IB(sat1, 0, rtk);
+        k = IB(sat2, 0, rtk);
+        jj = IB(sat1, 1, rtk);
+        kk = IB(sat2, 1, rtk);
         lam1 = CLIGHT / freq[0];
         lam2 = CLIGHT / freq[1];
         C1 = freq[0] / (freq[0] - freq[1]);
         C2 = freq[1] / (freq[0] - freq[1]);
-        LC = C1 * (xp[j] - xp[k]) / lam1 - C2 * (xp[j + MAXSAT] - xp[k + MAXSAT]) / lam2 - C2 * NW[i];
+        LC = C1 * (xp[j] - xp[k]) / lam1 - C2 * (xp[jj] - xp[kk]) / lam2 - C2 * NW[i];
         nl = fcb->bias[sat1 - 1] - fcb->bias[sat2 - 1];
         a[na] = LC - nl;
 
@@ -507,8 +497,8 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
             isat2[na] = isat2[i];
             D[j + na * rtk->nx] = C1 / lam1;
             D[k + na * rtk->nx] = -C1 / lam1;
-            D[j + MAXSAT + na * rtk->nx] = -C2 / lam2;
-            D[k + MAXSAT + na * rtk->nx] = C2 / lam2;
+            D[jj + na * rtk->nx] = -C2 / lam2;
+            D[kk + na * rtk->nx] = C2 / lam2;
             NW[na++] = NW[i];
 #if 0
 			char id1[32], id2[32];
@@ -535,13 +525,13 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
     if (na >= minfixsats)
     {
         /* allocate memory */
-        Qaa = mat(na, na);
-        E = mat(rtk->nx, na);
-        ia = imat(na, 1);
+        Qaa = amat(na, na);
+        E = amat(rtk->nx, na);
+        ia = aimat(na, 1);
 
         /* covariance of narrow-lane ambiguities */
         matmul("NN", rtk->nx, na, rtk->nx, 1.0, Pp, D, 0.0, E);
-        matmul("TN", na, na, rtk->nx, 1.0, D, E, 0.0, Qaa);
+        symmul("TN", na, rtk->nx, 1.0, D, E, 0.0, Qaa);
 
         /* decorrelation and sorting  */
         naa = ranking(Qaa, isat1, isat2, a, NW, na, ia);
@@ -549,7 +539,7 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
 
     if (naa >= minfixsats)
     {
-        F = zeros(naa, 2);
+        F = azeros(naa, 2);
         for (fix = naa; fix >= minfixsats; fix--)
         {
             for (i = 0; i < fix; i++)
@@ -588,34 +578,31 @@ static int fix_NL(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, int *isat1, i
         stat = fix_sol(rtk, obs, nav, isat1, isat2, F, fix);
     }
 
-    free(a);
-    free(D);
-    free(Qaa);
-    free(E);
-    free(F);
-    free(ia);
+    arenarelease(mk);
     return stat ? fix : 0;
 }
 static int fix_sol(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *isat1, const int *isat2, const double *F,
                    int n)
 {
-    int i, j, k, f, sat1, sat2, info, stat = 1;
+    void *mk = arenamark();
+    int i, j, k, jj, kk, f, sat1, sat2, info, stat = 1;
     double lam1, lam2, C1, C2, freq[NFREQ], cov[2], temp;
-    double *xp, *Pp, *v, *H, *R, *var;
+    double *xp, *Pp, *v, *H, *var;
 
     xp = rtk->xa;
     Pp = rtk->Pa;
-    v = zeros(n, 1);
-    H = zeros(rtk->nx, n);
-    R = zeros(n, n);
-    var = zeros(n, 1);
+    v = azeros(n, 1);
+    H = azeros(rtk->nx, n);
+    var = azeros(n, 1);
 
     for (i = 0; i < n; i++)
     {
         sat1 = obs[isat1[i]].sat;
         sat2 = obs[isat2[i]].sat;
-        j = IB(sat1, 0, &rtk->opt);
-        k = IB(sat2, 0, &rtk->opt);
+        j = IB(sat1, 0, rtk);
+        k = IB(sat2, 0, rtk);
+        jj = IB(sat1, 1, rtk);
+        kk = IB(sat2, 1, rtk);
 
         for (f = 0; f < NFREQ; f++)
             freq[f] = sat2freq(sat1, obs[isat1[i]].code[f], nav);
@@ -624,17 +611,17 @@ static int fix_sol(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *i
         C1 = freq[0] / (freq[0] - freq[1]);
         C2 = freq[1] / (freq[0] - freq[1]);
 
-        v[i] = F[i] - (C1 * (xp[j] - xp[k]) / lam1 - C2 * (xp[j + MAXSAT] - xp[k + MAXSAT]) / lam2);
+        v[i] = F[i] - (C1 * (xp[j] - xp[k]) / lam1 - C2 * (xp[jj] - xp[kk]) / lam2);
         H[j + i * rtk->nx] = C1 / lam1;
         H[k + i * rtk->nx] = -C1 / lam1;
-        H[j + MAXSAT + i * rtk->nx] = -C2 / lam2;
-        H[k + MAXSAT + i * rtk->nx] = C2 / lam2;
+        H[jj + i * rtk->nx] = -C2 / lam2;
+        H[kk + i * rtk->nx] = C2 / lam2;
 
-        cov[0] = SQR(C1 / lam1) * Pp[j + j * rtk->nx] + SQR(C2 / lam2) * Pp[(j + MAXSAT) + (j + MAXSAT) * rtk->nx] -
-                 2 * (C1 * C2) / (lam1 * lam2) * Pp[(j + MAXSAT) + j * rtk->nx];
+        cov[0] = SQR(C1 / lam1) * Pp[j + j * rtk->nx] + SQR(C2 / lam2) * Pp[jj + jj * rtk->nx] -
+                 2 * (C1 * C2) / (lam1 * lam2) * Pp[jj + j * rtk->nx];
 
-        cov[1] = SQR(C1 / lam1) * Pp[k + k * rtk->nx] + SQR(C2 / lam2) * Pp[(k + MAXSAT) + (k + MAXSAT) * rtk->nx] -
-                 2 * (C1 * C2) / (lam1 * lam2) * Pp[(k + MAXSAT) + k * rtk->nx];
+        cov[1] = SQR(C1 / lam1) * Pp[k + k * rtk->nx] + SQR(C2 / lam2) * Pp[kk + kk * rtk->nx] -
+                 2 * (C1 * C2) / (lam1 * lam2) * Pp[kk + k * rtk->nx];
 
         temp = (cov[1] > cov[0]) ? cov[0] : cov[1];
         var[i] = (temp / 100 < SQR(1e-2)) ? temp / 100 : SQR(1e-2);
@@ -644,18 +631,12 @@ static int fix_sol(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *i
 		satno2id(sat1, id1);
 		satno2id(sat2, id2);
 		trace(1,"SOL: %s %s %10.4f %15.6f %15.6f\n", id1, id2, v[i], F[i], 
-			(C1*(xp[j] - xp[k]) / lam1 - C2*(xp[j + MAXSAT] - xp[k + MAXSAT]) / lam2));
+			(C1*(xp[j] - xp[k]) / lam1 - C2*(xp[jj] - xp[kk]) / lam2));
 #endif
     }
 
-    for (j = 0; j < n; j++)
-        for (k = 0; k < n; k++)
-        {
-            R[j + k * n] = j == k ? var[j] : 0.0;
-        }
-
     /* update states with constraints */
-    if (n > 0 && (info = filter(xp, Pp, H, v, R, rtk->nx, n)))
+    if (n > 0 && (info = filterix(xp, Pp, H, v, var, rtk->nx, n, rtk->ix, rtk->nix, &rtk->ws)))
     {
         trace(1, "NL-filter error (info=%d)\n", info);
         stat = 0;
@@ -675,21 +656,19 @@ static int fix_sol(rtk_t *rtk, const obsd_t *obs, const nav_t *nav, const int *i
         }
     }
 
-    free(v);
-    free(H);
-    free(R);
-    free(var);
+    arenarelease(mk);
     return stat;
 }
 /* resolve integer ambiguity for DF/TF-PPP -----------------------------------------*/
 extern int pppamb(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
+    void *mk = arenamark();
     int *isat1, *isat2, *NE, *NW, m, stat = 0;
 
-    NE = imat(n * n, 1);
-    NW = imat(n * n, 1);
-    isat1 = imat(n * n, 1);
-    isat2 = imat(n * n, 1);
+    NE = aimat(n * n, 1);
+    NW = aimat(n * n, 1);
+    isat1 = aimat(n * n, 1);
+    isat2 = aimat(n * n, 1);
 
     trace(2, "%s %10.0f\n", time_str(rtk->sol.time, 0), time2gpst(rtk->sol.time, NULL));
     matcpy(rtk->xa, rtk->x, rtk->nx, 1);
@@ -713,9 +692,6 @@ extern int pppamb(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         }
     }
     trace(2, "ratio=%5.2f\n", rtk->sol.ratio);
-    free(isat1);
-    free(isat2);
-    free(NE);
-    free(NW);
+    arenarelease(mk);
     return stat;
 }
\ No newline at end of file
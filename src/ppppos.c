@@ -137,8 +137,7 @@ static void pppoutiono(const rtk_t *rtk, const obsd_t *obs, int n, const nav_t *
         for (i = 0; i < n; i++)
         {
             ssat = rtk->ssat + obs[i].sat - 1;
-            ll = II(obs[i].sat, &rtk->opt);
-            if (!ssat->vs || rtk->x[ll] == 0.0)
+            if (!ssat->vs || SLOT(obs[i].sat, rtk) <= 0 || rtk->x[(ll = II(obs[i].sat, rtk))] == 0.0)
                 continue;
 
             if ((rtk->opt.modear == 6 && ssat->fix[0] == 2 && ssat->fix[1] == 2) ||
@@ -165,13 +164,13 @@ static void pppoutambi(const rtk_t *rtk, const obsd_t *obs, int n, const nav_t *
     for (i = 0; i < n; i++)
     {
         ssat = rtk->ssat + obs[i].sat - 1;
-        if (!ssat->vs)
+        if (!ssat->vs || SLOT(obs[i].sat, rtk) <= 0)
             continue;
 
         EL = WL = NL = IF = 0.0;
         Pe = Pw = Pl = Pf = 1e6;
-        ll = IB(obs[i].sat, 0, &rtk->opt);
-        mm = IB(obs[i].sat, 1, &rtk->opt);
+        ll = IB(obs[i].sat, 0, rtk);
+        mm = IB(obs[i].sat, 1, rtk);
 
         for (j = 0; j < NFREQ; j++)
             freq[j] = sat2freq(obs[i].sat, obs[i].code[j], nav);
@@ -182,7 +181,7 @@ static void pppoutambi(const rtk_t *rtk, const obsd_t *obs, int n, const nav_t *
         // el ambiguity
         if ((ssat->vsat[1] & 0x2) && (ssat->vsat[2] & 0x2))
         {
-            nn = IB(obs[i].sat, 2, &rtk->opt);
+            nn = IB(obs[i].sat, 2, rtk);
             EL = x[mm] / lam2 - x[nn] / lam3;
             Pe = SQR(1 / lam2) * P[mm + mm * rtk->nx] + SQR(1 / lam3) * P[nn + nn * rtk->nx] -
                  2 / (lam2 * lam3) * P[nn + mm * rtk->nx];
@@ -311,10 +310,39 @@ extern void outppp(FILE *fp, const rtk_t *rtk, const obsd_t *obs, int n, const n
     if (rtk->opt.outopt & 0x20)
         pppoutddif(rtk, obs, n, nav, fp);
 }
+/* update index of active states --------------------------------------------*/
+static void setactx(rtk_t *rtk, int i, int act)
+{
+    int lo = 0, hi = rtk->nix, mid;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (rtk->ix[mid] < i)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < rtk->nix && rtk->ix[lo] == i)
+    {
+        if (!act)
+        {
+            memmove(rtk->ix + lo, rtk->ix + lo + 1, sizeof(int) * (rtk->nix - lo - 1));
+            rtk->nix--;
+        }
+    }
+    else if (act)
+    {
+        memmove(rtk->ix + lo + 1, rtk->ix + lo, sizeof(int) * (rtk->nix - lo));
+        rtk->ix[lo] = i;
+        rtk->nix++;
+    }
+}
 /* initialize state and covariance -------------------------------------------*/
 static void initx(rtk_t *rtk, double xi, double var, int i)
 {
     int j;
+    setactx(rtk, i, xi != 0.0 && var > 0.0);
     rtk->x[i] = xi;
     for (j = 0; j < rtk->nx; j++)
     {
@@ -855,6 +883,7 @@ static void update_ssat(const obsd_t *obs, int n, const prcopt_t *opt, double *r
 /* temporal update of position --------------------------------------------- */
 static void udpos_ppp(rtk_t *rtk, const double *xg, const double *Pg)
 {
+    void *mk = arenamark();
     double *F, *P, *FP, *x, *xp, pos[3], Q[9] = {0}, Qv[9], var = 0.0, std = 1E+010;
     int i, j, *ix, nx;
 
@@ -897,25 +926,17 @@ static void udpos_ppp(rtk_t *rtk, const double *xg, const double *Pg)
     }
 
     /* kinmatic mode */
-    /* generate valid state index */
-    ix = imat(rtk->nx, 1);
-    for (i = nx = 0; i < rtk->nx; i++)
-    {
-        if (rtk->x[i] != 0.0 && rtk->P[i + i * rtk->nx] > 0.0)
-            ix[nx++] = i;
-    }
-    if (nx < 9)
-    {
-        free(ix);
+    /* valid state index */
+    ix = rtk->ix;
+    if ((nx = rtk->nix) < 9)
         return;
-    }
 
     /* state transition of position/velocity/acceleration */
-    F = eye(nx);
-    P = mat(nx, nx);
-    FP = mat(nx, nx);
-    x = mat(nx, 1);
-    xp = mat(nx, 1);
+    F = aeye(nx);
+    P = amat(nx, nx);
+    FP = amat(nx, nx);
+    x = amat(nx, 1);
+    xp = amat(nx, 1);
 
     for (i = 0; i < 6; i++)
     {
@@ -936,7 +957,7 @@ static void udpos_ppp(rtk_t *rtk, const double *xg, const double *Pg)
     /* x=F*x, P=F*P*F+Q */
     matmul("NN", nx, 1, nx, 1.0, F, x, 0.0, xp);
     matmul("NN", nx, nx, nx, 1.0, F, P, 0.0, FP);
-    matmul("NT", nx, nx, nx, 1.0, FP, F, 0.0, P);
+    symmul("NT", nx, nx, 1.0, FP, F, 0.0, P);
 
     for (i = 0; i < nx; i++)
     {
@@ -956,12 +977,7 @@ static void udpos_ppp(rtk_t *rtk, const double *xg, const double *Pg)
         {
             rtk->P[i + 6 + (j + 6) * rtk->nx] += Qv[i + j * 3];
         }
-    free(ix);
-    free(F);
-    free(P);
-    free(FP);
-    free(x);
-    free(xp);
+    arenarelease(mk);
 
     /* check variance of estimated position */
     for (i = 0, var = 0.0; i < 3; i++)
@@ -1049,6 +1065,96 @@ static void udtrop_ppp(rtk_t *rtk)
         }
     }
 }
+/* test per-satellite states in use -----------------------------------------*/
+static int slotused(const rtk_t *rtk, int sat)
+{
+    int f;
+
+    if (rtk->opt.ionoopt == IONOOPT_EST && !ISZERO(rtk->x[II(sat, rtk)]))
+        return 1;
+    if (rtk->opt.nf > 2 && !ISZERO(rtk->x[IS(sat, rtk)]))
+        return 1;
+    for (f = 0; f < NF(&rtk->opt); f++)
+    {
+        if (!ISZERO(rtk->x[IB(sat, f, rtk)]))
+            return 1;
+    }
+    return 0;
+}
+/* release state slot of satellite -------------------------------------------*/
+static void freeslot(rtk_t *rtk, int sat)
+{
+    int f;
+
+    if (rtk->opt.ionoopt == IONOOPT_EST)
+        initx(rtk, 0.0, 0.0, II(sat, rtk));
+    if (rtk->opt.nf > 2)
+        initx(rtk, 0.0, 0.0, IS(sat, rtk));
+    for (f = 0; f < NF(&rtk->opt); f++)
+        initx(rtk, 0.0, 0.0, IB(sat, f, rtk));
+    rtk->slot[sat - 1] = 0;
+}
+/* temporal update of per-satellite state slots --------------------------------
+ * ionosphere, ifb and phase-bias states of satellites share a pool of nslot
+ * slots (prcopt_t.nslot). slots whose states have all been reset are recycled
+ * and free slots are assigned to tracked satellites. if the pool is exhausted,
+ * the slot of the untracked satellite with the longest outage is taken over,
+ * otherwise the satellite is excluded in the epoch
+ *-----------------------------------------------------------------------------*/
+static void udslot_ppp(rtk_t *rtk, const obsd_t *obs, int n)
+{
+    uint8_t used[MAXSAT] = {0};
+    int i, j, k, m, sat, nslot = NSLOT(&rtk->opt);
+
+    if (nslot >= MAXSAT)
+        return; /* one slot per satellite */
+
+    for (i = 0; i < MAXSAT; i++)
+    {
+        if (!rtk->slot[i])
+            continue;
+        if (!slotused(rtk, i + 1))
+        {
+            freeslot(rtk, i + 1);
+            continue;
+        }
+        used[rtk->slot[i] - 1] = 1;
+    }
+    for (i = j = 0; i < n && i < MAXOBS; i++)
+    {
+        sat = obs[i].sat;
+        if (!rtk->ssat[sat - 1].vs || rtk->slot[sat - 1])
+            continue;
+
+        while (j < nslot && used[j])
+            j++;
+        if (j < nslot)
+        {
+            used[j] = 1;
+            rtk->slot[sat - 1] = j + 1;
+            continue;
+        }
+        /* take over slot of untracked satellite with longest outage */
+        for (k = -1, m = 0; m < MAXSAT; m++)
+        {
+            if (!rtk->slot[m] || rtk->ssat[m].vs)
+                continue;
+            if (k < 0 || rtk->ssat[m].outc[0] > rtk->ssat[k].outc[0])
+                k = m;
+        }
+        satno2id(sat, id);
+        if (k < 0)
+        {
+            trace(2, "udslot_ppp: no free state slot sat=%s nslot=%d\n", id, nslot);
+            rtk->ssat[sat - 1].vs = 0;
+            continue;
+        }
+        m = rtk->slot[k];
+        freeslot(rtk, k + 1);
+        rtk->slot[sat - 1] = m;
+        trace(3, "udslot_ppp: recycle state slot sat=%s slot=%d\n", id, m);
+    }
+}
 /* temporal update of ionospheric parameters ---------------------------------*/
 static void udiono_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
@@ -1061,7 +1167,9 @@ static void udiono_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 
     for (i = 0; i < MAXSAT; i++)
     {
-        ii = II(i + 1, &rtk->opt);
+        if (!SLOT(i + 1, rtk))
+            continue;
+        ii = II(i + 1, rtk);
         if (!ISZERO(rtk->x[ii]) && rtk->ssat[i].reset & 0x01)
             initx(rtk, 0.0, 0.0, ii);
         if (!ISZERO(rtk->x[ii]))
@@ -1075,9 +1183,9 @@ static void udiono_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     {
         sat = obs[i].sat;
         ssat = rtk->ssat + sat - 1;
-        if (!ssat->vs)
+        if (!ssat->vs || SLOT(sat, rtk) <= 0)
             continue;
-        ii = II(sat, &rtk->opt);
+        ii = II(sat, rtk);
 
         for (k = 0; k < NFREQ; k++)
             freq[k] = sat2freq(sat, obs[i].code[k], nav);
@@ -1109,7 +1217,9 @@ static void udifb_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     double ion, ifb, gamma, freq[3];
     for (i = 0; i < MAXSAT; i++)
     {
-        ii = IS(i + 1, &rtk->opt);
+        if (!SLOT(i + 1, rtk))
+            continue;
+        ii = IS(i + 1, rtk);
 
         if (!ISZERO(rtk->x[ii]) && rtk->ssat[i].reset & 0x02)
             initx(rtk, 0.0, 0.0, ii);
@@ -1121,10 +1231,10 @@ static void udifb_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     for (i = 0; i < n; i++)
     {
         sat = obs[i].sat;
-        if (!rtk->ssat[sat - 1].vs)
+        if (!rtk->ssat[sat - 1].vs || SLOT(sat, rtk) <= 0)
             continue;
 
-        ii = IS(sat, &rtk->opt);
+        ii = IS(sat, rtk);
         for (k = 0; k < NFREQ; k++)
             freq[k] = sat2freq(sat, obs[i].code[k], nav);
 
@@ -1132,7 +1242,7 @@ static void udifb_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         {
 
             ifb = 0.0;
-            ion = rtk->x[II(sat, &rtk->opt)];
+            ion = rtk->x[II(sat, rtk)];
 
             if (rtk->ssat[sat - 1].eobs & 5)
                 continue;
@@ -1166,7 +1276,9 @@ static void udbias_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         /* reset phase-bias if expire obs outage counter */
         for (i = 0; i < MAXSAT; i++)
         {
-            ii = IB(i + 1, f, &rtk->opt);
+            if (!SLOT(i + 1, rtk))
+                continue;
+            ii = IB(i + 1, f, rtk);
             if (!ISZERO(rtk->x[ii]) && (rtk->ssat[i].reset & (0x10 << f)))
             {
                 rtk->ssat[i].lock[f] = 0;
@@ -1181,8 +1293,7 @@ static void udbias_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
         {
 
             sat = obs[i].sat;
-            ii = IB(sat, f, &rtk->opt);
-            if (!rtk->ssat[sat - 1].vs || !ISZERO(rtk->x[ii]))
+            if (!rtk->ssat[sat - 1].vs || SLOT(sat, rtk) <= 0 || !ISZERO(rtk->x[(ii = IB(sat, f, rtk))]))
                 continue;
 
             corr_meas(obs + i, nav, rtk->ssat[sat - 1].azel, &rtk->opt, dantr, dants, rtk->ssat[sat - 1].phw,
@@ -1199,7 +1310,7 @@ static void udbias_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             {
                 freq[0] = sat2freq(sat, obs[i].code[0], nav);
                 freq[f] = sat2freq(sat, obs[i].code[f], nav);
-                ion = rtk->x[II(sat, &rtk->opt)];
+                ion = rtk->x[II(sat, rtk)];
 
                 if (rtk->ssat[sat - 1].eobs & 0x1)
                     continue;
@@ -1216,7 +1327,7 @@ static void udbias_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
                 satno2id(sat, id);
                 trace(2, "$AM%d %10.0f %s %s %10.4f %10.4f %10.4f\n", f + 1, time2gpst(rtk->sol.time, NULL), id,
                       time_str(rtk->sol.time, 0), bias, ion,
-                      sqrt(rtk->P[II(sat, &rtk->opt) + II(sat, &rtk->opt) * rtk->nx]));
+                      sqrt(rtk->P[II(sat, rtk) + II(sat, rtk) * rtk->nx]));
             }
         }
     } // end frequency
@@ -1226,6 +1337,9 @@ static void udstate_ppp(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav,
 {
     trace(3, "udstate_ppp: n=%d\n", n);
 
+    /* assign per-satellite state slots */
+    udslot_ppp(rtk, obs, n);
+
     /* temporal update of position */
     udpos_ppp(rtk, xg, Pg);
 
@@ -1302,15 +1416,15 @@ static int exclude(int itype, int ifreq, int isat1, int isat2, const exc_t *exc)
 }
 /* phase and code residuals --------------------------------------------------*/
 static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts, const double *var_rs, const int *svh,
-                   const nav_t *nav, const double *x, rtk_t *rtk, double *v, double *H, double *var, int *vflg,
+                   const nav_t *nav, const double *x, rtk_t *rtk, double *v, spmat_t *H, double *var, int *vflg,
                    int *iref, const exc_t *exc, int cc)
 {
-    int i, j, k, sat, sys, nv = 0, nx = rtk->nx;
+    int i, j, k, sat, sys, nv = 0;
     char str[32], id[32];
     prcopt_t *opt = &rtk->opt;
     double freq[NFREQ] = {0}, y, r, cdtr, bias, C, rr[3], pos[3], e[3], dtdx[3], L[NFREQ], P[NFREQ], Lc, Pc;
     double dtrp = 0.0, dion = 0.0, vart = 0.0, vari = 0.0, ifb;
-    double dantr[NFREQ] = {0}, dants[NFREQ] = {0}, mAzel[NSYS] = {0}, *azel, *Hi;
+    double dantr[NFREQ] = {0}, dants[NFREQ] = {0}, mAzel[NSYS] = {0}, *azel;
 
     time2str(obs[0].time, str, 0);
 
@@ -1339,10 +1453,16 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
         {
             continue;
         }
+        /* no state slot (slot pool exhausted) */
+        if (SLOT(sat, rtk) <= 0)
+        {
+            continue;
+        }
 
         /* tropospheric and ionospheric model */
         if (!tropcorr(obs[i].time, pos, azel, opt, x, dtdx, nav, &dtrp, &vart) ||
-            !ionocorr(obs[i].time, pos, azel, opt, sat, x, nav, &dion, &vari))
+            !ionocorr(obs[i].time, pos, azel, opt, sat, opt->ionoopt == IONOOPT_EST ? x + II(sat, rtk) : x, nav, &dion,
+                      &vari))
         {
             continue;
         }
@@ -1391,9 +1511,9 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
             /* coordinate */
             if (H)
             {
-                Hi = H + nv * nx;
-                for (k = 0; k < nx; k++)
-                    Hi[k] = k < 3 ? -e[k] : 0.0;
+                spdrop(H);
+                for (k = 0; k < 3; k++)
+                    spadd(H, k, -e[k]);
             }
 
             /* receiver clock */
@@ -1402,7 +1522,7 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
             cdtr = x[IC(k, opt)];
             if (H)
             {
-                Hi[IC(k, opt)] = 1.0;
+                spadd(H, IC(k, opt), 1.0);
             }
 
             /* Trop */
@@ -1412,7 +1532,7 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
                 {
                     for (k = 0; k < (opt->tropopt >= TROPOPT_ESTG ? 3 : 1); k++)
                     {
-                        Hi[IT(opt) + k] = dtdx[k];
+                        spadd(H, IT(opt) + k, dtdx[k]);
                     }
                 }
             }
@@ -1421,33 +1541,33 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
             C = SQR(freq[0] / freq[j / 2]) * (j % 2 == 0 ? -1.0 : 1.0);
             if (opt->ionoopt == IONOOPT_EST)
             {
-                if (rtk->x[II(sat, opt)] == 0.0)
+                if (rtk->x[II(sat, rtk)] == 0.0)
                     continue;
                 if (H)
                 {
-                    Hi[II(sat, opt)] = C;
+                    spadd(H, II(sat, rtk), C);
                 }
             }
 
             /* phase bias */
             if (j % 2 == 0)
             {
-                if ((bias = x[IB(sat, j / 2, opt)]) == 0.0)
+                if ((bias = x[IB(sat, j / 2, rtk)]) == 0.0)
                     continue;
                 if (H)
                 {
-                    Hi[IB(sat, j / 2, opt)] = 1.0;
+                    spadd(H, IB(sat, j / 2, rtk), 1.0);
                 }
             }
 
             /* Inter frequency bias */
             if (j % 2 != 0 && j / 2 == 2)
             {
-                if ((ifb = x[IS(sat, opt)]) == 0.0)
+                if ((ifb = x[IS(sat, rtk)]) == 0.0)
                     continue;
                 if (H)
                 {
-                    Hi[IS(sat, opt)] = 1.0;
+                    spadd(H, IS(sat, rtk), 1.0);
                 }
             }
 
@@ -1482,21 +1602,24 @@ static int ppp_res(const obsd_t *obs, int n, const double *rs, const double *dts
                     }
                 }
             }
+            if (H)
+                sprow(H);
             setvflg(&vflg[nv++], (j % 2) + 1, (j / 2 + 1), sat, 0);
             trace(2, "%s %s%d %10.6f %10.6f \n", id, (j % 2) == 0 ? "L" : "P", j / 2 + 1, sqrt(var[nv - 1]), v[nv - 1]);
         } // end styple
     }     // end obs
+    if (H)
+        spdrop(H);
     return nv;
 }
 /* constraint to local correction --------------------------------------------*/
 static int cor_res(const obsd_t *obs, const int n, const int *refs, const nav_t *nav, const rtk_t *rtk, const double *x,
-                   double *v, double *H, double *var, int *vflg, const exc_t *exc)
+                   double *v, spmat_t *H, double *var, int *vflg, const exc_t *exc)
 {
-    int i, k, ii, jj, sat, sys, nx, nv = 0;
+    int i, k, ii, jj, sat, sys, nv = 0;
     double trop[3], std_trop[3], iono, std_iono;
-    double *azel, rr[3], pos[3], *Hi;
+    double *azel, rr[3], pos[3];
 
-    nx = rtk->nx;
     for (i = 0; i < 3; i++)
     {
         rr[i] = x[i] + rtk->dr[i];
@@ -1516,9 +1639,8 @@ static int cor_res(const obsd_t *obs, const int n, const int *refs, const nav_t
                 // var[nv] = SQR(0.05);
                 if (H)
                 {
-                    Hi = H + nv * nx;
-                    for (k = 0; k < nx; k++)
-                        Hi[k] = k == ii ? 1.0 : 0.0;
+                    spadd(H, ii, 1.0);
+                    sprow(H);
                 }
 #if 0
 				trace(1,"%s TROP: %10.5f res=%10.5f\n", time_str(rtk->sol.time,0), trop[0], v[nv]);
@@ -1541,14 +1663,16 @@ static int cor_res(const obsd_t *obs, const int n, const int *refs, const nav_t
                 continue;
             if (!rtk->ssat[sat - 1].vs || azel[1] < 15 * D2R)
                 continue;
+            if (SLOT(sat, rtk) <= 0 || SLOT(refs[k], rtk) <= 0)
+                continue;
             if (exclude(8, 0, sat, refs[k], exc))
                 continue;
 
             if (!pppcorr_stec(obs[i].time, pos, sat, refs[k], &iono, &std_iono, nav, 2))
                 continue;
 
-            ii = II(sat, &rtk->opt);
-            jj = II(refs[k], &rtk->opt);
+            ii = II(sat, rtk);
+            jj = II(refs[k], rtk);
 
             v[nv] = iono - (x[ii] - x[jj]);
 #if 0
@@ -1563,9 +1687,9 @@ static int cor_res(const obsd_t *obs, const int n, const int *refs, const nav_t
             var[nv] = SQR(rtk->opt.err[6]); // SQR(0.015);
             if (H)
             {
-                Hi = H + nv * nx;
-                for (k = 0; k < nx; k++)
-                    Hi[k] = (k == ii) ? 1 : (k == jj) ? -1 : 0.0;
+                spadd(H, ii, 1.0);
+                spadd(H, jj, -1.0);
+                sprow(H);
             }
             setvflg(&vflg[nv++], 8, 0, sat, refs[k]);
         }
@@ -1574,10 +1698,10 @@ static int cor_res(const obsd_t *obs, const int n, const int *refs, const nav_t
 }
 /* Add prior cooridition */
 static int pri_res(rtk_t *rtk, const double *x, const double *Pp, const double *xg, const double *Pg, double *v,
-                   double *H, double *var)
+                   spmat_t *H, double *var)
 {
     int nx = rtk->nx, nv = 0;
-    double *Hi, var1 = 0.0, var2 = 0.0;
+    double var1 = 0.0, var2 = 0.0;
 
     if (xg && !ISZERO(xg[0]) && Pg)
     {
@@ -1596,9 +1720,8 @@ static int pri_res(rtk_t *rtk, const double *x, const double *Pp, const double *
 
             if (H)
             {
-                Hi = H + nv * nx;
-                for (int j = 0; j < nx; j++)
-                    Hi[j] = j == i ? 1.0 : 0.0;
+                spadd(H, i, 1.0);
+                sprow(H);
             }
             // char id[32];
             // time2str(rtk->sol.time, id, 2);
@@ -1610,8 +1733,9 @@ static int pri_res(rtk_t *rtk, const double *x, const double *Pp, const double *
     return nv;
 }
 /* reject obs by pre-fit residuals */
-static int valpre(rtk_t *rtk, double *v, double *H, double *r, int *vflg, int nv, int nx, exc_t *exc)
+static int valpre(rtk_t *rtk, double *v, spmat_t *H, double *r, int *vflg, int nv, exc_t *exc)
 {
+    void *mk = arenamark();
     int i, k, type, freq, sat1, sat2, nn, sys, num[NSYS] = {0}, *ind, *stat;
     double mid, *D;
     char str[32], id[8];
@@ -1620,9 +1744,9 @@ static int valpre(rtk_t *rtk, double *v, double *H, double *r, int *vflg, int nv
         return nv;
 
     time2str(rtk->sol.time, str, 0);
-    D = mat(nv, NSYS);
-    ind = imat(nv, NSYS);
-    stat = imat(nv, 1);
+    D = amat(nv, NSYS);
+    ind = aimat(nv, NSYS);
+    stat = aimat(nv, 1);
 
     for (i = 0; i < nv; i++)
         stat[i] = 1;
@@ -1668,7 +1792,8 @@ static int valpre(rtk_t *rtk, double *v, double *H, double *r, int *vflg, int nv
                 satno2id(sat1, id);
                 trace(1, "pri-eli %s %s %s%d\tres=%10.4f\tlock=%4d\tazel=%10.4f\t %10.4f ion=%10.4f\n", str, id,
                       type == 1 ? "L" : "P", freq, v[ind[i * nv + k]], rtk->ssat[sat1 - 1].lock[freq - 1],
-                      rtk->ssat[sat1 - 1].azel[1] * R2D, fabs(D[i * nv + k] - mid), rtk->x[II(sat1, &rtk->opt)]);
+                      rtk->ssat[sat1 - 1].azel[1] * R2D, fabs(D[i * nv + k] - mid),
+                      SLOT(sat1, rtk) > 0 ? rtk->x[II(sat1, rtk)] : 0.0);
                 cc = 1;
             }
         }
@@ -1692,14 +1817,12 @@ static int valpre(rtk_t *rtk, double *v, double *H, double *r, int *vflg, int nv
             v[nn] = v[i];
             r[nn] = r[i];
             vflg[nn] = vflg[i];
-            matcpy(H + nn * nx, H + i * nx, nx, 1);
             nn++;
         }
     }
+    spkeep(H, stat);
 
-    free(D);
-    free(ind);
-    free(stat);
+    arenarelease(mk);
     return nn;
 }
 /* reject obs by pos-fit residuals */
@@ -1801,17 +1924,22 @@ static void update_sol(rtk_t *rtk, int stat)
 /* precise point positioning -------------------------------------------------*/
 extern void ppppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav, const double *xg, const double *Pg)
 {
+    void *mk = arenamark();
     const prcopt_t *opt = &rtk->opt;
-    int i, j, k, nv, na, info, *vflg, refs[NSYS], svh[MAXOBS], stat = SOLQ_SINGLE;
-    double *rs, *dts, *var, *v, *H, *r, *R, *xp, *Pp;
+    int i, j, k, p, nv, no, na, nexc, info, *vflg, *vflga, *rflg, refs[NSYS], svh[MAXOBS], stat = SOLQ_SINGLE;
+    int type = 0, freq = 0, sat1 = 0, sat2 = 0, rerun = 0;
+    double *rs, *dts, *var, *v, *r, *va, *ra, *xp;
+    spmat_t H = {0};
+    size_t peak, size;
+    uint32_t hit, miss;
     exc_t exc = {0};
     char str[32];
 
     time2str(rtk->sol.time, str, 0);
 
-    rs = mat(6, n);
-    dts = mat(2, n);
-    var = mat(1, n);
+    rs = amat(6, n);
+    dts = amat(2, n);
+    var = amat(1, n);
 
     /* initial satellite status */
     initial_ssat(obs, n, opt, rtk->tt, &rtk->reset, rtk->ssat);
@@ -1850,55 +1978,121 @@ extern void ppppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav, const
 
     /* kalman filter */
     nv = n * rtk->opt.nf * 2 + 1 + MAXSAT;
-    xp = mat(rtk->nx, 1);
-    Pp = mat(rtk->nx, rtk->nx);
-    vflg = imat(nv, 1);
-    v = mat(nv, 1);
-    H = mat(rtk->nx, nv);
-    r = mat(nv, 1);
-    R = mat(nv, nv);
+    xp = amat(rtk->nx, 1);
+    vflg = aimat(nv, 1);
+    vflga = aimat(nv, 1);
+    rflg = aimat(nv, 1);
+    v = amat(nv, 1);
+    r = amat(nv, 1);
+    va = amat(nv, 1);
+    ra = amat(nv, 1);
+    matcpy(xp, rtk->x, rtk->nx, 1);
+
+    /* snapshot of active states, restored by each filter iteration */
+    rtk->nsave = 0;
+    filterbegin(rtk->x, rtk->P, rtk->nx, rtk->ix, rtk->nix, &rtk->ws);
 
     for (i = 0; i < MAX_ITER; i++)
     {
-        matcpy(xp, rtk->x, rtk->nx, 1);
-        matcpy(Pp, rtk->P, rtk->nx, rtk->nx);
+        /* restore active states updated by rejected iteration */
+        for (j = 0; i > 0 && j < rtk->nix; j++)
+            xp[rtk->ix[j]] = rtk->x[rtk->ix[j]];
 
         /* reject obs by pre-fit residuals */
-        nv = ppp_res(obs, n, rs, dts, var, svh, nav, xp, rtk, v, H, r, vflg, refs, &exc, 0);
-        nv += cor_res(obs, n, refs, nav, rtk, xp, v + nv, H + nv * rtk->nx, r + nv, vflg + nv, &exc);
+        spclear(&H);
+        nv = ppp_res(obs, n, rs, dts, var, svh, nav, xp, rtk, v, &H, r, vflg, refs, &exc, 0);
+        nv += cor_res(obs, n, refs, nav, rtk, xp, v + nv, &H, r + nv, vflg + nv, &exc);
         if (opt->posopt[6])
-            nv = valpre(rtk, v, H, r, vflg, nv, rtk->nx, &exc);
-        nv += pri_res(rtk, xp, Pp, xg, Pg, v + nv, H + nv * rtk->nx, r + nv);
+            nv = valpre(rtk, v, &H, r, vflg, nv, &exc);
+        no = nv;
+        nv += pri_res(rtk, xp, rtk->P, xg, Pg, v + nv, &H, r + nv);
 
-        /* measurement update of ekf states */
+        /* robust reweighting of phase and code (unit weight of constraints) */
         for (j = 0; j < nv; j++)
-            for (k = 0; k < nv; k++)
-            {
-                R[j + k * nv] = j == k ? r[j] : 0.0;
-            }
-        if ((info = filter(xp, Pp, H, v, R, rtk->nx, nv)))
+        {
+            type = 0;
+            if (j < no)
+                readvflg(vflg[j], &type, &freq, &sat1, &sat2);
+            rflg[j] = type == 1 || type == 2;
+        }
+        /* measurement update of ekf states (uncorrelated measurements) */
+        if ((info = filterstep(xp, &H, v, r, rflg, rtk->nx, nv, &rtk->ws)))
         {
             trace(2, "%s ppp (%d) filter error info=%d\n", str, i + 1, info);
             break;
         }
+        /* exclude phase and code rejected by robust update in the same pass */
+        for (j = 0; rtk->ws.nrob[1] > 0 && j < no; j++)
+        {
+            readvflg(vflg[j], &type, &freq, &sat1, &sat2);
+            if (!rflg[j] || rtk->ws.w[j] > 0.0 || exc.n >= 255)
+                continue;
+            exc.flg[exc.n++] = vflg[j];
 
-        /* reject obs by pos-fit residuals */
-        na = ppp_res(obs, n, rs, dts, var, svh, nav, xp, rtk, v, NULL, r, vflg, NULL, &exc, 0);
-        // na += cor_res(obs, n, refs, nav, rtk, xp, v + na, NULL, r + na, vflg + na, &exc);
-        if (!valpos(rtk, v, r, vflg, na, opt->threscheck[1], &exc))
+            satno2id(sat1, id);
+            trace(2, "ROB-eli %s %s %s%d\tres=%10.4f\tstd=%10.4f\n", str, id, type == 1 ? "L" : "P", freq, v[j],
+                  sqrt(r[j]));
+        }
+
+        /* reject obs by pos-fit residuals (pre-fit H, v, r kept for re-run) */
+        nexc = exc.n;
+        na = ppp_res(obs, n, rs, dts, var, svh, nav, xp, rtk, va, NULL, ra, vflga, NULL, &exc, 0);
+        // na += cor_res(obs, n, refs, nav, rtk, xp, va + na, NULL, ra + na, vflga + na, &exc);
+        if (!valpos(rtk, va, ra, vflga, na, opt->threscheck[1], &exc))
         {
+            /* robust re-run skipped: no obs rejected by pos-fit residuals */
+            if (rtk->ws.rob[0] > 0.0)
+                rtk->nsave++;
             stat = SOLQ_PPP;
             break;
         }
+        if (rtk->ws.rob[0] <= 0.0)
+            continue;
+
+        /* robust update: one more update over the same measurements with obs
+           rejected by pos-fit residuals zeroed instead of re-iteration */
+        for (j = 0; j < no; j++)
+        {
+            for (k = nexc; k < exc.n && exc.flg[k] != vflg[j]; k++)
+                ;
+            if (k >= exc.n)
+                continue;
+            for (p = H.rp[j]; p < H.rp[j + 1]; p++)
+                H.val[p] = 0.0;
+            v[j] = 0.0;
+            rflg[j] = 0;
+        }
+        rerun = 1;
+        if ((info = filterstep(xp, &H, v, r, rflg, rtk->nx, nv, &rtk->ws)))
+        {
+            trace(2, "%s ppp (%d) filter error info=%d\n", str, i + 1, info);
+            break;
+        }
+        /* pos-fit residuals of re-run (accepted without further iteration) */
+        na = ppp_res(obs, n, rs, dts, var, svh, nav, xp, rtk, va, NULL, ra, vflga, NULL, &exc, 0);
+        if (valpos(rtk, va, ra, vflga, na, opt->threscheck[1], &exc))
+        {
+            trace(2, "%s ppp (%d) pos-fit residuals rejected after robust re-run\n", str, i + 1);
+        }
+        stat = SOLQ_PPP;
+        break;
     }
 
+    /* robust update statistics */
+    rtk->niter = (i < MAX_ITER ? i + 1 : MAX_ITER) + rerun;
+    rtk->nrob[0] = rtk->ws.nrob[0];
+    rtk->nrob[1] = rtk->ws.nrob[1];
+    trace(3, "ppppos : iter=%d robust downweighted=%d rejected=%d skipped=%d\n", rtk->niter, rtk->nrob[0],
+          rtk->nrob[1], rtk->nsave);
+
     /* update satellite information */
     update_ssat(obs, n, opt, rs, dts, svh, &stat, &exc, &rtk->sol.ns, rtk->ssat);
 
     if (stat == SOLQ_PPP)
     {
-        matcpy(rtk->x, xp, rtk->nx, 1);
-        matcpy(rtk->P, Pp, rtk->nx, rtk->nx);
+        for (j = 0; j < rtk->nix; j++)
+            rtk->x[rtk->ix[j]] = xp[rtk->ix[j]];
+        filtercommit(rtk->P, rtk->nx, &rtk->ws);
 
         /* ambiguity resolution (ppp) */
         if ((opt->modear >= ARMODE_PPPAR) && pppamb(rtk, obs, n, nav))
@@ -1923,14 +2117,14 @@ extern void ppppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav, const
     /* update solution status */
     update_sol(rtk, stat);
 
-    free(rs);
-    free(dts);
-    free(var);
-    free(xp);
-    free(Pp);
-    free(vflg);
-    free(v);
-    free(H);
-    free(r);
-    free(R);
+    spfree(&H);
+    arenarelease(mk);
+
+    /* peak usage of workspace arena in epoch */
+    arenastat(&peak, &size);
+    trace(3, "ppppos : arena peak=%lu size=%lu\n", (unsigned long)peak, (unsigned long)size);
+
+    /* satellite state cache of epoch */
+    satcachestat(&hit, &miss);
+    trace(3, "ppppos : satcache hit=%u miss=%u\n", hit, miss);
 }
\ No newline at end of file
@@ -41,6 +41,12 @@
  *           2015/05/10 1.15 add api readfcb()
  *                           modify api readdcb()
  *           2017/04/11 1.16 fix bug on antenna offset correction in peph2pos()
+ *                           interpolation window shared by satellites in
+ *                           pephpos() and pephclk()
+ *                           add api fitpeph()
+ *                           add option to fit chebyshev orbit in readsp3()
+ *                           add api packpeph(),unpackpeph(),trimpeph(),
+ *                               packpclk(),unpackpclk(),trimpclk()
  *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
 
@@ -50,6 +56,7 @@
 #define MAXDTE 900.0    /* max time difference to ephem time (s) */
 #define EXTERR_CLK 1E-3 /* extrapolation error for clock (m/s) */
 #define EXTERR_EPH 5E-7 /* extrapolation error for ephem (m/s^2) */
+#define NSEGCHEB 4      /* number of ephemeris intervals per chebyshev segment */
 
 /* satellite code to satellite system ----------------------------------------*/
 static int code2sys(char code)
@@ -293,18 +300,425 @@ static void combpeph(nav_t *nav, int opt)
 
     trace(4, "combpeph: ne=%d\n", nav->ne);
 }
+/* free compact precise ephemeris -------------------------------------------*/
+static void freepephc(pephc_t *pe)
+{
+    int i;
+
+    free(pe->time);
+    free(pe->index);
+    free(pe->pos);
+    free(pe->std);
+    free(pe->vel);
+    free(pe->vst);
+    free(pe->cov);
+    free(pe->vco);
+    pe->time = NULL;
+    pe->index = NULL;
+    pe->pos = pe->vel = NULL;
+    pe->std = pe->vst = pe->cov = pe->vco = NULL;
+    pe->ne = pe->ns = 0;
+    for (i = 0; i < MAXSAT; i++)
+        pe->slot[i] = -1;
+}
+/* test non-zero values ------------------------------------------------------*/
+static int nonzerof(const float *v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (v[i] != 0.0f)
+            return 1;
+    return 0;
+}
+/* compact precise ephemeris ---------------------------------------------------
+ * move precise ephemeris in nav->peph to satellite-major compact storage
+ * args   : nav_t  *nav        IO  navigation data
+ * return : status (1:ok,0:error)
+ * notes  : only satellites with position or clock are stored. std, velocity
+ *          and covariance are stored only if any of them is non-zero.
+ *          nav->peph is freed and nav->ne is set to 0 after packing.
+ *          precise ephemeris already in nav->pe is discarded
+ *-----------------------------------------------------------------------------*/
+extern int packpeph(nav_t *nav)
+{
+    pephc_t *pe = &nav->pe;
+    const peph_t *p;
+    size_t m, size;
+    int i, j, k, ne = nav->ne, ns = 0, opt = 0;
+
+    trace(3, "packpeph: ne=%d\n", nav->ne);
+
+    freepephc(pe);
+
+    if (ne <= 0)
+        return 1;
+
+    /* satellites and fields in precise ephemeris */
+    for (k = 0; k < MAXSAT; k++)
+    {
+        for (i = 0; i < ne; i++)
+        {
+            p = nav->peph + i;
+            if (norm(p->pos[k], 4) > 0.0)
+                pe->slot[k] = ns;
+            if (nonzerof(p->std[k], 4))
+                opt |= 1;
+            if (norm(p->vel[k], 4) > 0.0 || nonzerof(p->vst[k], 4))
+                opt |= 2;
+            if (nonzerof(p->cov[k], 3) || nonzerof(p->vco[k], 3))
+                opt |= 4;
+        }
+        if (pe->slot[k] >= 0)
+            ns++;
+    }
+    m = (size_t)ns * ne;
+    if (!(pe->time = (gtime_t *)malloc(sizeof(gtime_t) * ne)) || !(pe->index = imat(ne, 1)) ||
+        !(pe->pos = (double *)malloc(sizeof(double) * 4 * m + 1)) ||
+        ((opt & 1) && !(pe->std = (float *)malloc(sizeof(float) * 4 * m + 1))) ||
+        ((opt & 2) && !(pe->vel = (double *)malloc(sizeof(double) * 4 * m + 1))) ||
+        ((opt & 2) && !(pe->vst = (float *)malloc(sizeof(float) * 4 * m + 1))) ||
+        ((opt & 4) && !(pe->cov = (float *)malloc(sizeof(float) * 3 * m + 1))) ||
+        ((opt & 4) && !(pe->vco = (float *)malloc(sizeof(float) * 3 * m + 1))))
+    {
+        trace(1, "packpeph malloc error ne=%d ns=%d\n", ne, ns);
+        freepephc(pe);
+        return 0;
+    }
+    for (i = 0; i < ne; i++)
+    {
+        pe->time[i] = nav->peph[i].time;
+        pe->index[i] = nav->peph[i].index;
+    }
+    for (k = 0; k < MAXSAT; k++)
+    {
+        if (pe->slot[k] < 0)
+            continue;
+        for (i = 0; i < ne; i++)
+        {
+            p = nav->peph + i;
+            m = (size_t)pe->slot[k] * ne + i;
+            for (j = 0; j < 4; j++)
+            {
+                pe->pos[m * 4 + j] = p->pos[k][j];
+                if (pe->std)
+                    pe->std[m * 4 + j] = p->std[k][j];
+                if (pe->vel)
+                    pe->vel[m * 4 + j] = p->vel[k][j];
+                if (pe->vst)
+                    pe->vst[m * 4 + j] = p->vst[k][j];
+            }
+            for (j = 0; j < 3 && pe->cov; j++)
+            {
+                pe->cov[m * 3 + j] = p->cov[k][j];
+                pe->vco[m * 3 + j] = p->vco[k][j];
+            }
+        }
+    }
+    pe->ne = ne;
+    pe->ns = ns;
+
+    size = (sizeof(gtime_t) + sizeof(int)) * ne +
+           (size_t)ns * ne *
+               (sizeof(double) * 4 + ((opt & 1) ? sizeof(float) * 4 : 0) +
+                ((opt & 2) ? sizeof(double) * 4 + sizeof(float) * 4 : 0) + ((opt & 4) ? sizeof(float) * 6 : 0));
+    trace(2, "packpeph: ne=%d ns=%d size=%.1fkB (peph_t %.1fkB)\n", ne, ns, size / 1024.0,
+          sizeof(peph_t) * (double)ne / 1024.0);
+
+    free(nav->peph);
+    nav->peph = NULL;
+    nav->ne = nav->nemax = 0;
+    return 1;
+}
+/* expand compact precise ephemeris --------------------------------------------
+ * move precise ephemeris in nav->pe back to nav->peph
+ * args   : nav_t  *nav        IO  navigation data
+ * return : status (1:ok,0:error)
+ * notes  : precise ephemeris in nav->pe is appended to nav->peph and nav->pe
+ *          is freed
+ *-----------------------------------------------------------------------------*/
+extern int unpackpeph(nav_t *nav)
+{
+    const pephc_t *pe = &nav->pe;
+    peph_t *peph;
+    size_t m;
+    int i, j, k;
+
+    trace(3, "unpackpeph: ne=%d ns=%d\n", pe->ne, pe->ns);
+
+    if (pe->ne <= 0)
+        return 1;
+
+    if (!(peph = (peph_t *)realloc(nav->peph, sizeof(peph_t) * (nav->ne + pe->ne))))
+    {
+        trace(1, "unpackpeph malloc error ne=%d\n", nav->ne + pe->ne);
+        return 0;
+    }
+    nav->peph = peph;
+    nav->nemax = nav->ne + pe->ne;
+
+    for (i = 0; i < pe->ne; i++)
+    {
+        peph = nav->peph + nav->ne++;
+        memset(peph, 0, sizeof(peph_t));
+        peph->time = pe->time[i];
+        peph->index = pe->index[i];
+
+        for (k = 0; k < MAXSAT; k++)
+        {
+            if (pe->slot[k] < 0)
+                continue;
+            m = (size_t)pe->slot[k] * pe->ne + i;
+            for (j = 0; j < 4; j++)
+            {
+                peph->pos[k][j] = pe->pos[m * 4 + j];
+                peph->std[k][j] = pe->std ? pe->std[m * 4 + j] : 0.0f;
+                peph->vel[k][j] = pe->vel ? pe->vel[m * 4 + j] : 0.0;
+                peph->vst[k][j] = pe->vst ? pe->vst[m * 4 + j] : 0.0f;
+            }
+            for (j = 0; j < 3; j++)
+            {
+                peph->cov[k][j] = pe->cov ? pe->cov[m * 3 + j] : 0.0f;
+                peph->vco[k][j] = pe->vco ? pe->vco[m * 3 + j] : 0.0f;
+            }
+        }
+    }
+    freepephc(&nav->pe);
+    return 1;
+}
+/* epoch range in time span --------------------------------------------------*/
+static void epochspan(const gtime_t *time, int n, gtime_t ts, gtime_t te, int *i0, int *i1)
+{
+    for (*i0 = 0; *i0 < n && ts.time && timediff(time[*i0], ts) < -1E-9; (*i0)++)
+        ;
+    for (*i1 = n; *i1 > *i0 && te.time && timediff(time[*i1 - 1], te) > 1E-9; (*i1)--)
+        ;
+}
+/* shrink satellite-major array to epoch range -------------------------------*/
+static void *trimrows(void *data, size_t size, int ns, int n, int i0, int i1)
+{
+    char *p = (char *)data, *q;
+    int k;
+
+    if (!p)
+        return NULL;
+    for (k = 0; k < ns; k++)
+    {
+        memmove(p + size * k * (i1 - i0), p + size * ((size_t)k * n + i0), size * (i1 - i0));
+    }
+    return (q = (char *)realloc(p, size * ns * (i1 - i0) + 1)) ? q : p;
+}
+/* trim compact precise ephemeris ----------------------------------------------
+ * delete precise ephemeris out of time span in nav->pe
+ * args   : nav_t  *nav        IO  navigation data
+ *          gtime_t ts         I   start time (ts.time==0: no limit)
+ *          gtime_t te         I   end time   (te.time==0: no limit)
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void trimpeph(nav_t *nav, gtime_t ts, gtime_t te)
+{
+    pephc_t *pe = &nav->pe;
+    int i0, i1;
+
+    epochspan(pe->time, pe->ne, ts, te, &i0, &i1);
+
+    trace(3, "trimpeph: ne=%d i0=%d i1=%d\n", pe->ne, i0, i1);
+
+    if (i0 == 0 && i1 == pe->ne)
+        return;
+    if (i1 <= i0)
+    {
+        freepephc(pe);
+        return;
+    }
+    pe->pos = (double *)trimrows(pe->pos, sizeof(double) * 4, pe->ns, pe->ne, i0, i1);
+    pe->std = (float *)trimrows(pe->std, sizeof(float) * 4, pe->ns, pe->ne, i0, i1);
+    pe->vel = (double *)trimrows(pe->vel, sizeof(double) * 4, pe->ns, pe->ne, i0, i1);
+    pe->vst = (float *)trimrows(pe->vst, sizeof(float) * 4, pe->ns, pe->ne, i0, i1);
+    pe->cov = (float *)trimrows(pe->cov, sizeof(float) * 3, pe->ns, pe->ne, i0, i1);
+    pe->vco = (float *)trimrows(pe->vco, sizeof(float) * 3, pe->ns, pe->ne, i0, i1);
+    pe->time = (gtime_t *)trimrows(pe->time, sizeof(gtime_t), 1, pe->ne, i0, i1);
+    pe->index = (int *)trimrows(pe->index, sizeof(int), 1, pe->ne, i0, i1);
+    pe->ne = i1 - i0;
+}
+/* free compact precise clock ------------------------------------------------*/
+static void freepclkc(pclkc_t *pc)
+{
+    int i;
+
+    free(pc->time);
+    free(pc->index);
+    free(pc->clk);
+    free(pc->std);
+    pc->time = NULL;
+    pc->index = NULL;
+    pc->clk = NULL;
+    pc->std = NULL;
+    pc->nc = pc->ns = 0;
+    for (i = 0; i < MAXSAT; i++)
+        pc->slot[i] = -1;
+}
+/* compact precise clock -------------------------------------------------------
+ * move precise clock in nav->pclk to satellite-major compact storage
+ * args   : nav_t  *nav        IO  navigation data
+ * return : status (1:ok,0:error)
+ * notes  : only satellites with clock are stored. std is stored only if any of
+ *          them is non-zero. nav->pclk is freed and nav->nc is set to 0 after
+ *          packing. precise clock already in nav->pc is discarded
+ *-----------------------------------------------------------------------------*/
+extern int packpclk(nav_t *nav)
+{
+    pclkc_t *pc = &nav->pc;
+    size_t m, size;
+    int i, k, nc = nav->nc, ns = 0, opt = 0;
+
+    trace(3, "packpclk: nc=%d\n", nav->nc);
+
+    freepclkc(pc);
+
+    if (nc <= 0)
+        return 1;
+
+    /* satellites and fields in precise clock */
+    for (k = 0; k < MAXSAT; k++)
+    {
+        for (i = 0; i < nc; i++)
+        {
+            if (nav->pclk[i].clk[k][0] != 0.0)
+                pc->slot[k] = ns;
+            if (nav->pclk[i].std[k][0] != 0.0f)
+                opt |= 1;
+        }
+        if (pc->slot[k] >= 0)
+            ns++;
+    }
+    m = (size_t)ns * nc;
+    if (!(pc->time = (gtime_t *)malloc(sizeof(gtime_t) * nc)) || !(pc->index = imat(nc, 1)) ||
+        !(pc->clk = (double *)malloc(sizeof(double) * m + 1)) ||
+        ((opt & 1) && !(pc->std = (float *)malloc(sizeof(float) * m + 1))))
+    {
+        trace(1, "packpclk malloc error nc=%d ns=%d\n", nc, ns);
+        freepclkc(pc);
+        return 0;
+    }
+    for (i = 0; i < nc; i++)
+    {
+        pc->time[i] = nav->pclk[i].time;
+        pc->index[i] = nav->pclk[i].index;
+    }
+    for (k = 0; k < MAXSAT; k++)
+    {
+        if (pc->slot[k] < 0)
+            continue;
+        for (i = 0; i < nc; i++)
+        {
+            m = (size_t)pc->slot[k] * nc + i;
+            pc->clk[m] = nav->pclk[i].clk[k][0];
+            if (pc->std)
+                pc->std[m] = nav->pclk[i].std[k][0];
+        }
+    }
+    pc->nc = nc;
+    pc->ns = ns;
+
+    size = (sizeof(gtime_t) + sizeof(int)) * nc +
+           (size_t)ns * nc * (sizeof(double) + ((opt & 1) ? sizeof(float) : 0));
+    trace(2, "packpclk: nc=%d ns=%d size=%.1fkB (pclk_t %.1fkB)\n", nc, ns, size / 1024.0,
+          sizeof(pclk_t) * (double)nc / 1024.0);
+
+    free(nav->pclk);
+    nav->pclk = NULL;
+    nav->nc = nav->ncmax = 0;
+    return 1;
+}
+/* expand compact precise clock ------------------------------------------------
+ * move precise clock in nav->pc back to nav->pclk
+ * args   : nav_t  *nav        IO  navigation data
+ * return : status (1:ok,0:error)
+ * notes  : precise clock in nav->pc is appended to nav->pclk and nav->pc is
+ *          freed
+ *-----------------------------------------------------------------------------*/
+extern int unpackpclk(nav_t *nav)
+{
+    const pclkc_t *pc = &nav->pc;
+    pclk_t *pclk;
+    size_t m;
+    int i, k;
+
+    trace(3, "unpackpclk: nc=%d ns=%d\n", pc->nc, pc->ns);
+
+    if (pc->nc <= 0)
+        return 1;
+
+    if (!(pclk = (pclk_t *)realloc(nav->pclk, sizeof(pclk_t) * (nav->nc + pc->nc))))
+    {
+        trace(1, "unpackpclk malloc error nc=%d\n", nav->nc + pc->nc);
+        return 0;
+    }
+    nav->pclk = pclk;
+    nav->ncmax = nav->nc + pc->nc;
+
+    for (i = 0; i < pc->nc; i++)
+    {
+        pclk = nav->pclk + nav->nc++;
+        memset(pclk, 0, sizeof(pclk_t));
+        pclk->time = pc->time[i];
+        pclk->index = pc->index[i];
+
+        for (k = 0; k < MAXSAT; k++)
+        {
+            if (pc->slot[k] < 0)
+                continue;
+            m = (size_t)pc->slot[k] * pc->nc + i;
+            pclk->clk[k][0] = pc->clk[m];
+            pclk->std[k][0] = pc->std ? pc->std[m] : 0.0f;
+        }
+    }
+    freepclkc(&nav->pc);
+    return 1;
+}
+/* trim compact precise clock --------------------------------------------------
+ * delete precise clock out of time span in nav->pc
+ * args   : nav_t  *nav        IO  navigation data
+ *          gtime_t ts         I   start time (ts.time==0: no limit)
+ *          gtime_t te         I   end time   (te.time==0: no limit)
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void trimpclk(nav_t *nav, gtime_t ts, gtime_t te)
+{
+    pclkc_t *pc = &nav->pc;
+    int i0, i1;
+
+    epochspan(pc->time, pc->nc, ts, te, &i0, &i1);
+
+    trace(3, "trimpclk: nc=%d i0=%d i1=%d\n", pc->nc, i0, i1);
+
+    if (i0 == 0 && i1 == pc->nc)
+        return;
+    if (i1 <= i0)
+    {
+        freepclkc(pc);
+        return;
+    }
+    pc->clk = (double *)trimrows(pc->clk, sizeof(double), pc->ns, pc->nc, i0, i1);
+    pc->std = (float *)trimrows(pc->std, sizeof(float), pc->ns, pc->nc, i0, i1);
+    pc->time = (gtime_t *)trimrows(pc->time, sizeof(gtime_t), 1, pc->nc, i0, i1);
+    pc->index = (int *)trimrows(pc->index, sizeof(int), 1, pc->nc, i0, i1);
+    pc->nc = i1 - i0;
+}
 /* read sp3 precise ephemeris file ---------------------------------------------
  * read sp3 precise ephemeris/clock files and set them to navigation data
  * args   : char   *file       I   sp3-c precise ephemeris file
  *                                 (wind-card * is expanded)
  *          nav_t  *nav        IO  navigation data
  *          int    opt         I   options (1: only observed + 2: only predicted +
- *                                 4: not combined)
+ *                                 4: not combined + 8: fit chebyshev orbit)
  * return : none
  * notes  : see ref [1]
  *          precise ephemeris is appended and combined
  *          nav->peph and nav->ne must by properly initialized before calling the
- *          function
+ *          function. precise ephemeris is moved to nav->pe by packpeph() after
+ *          reading
  *          only files with extensions of .sp3, .SP3, .eph* and .EPH* are read
  *-----------------------------------------------------------------------------*/
 extern void readsp3(const char *file, nav_t *nav, int opt)
@@ -329,6 +743,9 @@ extern void readsp3(const char *file, nav_t *nav, int opt)
     /* expand wild card in file path */
     n = expath(file, efiles, MAXEXFILE);
 
+    /* append to precise ephemeris already read */
+    unpackpeph(nav);
+
     for (i = j = 0; i < n; i++)
     {
         if (!(ext = strrchr(efiles[i], '.')))
@@ -356,6 +773,13 @@ extern void readsp3(const char *file, nav_t *nav, int opt)
     /* combine precise ephemeris */
     if (nav->ne > 0)
         combpeph(nav, opt); // 这个可以加载一下
+
+    /* compact precise ephemeris */
+    packpeph(nav);
+
+    /* fit chebyshev orbit */
+    if (opt & 8)
+        fitpeph(nav);
 }
 /* read satellite antenna parameters -------------------------------------------
  * read satellite antenna parameters
@@ -526,86 +950,416 @@ extern int readdcb(const char *file, nav_t *nav)
 
     return 1;
 }
-/* polynomial interpolation by Neville's algorithm ---------------------------*/
-static double interppol(const double *x, double *y, int n)
+/* position/clock of satellite in compact precise ephemeris -----------------*/
+static const double *pephp(const pephc_t *pe, int sat, int i)
+{
+    static const double pos0[4] = {0};
+    int k = pe->slot[sat - 1];
+
+    return k < 0 ? pos0 : pe->pos + ((size_t)k * pe->ne + i) * 4;
+}
+/* position/clock std of satellite in compact precise ephemeris --------------*/
+static double pephs(const pephc_t *pe, int sat, int i, int j)
 {
-    int i, j;
+    int k = pe->slot[sat - 1];
 
-    for (j = 1; j < n; j++)
+    return k < 0 || !pe->std ? 0.0 : pe->std[((size_t)k * pe->ne + i) * 4 + j];
+}
+/* clock of satellite in compact precise clock -------------------------------*/
+static double pclkv(const pclkc_t *pc, int sat, int i)
+{
+    int k = pc->slot[sat - 1];
+
+    return k < 0 ? 0.0 : pc->clk[(size_t)k * pc->nc + i];
+}
+/* clock std of satellite in compact precise clock ---------------------------*/
+static double pclks(const pclkc_t *pc, int sat, int i)
+{
+    int k = pc->slot[sat - 1];
+
+    return k < 0 || !pc->std ? 0.0 : pc->std[(size_t)k * pc->nc + i];
+}
+/* chebyshev polynomials at u -----------------------------------------------*/
+static void chebpoly(double u, double *T)
+{
+    int k;
+
+    T[0] = 1.0;
+    T[1] = u;
+    for (k = 2; k <= NCHEB; k++)
+        T[k] = 2.0 * u * T[k - 1] - T[k - 2];
+}
+/* fit chebyshev segment of satellite ----------------------------------------*/
+static int fitseg(const nav_t *nav, int sat, int i0, gtime_t t0, const double *Ti, pephseg_t *seg)
+{
+    const double *pos;
+    double q[3 * (NCHEB + 1)], dt, sinl, cosl;
+    int i, j, k, n = NCHEB + 1;
+
+    for (j = 0; j < n; j++)
     {
-        for (i = 0; i < n - j; i++)
+        pos = pephp(&nav->pe, sat, i0 + j);
+        if (norm(pos, 3) <= 0.0)
+            return 0;
+
+        /* correction for earth rotation to ecef at t0 */
+        dt = timediff(nav->pe.time[i0 + j], t0);
+        sinl = sin(OMGE * dt);
+        cosl = cos(OMGE * dt);
+        q[j] = cosl * pos[0] - sinl * pos[1];
+        q[j + n] = sinl * pos[0] + cosl * pos[1];
+        q[j + 2 * n] = pos[2];
+    }
+    for (k = 0; k < 3; k++)
+        for (i = 0; i < n; i++)
         {
-            y[i] = (x[i + j] * y[i] - x[i] * y[i + 1]) / (x[i + j] - x[i]);
+            seg->coef[k][i] = 0.0;
+            for (j = 0; j < n; j++)
+                seg->coef[k][i] += Ti[i + j * n] * q[j + k * n];
         }
-    }
-    return y[0];
+    return 1;
 }
-/* satellite position by precise ephemeris -----------------------------------*/
-static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs, double *dts, double *vare, double *varc)
+/* fit chebyshev orbit ---------------------------------------------------------
+ * fit piecewise chebyshev polynomials to precise orbits of each satellite
+ * args   : nav_t  *nav        IO  navigation data
+ * return : none
+ * notes  : a segment covers NSEGCHEB ephemeris intervals and interpolates the
+ *          NCHEB+1 ephemeris epochs centered on it in ecef at the center time.
+ *          pephpos() evaluates the segments instead of lagrange interpolation.
+ *          segments are not built over orbit outage. the fit is ignored if
+ *          nav->pe is changed, call again after modifying nav->pe
+ *-----------------------------------------------------------------------------*/
+extern void fitpeph(nav_t *nav)
 {
-    double t[NMAX + 1], p[3][NMAX + 1], c[2], *pos, std = 0.0, s[3], sinl, cosl;
-    int i, j, k, index;
+    pephseg_t *seg;
+    double *T, *Ti, u;
+    gtime_t *tc;
+    int i, j, k, sat, n = NCHEB + 1, nk, i0, is, ie, *ws;
 
-    trace(4, "pephpos : time=%s sat=%2d\n", time_str(time, 3), sat);
+    trace(3, "fitpeph : ne=%d\n", nav->pe.ne);
 
-    rs[0] = rs[1] = rs[2] = dts[0] = 0.0;
+    free(nav->pf.seg);
+    nav->pf.seg = NULL;
+    nav->pf.ne = 0;
+    for (i = 0; i <= MAXSAT; i++)
+        nav->pf.off[i] = 0;
+
+    if (nav->pe.ne < n)
+        return;
 
-    if (nav->ne < NMAX + 1 || timediff(time, nav->peph[0].time) < -MAXDTE ||
-        timediff(time, nav->peph[nav->ne - 1].time) > MAXDTE)
+    /* windows and inverse chebyshev matrices shared by satellites */
+    nk = (nav->pe.ne - 2) / NSEGCHEB + 1;
+    T = mat(n, n);
+    Ti = mat(n * n, nk);
+    tc = (gtime_t *)malloc(sizeof(gtime_t) * nk);
+    ws = imat(nk, 1);
+    seg = (pephseg_t *)malloc(sizeof(pephseg_t) * MAXSAT * nk);
+    if (!T || !Ti || !tc || !ws || !seg)
     {
-        trace(2, "no prec ephem %s sat=%2d\n", time_str(time, 0), sat);
+        trace(1, "fitpeph malloc error ne=%d\n", nav->pe.ne);
+        free(T);
+        free(Ti);
+        free(tc);
+        free(ws);
+        free(seg);
+        return;
+    }
+    for (k = 0; k < nk; k++)
+    {
+        is = k * NSEGCHEB;
+        i0 = is + NSEGCHEB / 2 - NCHEB / 2;
+        if (i0 < 0)
+            i0 = 0;
+        else if (i0 + n > nav->pe.ne)
+            i0 = nav->pe.ne - n;
+        ws[k] = i0;
+        tc[k] = timeadd(nav->pe.time[i0], timediff(nav->pe.time[i0 + n - 1], nav->pe.time[i0]) / 2.0);
+        u = timediff(nav->pe.time[i0 + n - 1], tc[k]);
+
+        for (j = 0; j < n; j++)
+            chebpoly(timediff(nav->pe.time[i0 + j], tc[k]) / u, T + j * n);
+
+        /* Ti[j+i*n]: T_i(u_j), coefficients c=Ti^-1*q */
+        for (i = 0; i < n; i++)
+            for (j = 0; j < n; j++)
+                Ti[i + j * n + k * n * n] = T[j + i * n];
+        if (matinv(Ti + k * n * n, n))
+        {
+            trace(2, "fitpeph singular window %s\n", time_str(nav->pe.time[i0], 0));
+            ws[k] = -1;
+        }
+    }
+    /* segments sorted by satellite and time */
+    for (sat = 1, i = 0; sat <= MAXSAT; sat++)
+    {
+        for (k = 0; k < nk; k++)
+        {
+            if (ws[k] < 0 || !fitseg(nav, sat, ws[k], tc[k], Ti + k * n * n, seg + i))
+                continue;
+            is = k * NSEGCHEB;
+            ie = is + NSEGCHEB < nav->pe.ne - 1 ? is + NSEGCHEB : nav->pe.ne - 1;
+            seg[i].t0 = tc[k];
+            seg[i].h = timediff(nav->pe.time[ws[k] + n - 1], tc[k]);
+            seg[i].ts = k == 0 ? -1E9 : timediff(nav->pe.time[is], tc[k]);
+            seg[i].te = k == nk - 1 ? 1E9 : timediff(nav->pe.time[ie], tc[k]);
+            i++;
+        }
+        nav->pf.off[sat] = i;
+    }
+    free(T);
+    free(Ti);
+    free(tc);
+    free(ws);
+
+    if (i <= 0)
+    {
+        free(seg);
+        return;
+    }
+    if (!(nav->pf.seg = (pephseg_t *)realloc(seg, sizeof(pephseg_t) * i)))
+    {
+        free(seg);
+        for (sat = 0; sat <= MAXSAT; sat++)
+            nav->pf.off[sat] = 0;
+        return;
+    }
+    nav->pf.ne = nav->pe.ne;
+    nav->pf.time = nav->pe.time[0];
+
+    trace(3, "fitpeph : nseg=%d size=%lu\n", i, (unsigned long)(sizeof(pephseg_t) * i));
+}
+/* satellite position by chebyshev orbit -------------------------------------*/
+static int pephcheb(const nav_t *nav, int sat, gtime_t time, double *rs)
+{
+    const pephseg_t *seg;
+    double u, b[3][2], c, sinl, cosl, dt;
+    int i, j, k;
+
+    if (!nav->pf.seg || nav->pf.ne != nav->pe.ne || timediff(nav->pf.time, nav->pe.time[0]) != 0.0)
+        return 0;
+
+    /* binary search of last segment starting before time */
+    for (i = nav->pf.off[sat - 1], j = nav->pf.off[sat]; i < j;)
+    {
+        k = (i + j) / 2;
+        if (timediff(time, nav->pf.seg[k].t0) >= nav->pf.seg[k].ts)
+            i = k + 1;
+        else
+            j = k;
+    }
+    if (i <= nav->pf.off[sat - 1])
         return 0;
+    seg = nav->pf.seg + i - 1;
+    dt = timediff(time, seg->t0);
+    if (dt > seg->te)
+        return 0;
+
+    /* clenshaw recurrence */
+    u = dt / seg->h;
+    for (k = 0; k < 3; k++)
+    {
+        b[k][0] = b[k][1] = 0.0;
+        for (i = NCHEB; i >= 1; i--)
+        {
+            c = 2.0 * u * b[k][0] - b[k][1] + seg->coef[k][i];
+            b[k][1] = b[k][0];
+            b[k][0] = c;
+        }
+        rs[k] = u * b[k][0] - b[k][1] + seg->coef[k][0];
     }
-    /* binary search */ //���ֲ���
-    for (i = 0, j = nav->ne - 1; i < j;)
+    /* correction for earth rotation from ecef at t0 */
+    sinl = sin(OMGE * dt);
+    cosl = cos(OMGE * dt);
+    c = cosl * rs[0] + sinl * rs[1];
+    rs[1] = -sinl * rs[0] + cosl * rs[1];
+    rs[0] = c;
+    return 1;
+}
+/* precise ephemeris interpolation context type ------------------------------
+ * window of precise ephemeris epochs shared by the satellites of an epoch.
+ * the epochs of the window, the barycentric weights of lagrange interpolation
+ * and the earth rotation angles are computed once when the window is located
+ *-----------------------------------------------------------------------------*/
+typedef struct
+{                                        /* precise ephemeris interpolation context type */
+    const gtime_t *time;                 /* epoch time of precise ephemeris (NULL: not located) */
+    int ne;                              /* number of precise ephemeris */
+    int index;                           /* index of ephemeris epoch before time */
+    int i0;                              /* index of first epoch of window */
+    gtime_t t0;                          /* time of ephemeris epoch before time */
+    double x[NMAX + 1];                  /* epochs of window relative to t0 (s) */
+    double w[NMAX + 1];                  /* barycentric weights */
+    double sinx[NMAX + 1], cosx[NMAX + 1]; /* sin/cos of earth rotation angle at x */
+    double dt1;                          /* epoch after time relative to t0 (s) */
+} pephctx_t;
+
+typedef struct
+{                        /* precise clock interpolation context type */
+    const gtime_t *time; /* epoch time of precise clock (NULL: not located) */
+    int nc;              /* number of precise clock */
+    int index;           /* index of clock epoch before time */
+    gtime_t t0;          /* time of clock epoch before time */
+    double dt1;          /* epoch after time relative to t0 (s) */
+} pclkctx_t;
+
+static THREADLOCAL pephctx_t pephctx; /* interpolation context (thread-local) */
+static THREADLOCAL pclkctx_t pclkctx;
+
+/* search index of epoch before time -----------------------------------------*/
+static int searchepoch(const gtime_t *t, int n, gtime_t time)
+{
+    int i, j, k;
+
+    for (i = 0, j = n - 1; i < j;)
     {
         k = (i + j) / 2;
-        if (timediff(nav->peph[k].time, time) < 0.0)
+        if (timediff(t[k], time) < 0.0)
             i = k + 1;
         else
             j = k;
     }
-    index = i <= 0 ? 0 : i - 1;
+    return i <= 0 ? 0 : i - 1;
+}
+/* test context bracket of time ----------------------------------------------*/
+static int inepoch(gtime_t t0, double dt1, int index, int n, gtime_t time)
+{
+    double dt = timediff(time, t0);
+
+    /* same as binary search: t0<time<=t1, open at first and last epoch */
+    return (index == 0 || dt > 0.0) && (index + 2 == n || dt <= dt1);
+}
+/* locate precise ephemeris interpolation window -----------------------------*/
+static const pephctx_t *locpeph(const nav_t *nav, gtime_t time)
+{
+    pephctx_t *ctx = &pephctx;
+    double d;
+    int i, j, index;
+
+    if (ctx->time == nav->pe.time && ctx->ne == nav->pe.ne &&
+        timediff(nav->pe.time[ctx->index], ctx->t0) == 0.0 &&
+        inepoch(ctx->t0, ctx->dt1, ctx->index, ctx->ne, time))
+    {
+        return ctx;
+    }
+    index = searchepoch(nav->pe.time, nav->pe.ne, time);
 
-    /* polynomial interpolation for orbit */
     i = index - (NMAX + 1) / 2;
     if (i < 0)
         i = 0;
-    else if (i + NMAX >= nav->ne)
-        i = nav->ne - NMAX - 1;
+    else if (i + NMAX >= nav->pe.ne)
+        i = nav->pe.ne - NMAX - 1;
 
+    ctx->time = nav->pe.time;
+    ctx->ne = nav->pe.ne;
+    ctx->index = index;
+    ctx->i0 = i;
+    ctx->t0 = nav->pe.time[index];
+    ctx->dt1 = timediff(nav->pe.time[index + 1], ctx->t0);
+
+    for (j = 0; j <= NMAX; j++)
+    {
+        ctx->x[j] = timediff(nav->pe.time[i + j], ctx->t0);
+        ctx->sinx[j] = sin(OMGE * ctx->x[j]);
+        ctx->cosx[j] = cos(OMGE * ctx->x[j]);
+    }
+    /* barycentric weights w[j]=1/prod(x[j]-x[k]) scaled by window span */
+    d = ctx->x[NMAX] - ctx->x[0];
     for (j = 0; j <= NMAX; j++)
     {
-        t[j] = timediff(nav->peph[i + j].time, time);
-        if (norm(nav->peph[i + j].pos[sat - 1], 3) <= 0.0)
+        ctx->w[j] = 1.0;
+        for (i = 0; i <= NMAX; i++)
         {
-            trace(2, "prec ephem outage %s sat=%2d\n", time_str(time, 0), sat);
-            return 0;
+            if (i != j)
+                ctx->w[j] *= d / (ctx->x[j] - ctx->x[i]);
         }
     }
+    return ctx;
+}
+/* locate precise clock interpolation epochs ---------------------------------*/
+static const pclkctx_t *locpclk(const nav_t *nav, gtime_t time)
+{
+    pclkctx_t *ctx = &pclkctx;
+
+    if (ctx->time == nav->pc.time && ctx->nc == nav->pc.nc &&
+        timediff(nav->pc.time[ctx->index], ctx->t0) == 0.0 &&
+        inepoch(ctx->t0, ctx->dt1, ctx->index, ctx->nc, time))
+    {
+        return ctx;
+    }
+    ctx->time = nav->pc.time;
+    ctx->nc = nav->pc.nc;
+    ctx->index = searchepoch(nav->pc.time, nav->pc.nc, time);
+    ctx->t0 = nav->pc.time[ctx->index];
+    ctx->dt1 = timediff(nav->pc.time[ctx->index + 1], ctx->t0);
+    return ctx;
+}
+/* satellite position by precise ephemeris -----------------------------------*/
+static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs, double *dts, double *vare, double *varc)
+{
+    const pephctx_t *ctx;
+    const double *pos;
+    double t[NMAX + 1], c[2], std = 0.0, s[3], sinl, cosl, sint, cost, tau, a, sum = 0.0;
+    int i, j, index, node = -1;
+
+    trace(4, "pephpos : time=%s sat=%2d\n", time_str(time, 3), sat);
+
+    rs[0] = rs[1] = rs[2] = dts[0] = 0.0;
+
+    if (nav->pe.ne < NMAX + 1 || timediff(time, nav->pe.time[0]) < -MAXDTE ||
+        timediff(time, nav->pe.time[nav->pe.ne - 1]) > MAXDTE)
+    {
+        trace(2, "no prec ephem %s sat=%2d\n", time_str(time, 0), sat);
+        return 0;
+    }
+    /* interpolation window shared by satellites */
+    ctx = locpeph(nav, time);
+    index = ctx->index;
+    tau = timediff(time, ctx->t0);
+
     for (j = 0; j <= NMAX; j++)
     {
-        pos = nav->peph[i + j].pos[sat - 1];
-#if 0
-		p[0][j] = pos[0];
-		p[1][j] = pos[1];
-#else
-        /* correciton for earh rotation ver.2.4.0 */ //����ת������
-        sinl = sin(OMGE * t[j]);
-        cosl = cos(OMGE * t[j]);
-        p[0][j] = cosl * pos[0] - sinl * pos[1];
-        p[1][j] = sinl * pos[0] + cosl * pos[1];
-#endif
-        p[2][j] = pos[2];
+        t[j] = ctx->x[j] - tau;
     }
-    for (i = 0; i < 3; i++)
+    /* chebyshev orbit fitted at load */
+    if (!pephcheb(nav, sat, time, rs))
     {
-        rs[i] = interppol(t, p[i], NMAX + 1);
+        for (j = 0; j <= NMAX; j++)
+        {
+            if (norm(pephp(&nav->pe, sat, ctx->i0 + j), 3) <= 0.0)
+            {
+                trace(2, "prec ephem outage %s sat=%2d\n", time_str(time, 0), sat);
+                return 0;
+            }
+            if (t[j] == 0.0)
+                node = j;
+        }
+        /* polynomial interpolation for orbit by barycentric lagrange formula */
+        sint = sin(OMGE * tau);
+        cost = cos(OMGE * tau);
+        for (j = 0; j <= NMAX; j++)
+        {
+            if (node >= 0 && j != node)
+                continue;
+            a = node >= 0 ? 1.0 : ctx->w[j] / t[j];
+            pos = pephp(&nav->pe, sat, ctx->i0 + j);
+
+            /* correciton for earh rotation ver.2.4.0: angle OMGE*t[j] */
+            sinl = ctx->sinx[j] * cost - ctx->cosx[j] * sint;
+            cosl = ctx->cosx[j] * cost + ctx->sinx[j] * sint;
+            rs[0] += a * (cosl * pos[0] - sinl * pos[1]);
+            rs[1] += a * (sinl * pos[0] + cosl * pos[1]);
+            rs[2] += a * pos[2];
+            sum += a;
+        }
+        for (i = 0; i < 3; i++)
+        {
+            rs[i] /= sum;
+        }
     }
     if (vare)
     {
         for (i = 0; i < 3; i++)
-            s[i] = nav->peph[index].std[sat - 1][i];
+            s[i] = pephs(&nav->pe, sat, index, i);
         std = norm(s, 3);
 
         /* extrapolation error for orbit */
@@ -616,30 +1370,30 @@ static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs, double *
         *vare = SQR(std);
     }
     /* linear interpolation for clock */
-    t[0] = timediff(time, nav->peph[index].time);
-    t[1] = timediff(time, nav->peph[index + 1].time);
-    c[0] = nav->peph[index].pos[sat - 1][3];
-    c[1] = nav->peph[index + 1].pos[sat - 1][3];
+    t[0] = tau;
+    t[1] = tau - ctx->dt1;
+    c[0] = pephp(&nav->pe, sat, index)[3];
+    c[1] = pephp(&nav->pe, sat, index + 1)[3];
 
     if (t[0] <= 0.0)
     {
         if ((dts[0] = c[0]) != 0.0)
         {
-            std = nav->peph[index].std[sat - 1][3] * CLIGHT - EXTERR_CLK * t[0];
+            std = pephs(&nav->pe, sat, index, 3) * CLIGHT - EXTERR_CLK * t[0];
         }
     }
     else if (t[1] >= 0.0)
     {
         if ((dts[0] = c[1]) != 0.0)
         {
-            std = nav->peph[index + 1].std[sat - 1][3] * CLIGHT + EXTERR_CLK * t[1];
+            std = pephs(&nav->pe, sat, index + 1, 3) * CLIGHT + EXTERR_CLK * t[1];
         }
     }
     else if (c[0] != 0.0 && c[1] != 0.0)
     {
         dts[0] = (c[1] * t[0] - c[0] * t[1]) / (t[0] - t[1]);
         i = t[0] < -t[1] ? 0 : 1;
-        std = nav->peph[index + i].std[sat - 1][3] + EXTERR_CLK * fabs(t[i]);
+        std = pephs(&nav->pe, sat, index + i, 3) + EXTERR_CLK * fabs(t[i]);
     }
     else
     {
@@ -652,51 +1406,45 @@ static int pephpos(gtime_t time, int sat, const nav_t *nav, double *rs, double *
 /* satellite clock by precise clock ------------------------------------------*/
 static int pephclk(gtime_t time, int sat, const nav_t *nav, double *dts, double *varc)
 {
+    const pclkctx_t *ctx;
     double t[2], c[2], std;
-    int i, j, k, index;
+    int i, index;
 
     trace(4, "pephclk : time=%s sat=%2d\n", time_str(time, 3), sat);
 
-    if (nav->nc < 2 || timediff(time, nav->pclk[0].time) < -MAXDTE ||
-        timediff(time, nav->pclk[nav->nc - 1].time) > MAXDTE)
+    if (nav->pc.nc < 2 || timediff(time, nav->pc.time[0]) < -MAXDTE ||
+        timediff(time, nav->pc.time[nav->pc.nc - 1]) > MAXDTE)
     {
         trace(3, "no prec clock %s sat=%2d\n", time_str(time, 0), sat);
         return 1;
     }
-    /* binary search */
-    for (i = 0, j = nav->nc - 1; i < j;)
-    {
-        k = (i + j) / 2;
-        if (timediff(nav->pclk[k].time, time) < 0.0)
-            i = k + 1;
-        else
-            j = k;
-    }
-    index = i <= 0 ? 0 : i - 1;
+    /* clock epochs shared by satellites */
+    ctx = locpclk(nav, time);
+    index = ctx->index;
 
     /* linear interpolation for clock */
-    t[0] = timediff(time, nav->pclk[index].time);
-    t[1] = timediff(time, nav->pclk[index + 1].time);
-    c[0] = nav->pclk[index].clk[sat - 1][0];
-    c[1] = nav->pclk[index + 1].clk[sat - 1][0];
+    t[0] = timediff(time, ctx->t0);
+    t[1] = t[0] - ctx->dt1;
+    c[0] = pclkv(&nav->pc, sat, index);
+    c[1] = pclkv(&nav->pc, sat, index + 1);
 
     if (t[0] <= 0.0)
     {
         if ((dts[0] = c[0]) == 0.0)
             return 0;
-        std = nav->pclk[index].std[sat - 1][0] * CLIGHT - EXTERR_CLK * t[0];
+        std = pclks(&nav->pc, sat, index) * CLIGHT - EXTERR_CLK * t[0];
     }
     else if (t[1] >= 0.0)
     {
         if ((dts[0] = c[1]) == 0.0)
             return 0;
-        std = nav->pclk[index + 1].std[sat - 1][0] * CLIGHT + EXTERR_CLK * t[1];
+        std = pclks(&nav->pc, sat, index + 1) * CLIGHT + EXTERR_CLK * t[1];
     }
     else if (c[0] != 0.0 && c[1] != 0.0)
     {
         dts[0] = (c[1] * t[0] - c[0] * t[1]) / (t[0] - t[1]);
         i = t[0] < -t[1] ? 0 : 1;
-        std = nav->pclk[index + i].std[sat - 1][0] * CLIGHT + EXTERR_CLK * fabs(t[i]);
+        std = pclks(&nav->pc, sat, index + i) * CLIGHT + EXTERR_CLK * fabs(t[i]);
     }
     else
     {
@@ -801,8 +1549,8 @@ extern void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav,
  *                                 (NULL: no output)
  * return : status (1:ok,0:error or data outage)
  * notes  : clock includes relativistic correction but does not contain code bias
- *          before calling the function, nav->peph, nav->ne, nav->pclk and
- *          nav->nc must be set by calling readsp3(), readrnx() or readrnxt()
+ *          before calling the function, nav->pe and nav->pc must be set by
+ *          calling readsp3(), readrnxc() or packpeph(), packpclk()
  *          if precise clocks are not set, clocks in sp3 are used instead
  *-----------------------------------------------------------------------------*/
 extern int peph2pos(gtime_t time, int sat, const nav_t *nav, int opt, double *rs, double *dts, double *var)
@@ -86,8 +86,17 @@
  *           2016/09/17 1.26 fix bug on fit interval in QZSS RINEX nav
  *                           URA output value complient to RINEX 3.03
  *           2016/10/10 1.27 add api outrnxinavh()
+ *           2026/10/16 1.28 add rinex option -THREAD=n to decode rinex 3 obs
+ *                           data in parallel on memory-mapped file
+ *                           add api open_obsstr(),next_obsstr(),close_obsstr()
+ *                           read compact rinex and gzip files by rtk_fopen()
+ *                           read binary obs container by obs stream
  *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 /* constants/macros ----------------------------------------------------------*/
 
@@ -99,6 +108,7 @@
 #define MINFREQ_GLO -7                  /* min frequency number glonass */
 #define MAXFREQ_GLO 13                  /* max frequency number glonass */
 #define NINCOBS 262144                  /* inclimental number of obs data */
+#define MAXRNXTHREAD 64                 /* max number of threads to read obs data */
 
 static const int navsys[] = {/* satellite systems */
                              SYS_GPS, SYS_GLO, SYS_GAL, SYS_QZS, SYS_SBS, SYS_CMP, SYS_IRN, 0};
@@ -126,6 +136,27 @@ typedef struct
     double shift[MAXOBSTYPE]; /* phase shift (cycle) */
 } sigind_t;
 
+typedef struct
+{                       /* rinex body in memory type */
+    const char *p;      /* current position */
+    const char *e;      /* end of body */
+} rnxmem_t;
+
+typedef struct
+{                             /* rinex obs chunk type */
+    rnxmem_t mem;             /* chunk of body */
+    const char *opt;          /* rinex options */
+    double ver;               /* rinex version */
+    int tsys;                 /* time system */
+    char (*tobs)[MAXOBSTYPE][4]; /* obs types */
+    char *phaseshift;         /* phase shift options */
+    obsd_t *data;             /* obs data of chunk */
+    int n, nmax;              /* number of obs data/allocated */
+    int *nobs;                /* number of obs data of epochs */
+    int ne, nemax;            /* number of epochs/allocated */
+    int stat;                 /* status (1:ok,-1:error,-2:header in body) */
+} rnxchunk_t;
+
 /* set string without tail space ---------------------------------------------*/
 static void setstr(char *dst, const char *src, int n)
 {
@@ -1153,8 +1184,13 @@ static void restslips(unsigned char slips[][NFREQ], obsd_t *data)
         slips[data->sat - 1][i] = 0; //������ʶ����
     }
 }
-/* add obs data --------------------------------------------------------------*/
-static int addobsdata(obs_t *obs, const obsd_t *data)
+/* add obs data ----------------------------------------------------------------
+ * add obs data to the end of obs data buffer
+ * args   : obs_t  *obs      IO  observation data
+ *          obsd_t *data     I   obs data to be added
+ * return : status (1:ok,-1:memory allocation error (obs freed))
+ *-----------------------------------------------------------------------------*/
+extern int addobsdata(obs_t *obs, const obsd_t *data)
 {
     obsd_t *obs_data;
 
@@ -1357,9 +1393,31 @@ static void set_index(double ver, int sys, const char *opt, char tobs[MAXOBSTYPE
 	}
 #endif
 }
-/* read rinex obs data body --------------------------------------------------*/
-static int readrnxobsb(FILE *fp, const char *opt, double ver, int *tsys, char tobs[][MAXOBSTYPE][4], int *flag,
-                       obsd_t *data, sta_t *sta, char *phaseshift)
+/* read line from file or memory --------------------------------------------*/
+static char *rnxgets(char *buff, int n, FILE *fp, rnxmem_t *mem)
+{
+    const char *p, *q;
+    int len;
+
+    if (!mem)
+        return fgets(buff, n, fp);
+    if (mem->p >= mem->e)
+        return NULL;
+    len = (int)(mem->e - mem->p) < n - 1 ? (int)(mem->e - mem->p) : n - 1;
+    p = mem->p;
+    q = (const char *)memchr(p, '\n', (size_t)len);
+    len = q ? (int)(q - p) + 1 : len;
+    memcpy(buff, p, (size_t)len);
+    buff[len] = '\0';
+    mem->p += len;
+    return buff;
+}
+/* read rinex obs data body ----------------------------------------------------
+ * read an epoch of rinex obs data body from file or memory (mem!=NULL). for
+ * memory, -2 is returned by header records in body (epoch flag 3 or 4)
+ *-----------------------------------------------------------------------------*/
+static int readrnxobsb(FILE *fp, rnxmem_t *mem, const char *opt, double ver, int *tsys, char tobs[][MAXOBSTYPE][4],
+                       int *flag, obsd_t *data, sta_t *sta, char *phaseshift)
 {
     gtime_t time = {0};
     sigind_t index[7] = {{0}};
@@ -1378,7 +1436,7 @@ static int readrnxobsb(FILE *fp, const char *opt, double ver, int *tsys, char to
     set_index(ver, SYS_IRN, opt, tobs[6], index + 6, phaseshift);
 
     /* read record */
-    while (fgets(buff, MAXRNXLEN, fp))
+    while (rnxgets(buff, MAXRNXLEN, fp, mem))
     {
         /* decode obs epoch */
         if (i == 0)
@@ -1400,6 +1458,8 @@ static int readrnxobsb(FILE *fp, const char *opt, double ver, int *tsys, char to
         }
         else if (*flag == 3 || *flag == 4)
         { /* new site or header info follows */
+            if (mem)
+                return -2;
 
             /* decode obs header */
             decode_obsh(fp, buff, ver, tsys, tobs, NULL, sta, NULL);
@@ -1409,52 +1469,247 @@ static int readrnxobsb(FILE *fp, const char *opt, double ver, int *tsys, char to
     }
     return -1;
 }
+/* add obs data of epoch ----------------------------------------------------*/
+static int addobsepoch(obs_t *obs, obsd_t *data, int n, gtime_t ts, gtime_t te, double tint, int rcv, int tsys,
+                       uint8_t slips[][NFREQ])
+{
+    int i, stat = 1;
+
+    for (i = 0; i < n; i++)
+    {
+
+        /* utc -> gpst */
+        if (tsys == TSYS_UTC)
+            data[i].time = utc2gpst(data[i].time); // ϵͳUTCʱ
+
+        /* save cycle-slip */
+        saveslips(slips, data + i);
+    }
+    /* screen data by time */
+    if (n > 0 && !screent(data[0].time, ts, te, tint))
+        return 1;
+
+    for (i = 0; i < n; i++)
+    {
+
+        /* restore cycle-slip */
+        restslips(slips, data + i);
+
+        data[i].rcv = (uint8_t)rcv;
+
+        /* save obs data */
+        if ((stat = addobsdata(obs, data + i)) < 0)
+            break;
+    }
+    return stat;
+}
+/* number of threads to read rinex obs data ---------------------------------*/
+static int rnxthread(const char *opt)
+{
+    const char *p;
+    int n = 1;
+
+    if (!(p = strstr(opt, "-THREAD=")) || sscanf(p + 8, "%d", &n) < 1)
+        return 1;
+    return n < 1 ? 1 : (n > MAXRNXTHREAD ? MAXRNXTHREAD : n);
+}
+/* decode chunk of rinex obs data body ---------------------------------------*/
+#ifdef WIN32
+static DWORD WINAPI rnxchunkthread(void *arg)
+#else
+static void *rnxchunkthread(void *arg)
+#endif
+{
+    rnxchunk_t *c = (rnxchunk_t *)arg;
+    obsd_t data[MAXOBS], *obs_data;
+    int *nobs, n, flag = 0;
+
+    c->stat = 1;
+    while ((n = readrnxobsb(NULL, &c->mem, c->opt, c->ver, &c->tsys, c->tobs, &flag, data, NULL, c->phaseshift)) >=
+           0)
+    {
+        if (n == 0)
+            continue;
+        if (c->nmax < c->n + n)
+        {
+            c->nmax = c->nmax <= 0 ? NINCOBS / 4 : c->nmax * 2;
+            if (!(obs_data = (obsd_t *)realloc(c->data, sizeof(obsd_t) * c->nmax)))
+            {
+                c->stat = -1;
+                break;
+            }
+            c->data = obs_data;
+        }
+        if (c->nemax <= c->ne)
+        {
+            c->nemax = c->nemax <= 0 ? 4096 : c->nemax * 2;
+            if (!(nobs = (int *)realloc(c->nobs, sizeof(int) * c->nemax)))
+            {
+                c->stat = -1;
+                break;
+            }
+            c->nobs = nobs;
+        }
+        memcpy(c->data + c->n, data, sizeof(obsd_t) * n);
+        c->n += n;
+        c->nobs[c->ne++] = n;
+    }
+    if (n == -2)
+        c->stat = -2;
+    return 0;
+}
+/* read rinex 3 obs data body in parallel --------------------------------------
+ * map rinex obs data body after header, split it at epoch records ("> ") into
+ * chunks, decode them by threads and add obs data in time order
+ * return : status (1:ok,0:no data,-1:error,-2:not supported by the file)
+ * notes  : cycle-slips, time system and time screening are applied to epochs
+ *          in order of file after decoding as readrnxobs(). -2 is returned for
+ *          rinex 2, non-regular file or header records in body to read the
+ *          file sequentially from the start of body
+ *-----------------------------------------------------------------------------*/
+static int readrnxobsp(FILE *fp, gtime_t ts, gtime_t te, double tint, const char *opt, int rcv, double ver, int *tsys,
+                       char tobs[][MAXOBSTYPE][4], obs_t *obs, char *phaseshift, int nthread)
+{
+    rnxchunk_t c[MAXRNXTHREAD] = {{{0}}};
+    thread_t thread[MAXRNXTHREAD];
+    uint8_t slips[MAXSAT][NFREQ] = {{0}};
+    const char *body, *p, *q;
+    char *map;
+    size_t size, len;
+    long pos;
+    int i, j, k, n0 = obs->n, stat = 1, run[MAXRNXTHREAD] = {0};
+#ifndef WIN32
+    struct stat st;
+#endif
+
+    trace(3, "readrnxobsp: ver=%.2f nthread=%d\n", ver, nthread);
+
+    if (ver <= 2.99 || (pos = ftell(fp)) < 0)
+        return -2;
+
+    /* map rinex obs data body */
+#ifndef WIN32
+    if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) || (size = (size_t)st.st_size) <= (size_t)pos)
+        return -2;
+    if ((map = (char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0)) == MAP_FAILED)
+        return -2;
+    body = map + pos;
+    len = size - (size_t)pos;
+#else
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = (size_t)ftell(fp)) <= (size_t)pos || fseek(fp, pos, SEEK_SET) != 0 ||
+        !(map = (char *)malloc(size - pos)))
+    {
+        fseek(fp, pos, SEEK_SET);
+        return -2;
+    }
+    len = fread(map, 1, size - pos, fp);
+    body = map;
+#endif
+    /* split body at epoch records */
+    for (i = 0, p = body; i < nthread; i++)
+    {
+        c[i].mem.p = p;
+        if ((q = body + len * (i + 1) / nthread) < p)
+            q = p;
+        while (q < body + len && (q[0] != '>' || (q > body && q[-1] != '\n')))
+        {
+            if (!(q = (const char *)memchr(q, '\n', body + len - q)))
+                q = body + len;
+            else
+                q++;
+        }
+        c[i].mem.e = p = q;
+        c[i].opt = opt;
+        c[i].ver = ver;
+        c[i].tsys = *tsys;
+        c[i].tobs = tobs;
+        c[i].phaseshift = phaseshift;
+    }
+    /* decode chunks by threads */
+    for (i = 1; i < nthread; i++)
+    {
+#ifdef WIN32
+        run[i] = (thread[i] = CreateThread(NULL, 0, rnxchunkthread, c + i, 0, NULL)) != NULL;
+#else
+        run[i] = !pthread_create(thread + i, NULL, rnxchunkthread, c + i);
+#endif
+        if (!run[i])
+            rnxchunkthread(c + i);
+    }
+    rnxchunkthread(c);
+
+    for (i = 1; i < nthread; i++)
+    {
+        if (!run[i])
+            continue;
+#ifdef WIN32
+        WaitForSingleObject(thread[i], INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i], NULL);
+#endif
+    }
+    for (i = 0; i < nthread; i++)
+    {
+        if (c[i].stat < stat)
+            stat = c[i].stat;
+    }
+    /* add obs data in order of file */
+    for (i = 0; i < nthread && stat > 0; i++)
+    {
+        for (j = k = 0; j < c[i].ne && stat >= 0; k += c[i].nobs[j++])
+        {
+            stat = addobsepoch(obs, c[i].data + k, c[i].nobs[j], ts, te, tint, rcv, *tsys, slips);
+        }
+    }
+    for (i = 0; i < nthread; i++)
+    {
+        free(c[i].data);
+        free(c[i].nobs);
+    }
+#ifndef WIN32
+    munmap(map, size);
+#else
+    free(map);
+#endif
+    if (stat == -2)
+    {
+        trace(2, "readrnxobsp: header records in body\n");
+        fseek(fp, pos, SEEK_SET);
+    }
+    else if (stat > 0 && obs->n <= n0)
+        stat = 0; /* no obs data added */
+    trace(4, "readrnxobsp: nobs=%d stat=%d\n", obs->n, stat);
+    return stat;
+}
 /* read rinex obs ------------------------------------------------------------*/
 static int readrnxobs(FILE *fp, gtime_t ts, gtime_t te, double tint, const char *opt, int rcv, double ver, int *tsys,
                       char tobs[][MAXOBSTYPE][4], obs_t *obs, sta_t *sta, char *phaseshift)
 {
     obsd_t *data;
     uint8_t slips[MAXSAT][NFREQ] = {{0}};
-    int i, n, flag = 0, stat = 0;
+    int n, nthread, flag = 0, stat = 0;
 
     trace(4, "readrnxobs: rcv=%d ver=%.2f tsys=%d\n", rcv, ver, *tsys);
 
     if (!obs || rcv > MAXRCV)
         return 0;
 
+    /* read rinex 3 obs data body in parallel */
+    if ((nthread = rnxthread(opt)) > 1 &&
+        (stat = readrnxobsp(fp, ts, te, tint, opt, rcv, ver, tsys, tobs, obs, phaseshift, nthread)) != -2)
+    {
+        return stat;
+    }
+    stat = 0;
+
     if (!(data = (obsd_t *)malloc(sizeof(obsd_t) * MAXOBS)))
         return 0; //��ǿ������ת����malloc���ֽ�����
 
     /* read rinex obs data body */
-    while ((n = readrnxobsb(fp, opt, ver, tsys, tobs, &flag, data, sta, phaseshift)) >= 0 && stat >= 0)
+    while ((n = readrnxobsb(fp, NULL, opt, ver, tsys, tobs, &flag, data, sta, phaseshift)) >= 0 && stat >= 0)
     {
-
-        for (i = 0; i < n; i++)
-        {
-
-            /* utc -> gpst */
-            if (*tsys == TSYS_UTC)
-                data[i].time = utc2gpst(data[i].time); // ϵͳUTCʱ
-
-            /* save cycle-slip */
-            saveslips(slips, data + i);
-        }
-        /* screen data by time */
-        if (n > 0 && !screent(data[0].time, ts, te, tint))
-            continue;
-
-        for (i = 0; i < n; i++)
-        {
-
-            /* restore cycle-slip */
-            restslips(slips, data + i);
-
-            data[i].rcv = (uint8_t)rcv;
-
-            /* save obs data */
-            if ((stat = addobsdata(obs, data + i)) < 0)
-                break;
-        }
+        stat = addobsepoch(obs, data, n, ts, te, tint, rcv, *tsys, slips);
     }
     trace(4, "readrnxobs: nobs=%d stat=%d\n", obs->n, stat);
 
@@ -2003,7 +2258,7 @@ static int readrnxfile(const char *file, gtime_t ts, gtime_t te, double tint, co
                        char *type, obs_t *obs, nav_t *nav, sta_t *sta)
 {
     FILE *fp;
-    int cstat, stat;
+    int stat;
     char tmpfile[1024];
 
     trace(3, "readrnxfile: file=%s flag=%d index=%d\n", file, flag, index);
@@ -2011,22 +2266,17 @@ static int readrnxfile(const char *file, gtime_t ts, gtime_t te, double tint, co
     if (sta)
         init_sta(sta);
 
-    /* uncompress file */
-    if ((cstat = rtk_uncompress(file, tmpfile)) < 0)
+    /* open file with uncompression */
+    if (!(fp = rtk_fopen(file, tmpfile)))
     {
-        trace(2, "rinex file uncompact error: %s\n", file);
-        return 0;
-    }
-    if (!(fp = fopen(cstat ? tmpfile : file, "r")))
-    {
-        trace(2, "rinex file open error: %s\n", cstat ? tmpfile : file);
+        trace(2, "rinex file open error: %s\n", file);
         return 0;
     }
     /* read rinex file */
     stat = readrnxfp(fp, ts, te, tint, opt, flag, index, type, obs, nav, sta);
     fclose(fp);
     /* delete temporary file */
-    if (cstat)
+    if (*tmpfile)
         remove(tmpfile);
 
     return stat;
@@ -2064,6 +2314,10 @@ static int readrnxfile(const char *file, gtime_t ts, gtime_t te, double tint, co
  *            -SYS=sys[,sys...]: select navi systems
  *                               (sys=G:GPS,R:GLO,E:GAL,J:QZS,C:BDS,I:IRN,S:SBS)
  *
+ *            -THREAD=n: decode rinex 3 obs data by n threads on memory-mapped
+ *                       file (rinex 2, pipe or header records in body: read
+ *                       sequentially)
+ *
  *-----------------------------------------------------------------------------*/
 extern int readrnxt(const char *file, int rcv, gtime_t ts, gtime_t te, double tint, const char *opt, obs_t *obs,
                     nav_t *nav, sta_t *sta)
@@ -2196,6 +2450,10 @@ extern int readrnxc(const char *file, nav_t *nav)
     }
     /* expand wild-card */
     n = expath(file, files, MAXEXFILE);
+
+    /* append to precise clock already read */
+    unpackpclk(nav);
+
     /* read rinex clock files */
     for (i = 0; i < n; i++)
     {
@@ -2209,13 +2467,13 @@ extern int readrnxc(const char *file, nav_t *nav)
     for (i = 0; i < MAXEXFILE; i++)
         free(files[i]);
 
-    if (!stat)
-        return 0;
-
     /* unique and combine ephemeris and precise clock */
     combpclk(nav);
 
-    return nav->nc;
+    /* compact precise clock */
+    packpclk(nav);
+
+    return stat ? nav->pc.nc : 0;
 }
 /* initialize rinex control ----------------------------------------------------
  * initialize rinex control struct and reallocate memory for observation and
@@ -2238,6 +2496,8 @@ extern int init_rnxctr(rnxctr_t *rnx)
     rnx->nav.eph = NULL;
     rnx->nav.geph = NULL;
     rnx->nav.seph = NULL;
+    rnx->nav.ie.idx = rnx->nav.ig.idx = NULL;
+    rnx->nav.ie.n = rnx->nav.ig.n = 0;
 
     if (!(rnx->obs.data = (obsd_t *)malloc(sizeof(obsd_t) * MAXOBS)) ||
         !(rnx->nav.eph = (eph_t *)malloc(sizeof(eph_t) * MAXSAT)) ||
@@ -2301,8 +2561,8 @@ extern int open_rnxctr(rnxctr_t *rnx, FILE *fp)
 {
     const char *rnxtypes = "ONGLJHC";
     double ver;
-    char type, tobs[6][MAXOBSTYPE][4] = {{""}};
-    int i, j, sys, tsys;
+    char type, tobs[NUMSYS][MAXOBSTYPE][4] = {{""}};
+    int sys, tsys;
 
     trace(3, "open_rnxctr:\n");
 
@@ -2321,11 +2581,7 @@ extern int open_rnxctr(rnxctr_t *rnx, FILE *fp)
     rnx->type = type;
     rnx->sys = sys;
     rnx->tsys = tsys;
-    for (i = 0; i < 6; i++)
-        for (j = 0; j < MAXOBSTYPE && *tobs[i][j]; j++)
-        {
-            strcpy(rnx->tobs[i][j], tobs[i][j]);
-        }
+    memcpy(rnx->tobs, tobs, sizeof(tobs));
     rnx->ephsat = 0;
     return 1;
 }
@@ -2348,7 +2604,7 @@ extern int input_rnxctr(rnxctr_t *rnx, FILE *fp)
     /* read rinex obs data */
     if (rnx->type == 'O')
     {
-        if ((n = readrnxobsb(fp, rnx->opt, rnx->ver, &rnx->tsys, rnx->tobs, &flag, rnx->obs.data, &rnx->sta, NULL)) <=
+        if ((n = readrnxobsb(fp, NULL, rnx->opt, rnx->ver, &rnx->tsys, rnx->tobs, &flag, rnx->obs.data, &rnx->sta, NULL)) <=
             0)
         {
             rnx->obs.n = 0;
@@ -2405,6 +2661,207 @@ extern int input_rnxctr(rnxctr_t *rnx, FILE *fp)
     }
     return 2;
 }
+/* open expanded file of obs stream ----------------------------------------*/
+static int openobsstr(obsstr_t *str, int index)
+{
+    char *files[MAXEXFILE] = {0};
+    int i, n, stat = 0;
+
+    if (str->fp)
+        fclose(str->fp);
+    str->fp = NULL;
+    if (str->obc.p)
+        close_obc(&str->obc);
+    if (*str->tmpfile)
+        remove(str->tmpfile);
+    *str->tmpfile = '\0';
+
+    for (i = 0; i < MAXEXFILE; i++)
+    {
+        if (!(files[i] = (char *)malloc(1024)))
+        {
+            for (i--; i >= 0; i--)
+                free(files[i]);
+            return 0;
+        }
+    }
+    n = expath(str->path, files, MAXEXFILE);
+
+    for (; index < n && !stat; index++)
+    {
+        trace(3, "openobsstr: file=%s\n", files[index]);
+
+        /* binary obs container (decoded from the first epoch as rinex to
+           carry cycle-slips of epochs before start time) */
+        if (open_obc(&str->obc, files[index]))
+        {
+            str->rnx.sta = str->obc.sta;
+            str->rnx.tsys = TSYS_GPS;
+            str->ifile = index;
+            stat = 1;
+            break;
+        }
+        if (!(str->fp = rtk_fopen(files[index], str->tmpfile)))
+        {
+            trace(2, "rinex file open error: %s\n", files[index]);
+            continue;
+        }
+        else if (open_rnxctr(&str->rnx, str->fp) && str->rnx.type == 'O')
+        {
+            str->ifile = index;
+            stat = 1;
+            break;
+        }
+        else
+        {
+            trace(2, "not rinex obs file: %s\n", files[index]);
+            fclose(str->fp);
+            str->fp = NULL;
+        }
+        if (*str->tmpfile)
+            remove(str->tmpfile);
+        *str->tmpfile = '\0';
+    }
+    for (i = 0; i < MAXEXFILE; i++)
+        free(files[i]);
+    return stat;
+}
+/* open obs stream -------------------------------------------------------------
+ * open rinex obs files as stream of epochs
+ * args   : obsstr_t *str I   obs stream
+ *          char  *file   I   file (wild-card * expanded)
+ *          int    rcv    I   receiver number for obs data
+ *          gtime_t ts    I   observation time start (ts.time==0: no limit)
+ *          gtime_t te    I   observation time end   (te.time==0: no limit)
+ *          double tint   I   observation time interval (s) (0:all)
+ *          char  *opt    I   rinex options (see readrnxt())
+ * return : status (1:ok,0:error or no obs data)
+ * notes  : expanded files are read in order as a stream. the first epoch is
+ *          read as current epoch in str->rnx.obs and station parameters of
+ *          rinex header are set to str->rnx.sta. obs data are screened,
+ *          converted to gpst and sorted by satellite as readobs() but only
+ *          an epoch is kept in memory.
+ *          binary obs containers (see writeobc()) are read as rinex obs files
+ *-----------------------------------------------------------------------------*/
+extern int open_obsstr(obsstr_t *str, const char *file, int rcv, gtime_t ts, gtime_t te, double tint,
+                       const char *opt)
+{
+    const char *p;
+
+    trace(3, "open_obsstr: file=%s rcv=%d\n", file, rcv);
+
+    memset(str, 0, sizeof(obsstr_t));
+
+    if (!init_rnxctr(&str->rnx))
+        return 0;
+    init_sta(&str->rnx.sta);
+    setstr(str->path, file, 1023);
+    setstr(str->rnx.opt, opt, 255);
+    str->rcv = rcv;
+    str->ts = ts;
+    str->te = te;
+    str->tint = tint;
+
+    if (!openobsstr(str, 0) || next_obsstr(str) <= 0)
+    {
+        close_obsstr(str);
+        return 0;
+    }
+    /* if station name empty, set 4-char name from file head */
+    if (!*str->rnx.sta.name)
+    {
+        if (!(p = strrchr(file, FILEPATHSEP)))
+            p = file - 1;
+        setstr(str->rnx.sta.name, p + 1, 4);
+    }
+    return 1;
+}
+/* next epoch of obs stream ----------------------------------------------------
+ * read next epoch of obs stream as current epoch
+ * args   : obsstr_t *str IO  obs stream
+ * return : number of obs data of current epoch in str->rnx.obs (0:end,
+ *          -1:obs container read error)
+ * notes  : the stream is closed by obs container read error (not read as end
+ *          of the container to continue with the next file)
+ *-----------------------------------------------------------------------------*/
+extern int next_obsstr(obsstr_t *str)
+{
+    obsd_t *data = str->rnx.obs.data;
+    int i, n, stat = 0;
+
+    trace(4, "next_obsstr:\n");
+
+    while (str->fp || str->obc.p)
+    {
+        if (!str->obc.p)
+            stat = input_rnxctr(&str->rnx, str->fp);
+        else if ((stat = read_obc(&str->obc, data, MAXOBS)) >= 0)
+        {
+            str->rnx.obs.n = stat;
+            stat = 1;
+        }
+        else if (stat == -1)
+        {
+            trace(1, "next_obsstr: obs container read error ifile=%d\n", str->ifile);
+            checkbrk("error : obs container read error");
+            close_obc(&str->obc);
+            break;
+        }
+        if (stat == -2)
+        {
+            /* next expanded file */
+            if (!openobsstr(str, str->ifile + 1))
+                break;
+            continue;
+        }
+        if (stat != 1 || (n = str->rnx.obs.n) <= 0)
+            continue;
+
+        for (i = 0; i < n; i++)
+        {
+            /* utc -> gpst */
+            if (str->rnx.tsys == TSYS_UTC)
+                data[i].time = utc2gpst(data[i].time);
+
+            /* save cycle-slip */
+            saveslips(str->slips, data + i);
+        }
+        /* screen data by time */
+        if (!screent(data[0].time, str->ts, str->te, str->tint))
+            continue;
+
+        for (i = 0; i < n; i++)
+        {
+            /* restore cycle-slip */
+            restslips(str->slips, data + i);
+
+            data[i].rcv = (uint8_t)str->rcv;
+        }
+        sortobs(&str->rnx.obs);
+        return str->rnx.obs.n;
+    }
+    str->rnx.obs.n = 0;
+    return stat == -1 ? -1 : 0;
+}
+/* close obs stream ------------------------------------------------------------
+ * close rinex obs files of stream and free buffer
+ * args   : obsstr_t *str IO  obs stream
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void close_obsstr(obsstr_t *str)
+{
+    trace(3, "close_obsstr:\n");
+
+    if (str->fp)
+        fclose(str->fp);
+    str->fp = NULL;
+    if (str->obc.p)
+        close_obc(&str->obc);
+    if (*str->tmpfile)
+        remove(str->tmpfile);
+    *str->tmpfile = '\0';
+    free_rnxctr(&str->rnx);
+}
 /*------------------------------------------------------------------------------
  * output rinex functions
  *-----------------------------------------------------------------------------*/
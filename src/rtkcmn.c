@@ -4,6 +4,7 @@
  *          Copyright (C) 2007-2016 by T.TAKASU, All rights reserved.
  *
  * options : -DLAPACK   use LAPACK/BLAS
+ *           -DBLAS     use BLAS dgemm for matmul() only
  *           -DMKL      use Intel MKL
  *           -DTRACE    enable debug trace
  *           -DWIN32    use WIN32 API
@@ -146,6 +147,30 @@
 
 #define POLYCRC32 0xEDB88320u /* CRC32 polynomial */
 #define POLYCRC24Q 0x1864CFBu /* CRC24Q polynomial */
+#define SYMNB 32                /* column block size of symmetric product */
+#define SYMIX(i, j) ((i) <= (j) ? (i) + (j) * ((j) + 1) / 2 : (j) + (i) * ((i) + 1) / 2) /* packed index */
+#define ARENA_BLK (4 << 20)     /* minimum block size of workspace arena (bytes) */
+#define ARENA_ALIGN 64          /* alignment of workspace arena allocation (bytes) */
+#define SUNMOONGRID 0.5         /* time grid of sun/moon position cache (s) */
+#define MAXNUMDIG 19            /* max significant digits of fast number parser */
+
+typedef struct arenablk_tag
+{                                      /* workspace arena block type */
+    struct arenablk_tag *prev, *next; /* previous/next block */
+    size_t base;                       /* bytes of preceding blocks */
+    char *ptr, *end;                   /* current/end pointer of free area */
+    char *buf;                         /* start of data area */
+} arenablk_t;
+
+typedef struct
+{                          /* workspace arena type */
+    arenablk_t *first;     /* first block */
+    arenablk_t *cur;       /* current block */
+    size_t size;           /* total bytes of blocks */
+    size_t peak;           /* peak bytes in use */
+} arena_t;
+
+static THREADLOCAL arena_t arena; /* workspace arena (thread-local) */
 
 static const double gpst0[] = {1980, 1, 6, 0, 0, 0}; /* gps time reference */
 static const double gst0[] = {1999, 8, 22, 0, 0, 0}; /* galileo system time reference */
@@ -364,9 +389,11 @@ static const unsigned int tbl_CRC24Q[] = {
 #define dgetri_ dgetri
 #define dgetrs_ dgetrs
 #endif
-#ifdef LAPACK
+#if defined(LAPACK) || defined(BLAS)
 extern void dgemm_(char *, char *, int *, int *, int *, double *, double *, int *, double *, int *, double *, double *,
                    int *);
+#endif
+#ifdef LAPACK
 extern void dgetrf_(int *, int *, double *, int *, int *, int *);
 extern void dgetri_(int *, double *, int *, int *, double *, int *, int *);
 extern void dgetrs_(char *, int *, int *, double *, int *, int *, double *, int *, int *);
@@ -1310,6 +1337,188 @@ extern double *eye(int n)
             p[i + i * n] = 1.0;
     return p;
 }
+/* new block of workspace arena ---------------------------------------------*/
+static arenablk_t *newblk(size_t size)
+{
+    arenablk_t *b;
+
+    if (!(b = (arenablk_t *)malloc(sizeof(arenablk_t) + size + ARENA_ALIGN)))
+    {
+        fatalerr("workspace arena allocation error: size=%lu\n", (unsigned long)size);
+    }
+    b->prev = b->next = NULL;
+    b->buf = (char *)(((size_t)(b + 1) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    b->ptr = b->buf;
+    b->end = b->buf + size;
+    b->base = 0;
+    return b;
+}
+/* allocate memory from workspace arena --------------------------------------*/
+static void *arenaalloc(size_t size)
+{
+    arenablk_t *b = arena.cur, *nb;
+    size_t used;
+    void *p;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (!b || b->ptr + size > b->end)
+    {
+        /* next spare block or new block */
+        if (b && b->next && (size_t)(b->next->end - b->next->buf) >= size)
+        {
+            nb = b->next;
+        }
+        else
+        {
+            nb = newblk(size > ARENA_BLK ? size : ARENA_BLK);
+            arena.size += nb->end - nb->buf;
+            if (b)
+            {
+                /* spare blocks following current one are released */
+                while (b->next)
+                {
+                    arenablk_t *q = b->next;
+                    b->next = q->next;
+                    arena.size -= q->end - q->buf;
+                    free(q);
+                }
+                b->next = nb;
+                nb->prev = b;
+            }
+            else
+            {
+                arena.first = nb;
+            }
+        }
+        nb->base = b ? b->base + (b->end - b->buf) : 0;
+        nb->ptr = nb->buf;
+        arena.cur = b = nb;
+    }
+    p = b->ptr;
+    b->ptr += size;
+    used = b->base + (b->ptr - b->buf);
+    if (used > arena.peak)
+        arena.peak = used;
+    return p;
+}
+/* mark of workspace arena -----------------------------------------------------
+ * get current position of thread-local workspace arena to release allocations
+ * after it by arenarelease()
+ * args   : none
+ * return : mark of workspace arena
+ * notes  : allocations by amat(),aimat(),azeros() and aeye() are released in
+ *          last-in first-out order. they must not be freed by free()
+ *-----------------------------------------------------------------------------*/
+extern void *arenamark(void)
+{
+    return arena.cur ? arena.cur->ptr : NULL;
+}
+/* release workspace arena -----------------------------------------------------
+ * release allocations of thread-local workspace arena after the mark
+ * args   : void   *mark     I   mark by arenamark() (NULL: release all)
+ * return : none
+ * notes  : memory blocks are kept for following allocations. if all are
+ *          released, multiple blocks are merged to one
+ *-----------------------------------------------------------------------------*/
+extern void arenarelease(void *mark)
+{
+    arenablk_t *b = arena.cur, *q;
+    size_t size;
+
+    if (!b)
+        return;
+    if (mark)
+    {
+        while (b && ((char *)mark < b->buf || (char *)mark > b->end))
+            b = b->prev;
+        if (b)
+        {
+            b->ptr = (char *)mark;
+            arena.cur = b;
+            return;
+        }
+    }
+    /* release all and merge blocks */
+    if (arena.first->next)
+    {
+        size = arena.size;
+        for (b = arena.first; b; b = q)
+        {
+            q = b->next;
+            free(b);
+        }
+        arena.first = newblk(size);
+    }
+    arena.first->ptr = arena.first->buf;
+    arena.cur = arena.first;
+}
+/* status of workspace arena ---------------------------------------------------
+ * get peak usage and size of thread-local workspace arena
+ * args   : size_t *peak     O   peak bytes in use since last call (NULL: no output)
+ *          size_t *size     O   total bytes of arena blocks (NULL: no output)
+ * return : none
+ * notes  : peak counter is reset to current usage
+ *-----------------------------------------------------------------------------*/
+extern void arenastat(size_t *peak, size_t *size)
+{
+    if (peak)
+        *peak = arena.peak;
+    if (size)
+        *size = arena.size;
+    arena.peak = arena.cur ? arena.cur->base + (arena.cur->ptr - arena.cur->buf) : 0;
+}
+/* new matrix in workspace arena -----------------------------------------------
+ * allocate memory of matrix from thread-local workspace arena
+ * args   : int    n,m       I   number of rows and columns of matrix
+ * return : matrix pointer (if n<=0 or m<=0, return NULL)
+ * notes  : memory is released by arenarelease()
+ *-----------------------------------------------------------------------------*/
+extern double *amat(int n, int m)
+{
+    if (n <= 0 || m <= 0)
+        return NULL;
+    return (double *)arenaalloc(sizeof(double) * n * m);
+}
+/* new integer matrix in workspace arena ---------------------------------------
+ * allocate memory of integer matrix from thread-local workspace arena
+ * args   : int    n,m       I   number of rows and columns of matrix
+ * return : matrix pointer (if n<=0 or m<=0, return NULL)
+ *-----------------------------------------------------------------------------*/
+extern int *aimat(int n, int m)
+{
+    if (n <= 0 || m <= 0)
+        return NULL;
+    return (int *)arenaalloc(sizeof(int) * n * m);
+}
+/* zero matrix in workspace arena ----------------------------------------------
+ * generate new zero matrix in thread-local workspace arena
+ * args   : int    n,m       I   number of rows and columns of matrix
+ * return : matrix pointer (if n<=0 or m<=0, return NULL)
+ *-----------------------------------------------------------------------------*/
+extern double *azeros(int n, int m)
+{
+    double *p;
+
+    if ((p = amat(n, m)))
+        memset(p, 0, sizeof(double) * n * m);
+    return p;
+}
+/* identity matrix in workspace arena ------------------------------------------
+ * generate new identity matrix in thread-local workspace arena
+ * args   : int    n         I   number of rows and columns of matrix
+ * return : matrix pointer (if n<=0, return NULL)
+ *-----------------------------------------------------------------------------*/
+extern double *aeye(int n)
+{
+    double *p;
+    int i;
+
+    if ((p = azeros(n, n)))
+        for (i = 0; i < n; i++)
+            p[i + i * n] = 1.0;
+    return p;
+}
 /* inner product ---------------------------------------------------------------
  * inner product of vectors
  * args   : double *a,*b     I   vector a,b (n x 1)
@@ -1442,6 +1651,19 @@ extern void Linv(double *L, int n)
 }
 /* matrix routines -----------------------------------------------------------*/
 
+#if defined(LAPACK) || defined(BLAS)
+/* multiply matrix with leading dimensions (wrapper of blas dgemm) -----------*/
+static void matmulld(const char *tr, int n, int k, int m, double alpha, const double *A, int lda, const double *B,
+                     int ldb, double beta, double *C, int ldc)
+{
+    if (n <= 0 || k <= 0)
+        return;
+    lda = lda < 1 ? 1 : lda; /* dgemm requires lda,ldb>=1 */
+    ldb = ldb < 1 ? 1 : ldb;
+    dgemm_((char *)tr, (char *)tr + 1, &n, &k, &m, &alpha, (double *)A, &lda, (double *)B, &ldb, &beta, C, &ldc);
+}
+#endif
+
 #ifdef LAPACK /* with LAPACK/BLAS or MKL */
 
 /* multiply matrix (wrapper of blas dgemm) -------------------------------------
@@ -1457,9 +1679,7 @@ extern void Linv(double *L, int n)
 extern void matmul(const char *tr, int n, int k, int m, double alpha, const double *A, const double *B, double beta,
                    double *C)
 {
-    int lda = tr[0] == 'T' ? m : n, ldb = tr[1] == 'T' ? k : m;
-
-    dgemm_((char *)tr, (char *)tr + 1, &n, &k, &m, &alpha, (double *)A, &lda, (double *)B, &ldb, &beta, C, &n);
+    matmulld(tr, n, k, m, alpha, A, tr[0] == 'T' ? m : n, B, tr[1] == 'T' ? k : m, beta, C, n);
 }
 /* inverse of matrix -----------------------------------------------------------
  * inverse of matrix (A=A^-1)
@@ -1469,15 +1689,15 @@ extern void matmul(const char *tr, int n, int k, int m, double alpha, const doub
  *-----------------------------------------------------------------------------*/
 extern int matinv(double *A, int n)
 {
+    void *mk = arenamark();
     double *work;
-    int info, lwork = n * 16, *ipiv = imat(n, 1);
+    int info, lwork = n * 16, *ipiv = aimat(n, 1);
 
-    work = mat(lwork, 1);
+    work = amat(lwork, 1);
     dgetrf_(&n, &n, A, &n, ipiv, &info);
     if (!info)
         dgetri_(&n, A, &n, ipiv, work, &lwork, &info);
-    free(ipiv);
-    free(work);
+    arenarelease(mk);
     return info;
 }
 /* solve linear equation -------------------------------------------------------
@@ -1493,61 +1713,322 @@ extern int matinv(double *A, int n)
  *-----------------------------------------------------------------------------*/
 extern int solve(const char *tr, const double *A, const double *Y, int n, int m, double *X)
 {
-    double *B = mat(n, n);
-    int info, *ipiv = imat(n, 1);
+    void *mk = arenamark();
+    double *B = amat(n, n);
+    int info, *ipiv = aimat(n, 1);
 
     matcpy(B, A, n, n);
     matcpy(X, Y, n, m);
     dgetrf_(&n, &n, B, &n, ipiv, &info);
     if (!info)
         dgetrs_((char *)tr, &n, &m, B, &n, ipiv, X, &n, &info);
-    free(ipiv);
-    free(B);
+    arenarelease(mk);
     return info;
 }
 
 #else /* without LAPACK/BLAS or MKL */
 
-/* multiply matrix -----------------------------------------------------------*/
+/* multiply matrix -------------------------------------------------------------
+ * multiply matrix by matrix (C=alpha*A*B+beta*C)
+ * args   : char   *tr       I  transpose flags ("N":normal,"T":transpose)
+ *          int    n,k,m     I  size of (transposed) matrix A,B
+ *          double alpha     I  alpha
+ *          double *A,*B     I  (transposed) matrix A (n x m), B (m x k)
+ *          double beta      I  beta
+ *          double *C        IO matrix C (n x k)
+ * return : none
+ * notes  : small matrices are multiplied by plain loops. for larger ones, A and
+ *          B are packed into MR x KC and KC x NR panels and multiplied by a
+ *          register-tiled kernel selected at run time (AVX-512, AVX2+FMA or
+ *          scalar)
+ *-----------------------------------------------------------------------------*/
+#ifdef BLAS /* with BLAS dgemm */
+
 extern void matmul(const char *tr, int n, int k, int m, double alpha, const double *A, const double *B, double beta,
-                   double *C) // n*m�����վ����С
+                   double *C)
 {
-    double d;
-    int i, j, x, f = tr[0] == 'N' ? (tr[1] == 'N' ? 1 : 2) : (tr[1] == 'N' ? 3 : 4); // N��normal    T:transpose
+    matmulld(tr, n, k, m, alpha, A, tr[0] == 'T' ? m : n, B, tr[1] == 'T' ? k : m, beta, C, n);
+}
 
-    for (i = 0; i < n; i++)
-        for (j = 0; j < k; j++)
+#else /* without BLAS dgemm */
+
+#define MM_KC 256        /* depth of packed panels */
+#define MM_MC 128        /* rows of packed block of A (multiple of MR) */
+#define MM_MINOPS 4096   /* min n*k*m for blocked kernel */
+#define MM_MAXMR 16      /* max rows of micro-kernel tile */
+#define MM_MAXNR 4       /* max columns of micro-kernel tile */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MM_X86
+#include <immintrin.h>
+#endif
+
+typedef struct
+{                                                 /* matmul micro-kernel type */
+    int mr, nr;                                   /* tile size (rows x columns) */
+    void (*kern)(int, const double *, const double *, double *); /* tile=a'*b (packed panels) */
+    const char *name;                             /* kernel name */
+} mmkern_t;
+
+/* micro-kernel (scalar) -----------------------------------------------------*/
+static void mmkern_c(int kc, const double *a, const double *b, double *c)
+{
+    double c0[4] = {0}, c1[4] = {0}, c2[4] = {0}, c3[4] = {0};
+    int i, p;
+
+    for (p = 0; p < kc; p++, a += 4, b += 4)
+    {
+        for (i = 0; i < 4; i++)
         {
-            d = 0.0;
-            switch (f)
+            c0[i] += a[i] * b[0];
+            c1[i] += a[i] * b[1];
+            c2[i] += a[i] * b[2];
+            c3[i] += a[i] * b[3];
+        }
+    }
+    for (i = 0; i < 4; i++)
+    {
+        c[i] = c0[i];
+        c[i + 4] = c1[i];
+        c[i + 8] = c2[i];
+        c[i + 12] = c3[i];
+    }
+}
+#ifdef MM_X86
+/* micro-kernel (avx2+fma, 8 x 4) --------------------------------------------*/
+__attribute__((target("avx2,fma"))) static void mmkern_avx2(int kc, const double *a, const double *b, double *c)
+{
+    __m256d c00 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c11 = _mm256_setzero_pd(), c02 = _mm256_setzero_pd(), c12 = _mm256_setzero_pd();
+    __m256d c03 = _mm256_setzero_pd(), c13 = _mm256_setzero_pd(), a0, a1, bb;
+    int p;
+
+    for (p = 0; p < kc; p++, a += 8, b += 4)
+    {
+        a0 = _mm256_loadu_pd(a);
+        a1 = _mm256_loadu_pd(a + 4);
+        bb = _mm256_broadcast_sd(b);
+        c00 = _mm256_fmadd_pd(a0, bb, c00);
+        c10 = _mm256_fmadd_pd(a1, bb, c10);
+        bb = _mm256_broadcast_sd(b + 1);
+        c01 = _mm256_fmadd_pd(a0, bb, c01);
+        c11 = _mm256_fmadd_pd(a1, bb, c11);
+        bb = _mm256_broadcast_sd(b + 2);
+        c02 = _mm256_fmadd_pd(a0, bb, c02);
+        c12 = _mm256_fmadd_pd(a1, bb, c12);
+        bb = _mm256_broadcast_sd(b + 3);
+        c03 = _mm256_fmadd_pd(a0, bb, c03);
+        c13 = _mm256_fmadd_pd(a1, bb, c13);
+    }
+    _mm256_storeu_pd(c, c00);
+    _mm256_storeu_pd(c + 4, c10);
+    _mm256_storeu_pd(c + 8, c01);
+    _mm256_storeu_pd(c + 12, c11);
+    _mm256_storeu_pd(c + 16, c02);
+    _mm256_storeu_pd(c + 20, c12);
+    _mm256_storeu_pd(c + 24, c03);
+    _mm256_storeu_pd(c + 28, c13);
+}
+/* micro-kernel (avx-512, 16 x 4) --------------------------------------------*/
+__attribute__((target("avx512f"))) static void mmkern_avx512(int kc, const double *a, const double *b, double *c)
+{
+    __m512d c00 = _mm512_setzero_pd(), c10 = _mm512_setzero_pd(), c01 = _mm512_setzero_pd();
+    __m512d c11 = _mm512_setzero_pd(), c02 = _mm512_setzero_pd(), c12 = _mm512_setzero_pd();
+    __m512d c03 = _mm512_setzero_pd(), c13 = _mm512_setzero_pd(), a0, a1, bb;
+    int p;
+
+    for (p = 0; p < kc; p++, a += 16, b += 4)
+    {
+        a0 = _mm512_loadu_pd(a);
+        a1 = _mm512_loadu_pd(a + 8);
+        bb = _mm512_set1_pd(b[0]);
+        c00 = _mm512_fmadd_pd(a0, bb, c00);
+        c10 = _mm512_fmadd_pd(a1, bb, c10);
+        bb = _mm512_set1_pd(b[1]);
+        c01 = _mm512_fmadd_pd(a0, bb, c01);
+        c11 = _mm512_fmadd_pd(a1, bb, c11);
+        bb = _mm512_set1_pd(b[2]);
+        c02 = _mm512_fmadd_pd(a0, bb, c02);
+        c12 = _mm512_fmadd_pd(a1, bb, c12);
+        bb = _mm512_set1_pd(b[3]);
+        c03 = _mm512_fmadd_pd(a0, bb, c03);
+        c13 = _mm512_fmadd_pd(a1, bb, c13);
+    }
+    _mm512_storeu_pd(c, c00);
+    _mm512_storeu_pd(c + 8, c10);
+    _mm512_storeu_pd(c + 16, c01);
+    _mm512_storeu_pd(c + 24, c11);
+    _mm512_storeu_pd(c + 32, c02);
+    _mm512_storeu_pd(c + 40, c12);
+    _mm512_storeu_pd(c + 48, c03);
+    _mm512_storeu_pd(c + 56, c13);
+}
+#endif /* MM_X86 */
+
+/* select micro-kernel by cpu features ---------------------------------------*/
+static const mmkern_t *mmkernel(void)
+{
+    static const mmkern_t kern_c = {4, 4, mmkern_c, "scalar"};
+#ifdef MM_X86
+    static const mmkern_t kern_avx2 = {8, 4, mmkern_avx2, "avx2"};
+    static const mmkern_t kern_avx512 = {16, 4, mmkern_avx512, "avx512"};
+#endif
+    static const mmkern_t *kern = NULL;
+
+    if (kern)
+        return kern;
+#ifdef MM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        kern = &kern_avx512;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kern = &kern_avx2;
+    else
+#endif
+        kern = &kern_c;
+    trace(3, "matmul kernel: %s\n", kern->name);
+    return kern;
+}
+/* pack block of op(A) into mr-row panels (zero padded) ----------------------*/
+static void mmpacka(int ta, const double *A, int lda, int i0, int mc, int p0, int kc, int mr, double *Ap)
+{
+    const double *a;
+    int i, ir, p, r, nr;
+
+    for (ir = 0; ir < mc; ir += mr)
+    {
+        nr = mc - ir < mr ? mc - ir : mr;
+        for (p = 0; p < kc; p++, Ap += mr)
+        {
+            i = i0 + ir;
+            if (!ta)
+            { /* A(i,p)=A[i+p*lda] */
+                a = A + i + (p0 + p) * lda;
+                for (r = 0; r < nr; r++)
+                    Ap[r] = a[r];
+            }
+            else
+            { /* A(i,p)=A[p+i*lda] */
+                a = A + (p0 + p) + i * lda;
+                for (r = 0; r < nr; r++)
+                    Ap[r] = a[r * lda];
+            }
+            for (; r < mr; r++)
+                Ap[r] = 0.0;
+        }
+    }
+}
+/* pack block of op(B) into nr-column panels (zero padded) -------------------*/
+static void mmpackb(int tb, const double *B, int ldb, int k, int p0, int kc, int nr, double *Bp)
+{
+    const double *b;
+    int j, p, c, nc;
+
+    for (j = 0; j < k; j += nr)
+    {
+        nc = k - j < nr ? k - j : nr;
+        for (p = 0; p < kc; p++, Bp += nr)
+        {
+            if (!tb)
+            { /* B(p,j)=B[p+j*ldb] */
+                b = B + (p0 + p) + j * ldb;
+                for (c = 0; c < nc; c++)
+                    Bp[c] = b[c * ldb];
+            }
+            else
+            { /* B(p,j)=B[j+p*ldb] */
+                b = B + j + (p0 + p) * ldb;
+                for (c = 0; c < nc; c++)
+                    Bp[c] = b[c];
+            }
+            for (; c < nr; c++)
+                Bp[c] = 0.0;
+        }
+    }
+}
+/* blocked matrix multiplication (C+=alpha*op(A)*op(B)) ----------------------*/
+static void matmul_blk(const mmkern_t *kn, int ta, int tb, int n, int k, int m, double alpha, const double *A,
+                       int lda, const double *B, int ldb, double *C, int ldc)
+{
+    void *mk = arenamark();
+    double *Ap, *Bp, tile[MM_MAXMR * MM_MAXNR], *c;
+    int mr = kn->mr, nr = kn->nr, nb = (k + nr - 1) / nr * nr, i, j, r, s, i0, p0, mc, kc, ni, nj;
+
+    Ap = amat(MM_MC, MM_KC);
+    Bp = amat(nb, MM_KC);
+
+    for (p0 = 0; p0 < m; p0 += MM_KC)
+    {
+        kc = m - p0 < MM_KC ? m - p0 : MM_KC;
+        mmpackb(tb, B, ldb, k, p0, kc, nr, Bp);
+
+        for (i0 = 0; i0 < n; i0 += MM_MC)
+        {
+            mc = n - i0 < MM_MC ? n - i0 : MM_MC;
+            mmpacka(ta, A, lda, i0, mc, p0, kc, mr, Ap);
+
+            for (j = 0; j < k; j += nr)
             {
-            case 1:
-                for (x = 0; x < m; x++)
-                    d += A[i + x * n] * B[x + j * m];
-                break; // NN
-            case 2:
-                for (x = 0; x < m; x++)
-                    d += A[i + x * n] * B[j + x * k];
-                break; // NT
-            case 3:
-                for (x = 0; x < m; x++)
-                    d += A[x + i * m] * B[x + j * m];
-                break; // TN
-            case 4:
-                for (x = 0; x < m; x++)
-                    d += A[x + i * m] * B[j + x * k];
-                break; // TT
+                nj = k - j < nr ? k - j : nr;
+                for (i = 0; i < mc; i += mr)
+                {
+                    ni = mc - i < mr ? mc - i : mr;
+                    kn->kern(kc, Ap + i * kc, Bp + j * kc, tile);
+
+                    for (s = 0; s < nj; s++)
+                    {
+                        c = C + i0 + i + (j + s) * ldc;
+                        for (r = 0; r < ni; r++)
+                            c[r] += alpha * tile[r + s * mr];
+                    }
+                }
             }
+        }
+    }
+    arenarelease(mk);
+}
+/* multiply matrix with leading dimensions -----------------------------------*/
+static void matmulld(const char *tr, int n, int k, int m, double alpha, const double *A, int lda, const double *B,
+                     int ldb, double beta, double *C, int ldc)
+{
+    double d, *c;
+    int i, j, x, ta = tr[0] == 'T', tb = tr[1] == 'T'; // N:normal T:transpose
+    int ai = ta ? lda : 1, ax = ta ? 1 : lda, bx = tb ? ldb : 1, bj = tb ? 1 : ldb; /* strides of op(A),op(B) */
+
+    if (n >= 8 && k >= 4 && m >= 4 && (double)n * k * m >= MM_MINOPS)
+    {
+        for (j = 0; j < k && beta != 1.0; j++)
+        {
+            c = C + j * ldc;
+            for (i = 0; i < n; i++)
+                c[i] = beta == 0.0 ? 0.0 : beta * c[i];
+        }
+        matmul_blk(mmkernel(), ta, tb, n, k, m, alpha, A, lda, B, ldb, C, ldc);
+        return;
+    }
+    for (j = 0; j < k; j++)
+        for (i = 0; i < n; i++)
+        {
+            d = 0.0;
+            for (x = 0; x < m; x++)
+                d += A[i * ai + x * ax] * B[x * bx + j * bj];
             if (beta == 0.0)
-                C[i + j * n] = alpha * d;
+                C[i + j * ldc] = alpha * d;
             else
-                C[i + j * n] = alpha * d + beta * C[i + j * n];
+                C[i + j * ldc] = alpha * d + beta * C[i + j * ldc];
         }
 }
+extern void matmul(const char *tr, int n, int k, int m, double alpha, const double *A, const double *B, double beta,
+                   double *C)
+{
+    matmulld(tr, n, k, m, alpha, A, tr[0] == 'T' ? m : n, B, tr[1] == 'T' ? k : m, beta, C, n);
+}
+#endif /* BLAS */
 /* LU decomposition ----------------------------------------------------------*/
 static int ludcmp(double *A, int n, int *indx, double *d)
 {
-    double big, s, tmp, *vv = mat(n, 1);
+    void *mk = arenamark();
+    double big, s, tmp, *vv = amat(n, 1);
     int i, imax = 0, j, k;
 
     *d = 1.0;
@@ -1561,7 +2042,7 @@ static int ludcmp(double *A, int n, int *indx, double *d)
             vv[i] = 1.0 / big;
         else
         {
-            free(vv);
+            arenarelease(mk);
             return -1;
         }
     }
@@ -1601,7 +2082,7 @@ static int ludcmp(double *A, int n, int *indx, double *d)
         indx[j] = imax;
         if (A[j + j * n] == 0.0)
         {
-            free(vv);
+            arenarelease(mk);
             return -1;
         }
         if (j != n - 1)
@@ -1611,7 +2092,7 @@ static int ludcmp(double *A, int n, int *indx, double *d)
                 A[i + j * n] *= tmp;
         }
     }
-    free(vv);
+    arenarelease(mk);
     return 0;
 }
 /* LU back-substitution ------------------------------------------------------*/
@@ -1643,16 +2124,16 @@ static void lubksb(const double *A, int n, const int *indx, double *b)
 /* inverse of matrix ---------------------------------------------------------*/
 extern int matinv(double *A, int n)
 {
+    void *mk = arenamark();
     double d, *B;
     int i, j, *indx;
 
-    indx = imat(n, 1);
-    B = mat(n, n);
+    indx = aimat(n, 1);
+    B = amat(n, n);
     matcpy(B, A, n, n);
     if (ludcmp(B, n, indx, &d))
     {
-        free(indx);
-        free(B);
+        arenarelease(mk);
         return -1;
     }
     for (j = 0; j < n; j++)
@@ -1662,25 +2143,57 @@ extern int matinv(double *A, int n)
         A[j + j * n] = 1.0;
         lubksb(B, n, indx, A + j * n);
     }
-    free(indx);
-    free(B);
+    arenarelease(mk);
     return 0;
 }
 /* solve linear equation -----------------------------------------------------*/
 extern int solve(const char *tr, const double *A, const double *Y, int n, int m, double *X)
 {
-    double *B = mat(n, n);
+    void *mk = arenamark();
+    double *B = amat(n, n);
     int info;
 
     matcpy(B, A, n, n);
     if (!(info = matinv(B, n)))
         matmul(tr[0] == 'N' ? "NN" : "TN", n, m, n, 1.0, B, Y, 0.0, X);
-    free(B);
+    arenarelease(mk);
     return info;
 }
 #endif
 /* end of matrix routines ----------------------------------------------------*/
 
+/* multiply matrix with symmetric product --------------------------------------
+ * multiply matrix by matrix (C=alpha*A*B+beta*C) for symmetric A*B and C
+ * args   : char   *tr       I  transpose flags ("N":normal,"T":transpose)
+ *          int    n,m       I  size of (transposed) matrix A,B
+ *          double alpha     I  alpha
+ *          double *A,*B     I  (transposed) matrix A (n x m), B (m x n)
+ *          double beta      I  beta
+ *          double *C        IO symmetric matrix C (n x n)
+ * return : none
+ * notes  : only the upper triangle of C is computed by column blocks and the
+ *          lower triangle is copied from it (about half of flops of matmul())
+ *          ex. C=A*A' (syrk) or C=(A*P)*A' for symmetric P (symm)
+ *-----------------------------------------------------------------------------*/
+extern void symmul(const char *tr, int n, int m, double alpha, const double *A, const double *B, double beta,
+                   double *C)
+{
+    int i, j, j0, nb, lda = tr[0] == 'T' ? m : n, ldb = tr[1] == 'T' ? n : m;
+
+    for (j0 = 0; j0 < n; j0 += SYMNB)
+    {
+        nb = n - j0 < SYMNB ? n - j0 : SYMNB;
+
+        /* C(0:j0+nb,j0:j0+nb)=alpha*op(A)(0:j0+nb,:)*op(B)(:,j0:j0+nb)+beta*C */
+        matmulld(tr, j0 + nb, nb, m, alpha, A, lda, tr[1] == 'T' ? B + j0 : B + j0 * ldb, ldb, beta, C + j0 * n, n);
+    }
+    for (j = 0; j < n; j++)
+        for (i = j + 1; i < n; i++)
+        {
+            C[i + j * n] = C[j + i * n];
+        }
+}
+
 /* least square estimation -----------------------------------------------------
  * least square estimation by solving normal equation (x=(A*A')^-1*A*y)
  * args   : double *A        I   transpose of (weighted) design matrix (n x m)
@@ -1694,19 +2207,129 @@ extern int solve(const char *tr, const double *A, const double *Y, int n, int m,
  *-----------------------------------------------------------------------------*/
 extern int lsq(const double *A, const double *y, int n, int m, double *x, double *Q)
 {
+    void *mk = arenamark();
     double *Ay;
     int info;
 
     if (m < n)
         return -1;
-    Ay = mat(n, 1);
+    Ay = amat(n, 1);
     matmul("NN", n, 1, m, 1.0, A, y, 0.0, Ay); /* Ay=A*y */
-    matmul("NT", n, n, m, 1.0, A, A, 0.0, Q);  /* Q=A*A' */
+    symmul("NT", n, m, 1.0, A, A, 0.0, Q);     /* Q=A*A' */
     if (!(info = matinv(Q, n)))
         matmul("NN", n, 1, n, 1.0, Q, Ay, 0.0, x); /* x=Q^-1*Ay */
-    free(Ay);
+    arenarelease(mk);
     return info;
 }
+/* clear sparse matrix ---------------------------------------------------------
+ * clear sparse matrix in compressed sparse row format. rows are appended by
+ * spadd() and sprow()
+ * args   : spmat_t *A       IO  sparse matrix
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void spclear(spmat_t *A)
+{
+    if (!A->rp)
+    {
+        A->mmax = 64;
+        if (!(A->rp = (int *)malloc(sizeof(int) * (A->mmax + 1))))
+            fatalerr("sparse matrix memory allocation error: m=%d\n", A->mmax);
+    }
+    A->m = A->nnz = 0;
+    A->rp[0] = 0;
+}
+/* add element to sparse matrix ------------------------------------------------
+ * add non-zero element to the row under construction of sparse matrix
+ * args   : spmat_t *A       IO  sparse matrix
+ *          int    j         I   column index
+ *          double a         I   value of element
+ * return : none
+ * notes  : the row is completed by sprow() or discarded by spdrop()
+ *-----------------------------------------------------------------------------*/
+extern void spadd(spmat_t *A, int j, double a)
+{
+    int *ci;
+    double *val;
+
+    if (A->nnz >= A->nzmax)
+    {
+        A->nzmax = A->nzmax <= 0 ? 256 : A->nzmax * 2;
+        if (!(ci = (int *)realloc(A->ci, sizeof(int) * A->nzmax)) ||
+            !(val = (double *)realloc(A->val, sizeof(double) * A->nzmax)))
+        {
+            fatalerr("sparse matrix memory allocation error: nnz=%d\n", A->nzmax);
+        }
+        A->ci = ci;
+        A->val = val;
+    }
+    A->ci[A->nnz] = j;
+    A->val[A->nnz++] = a;
+}
+/* complete row of sparse matrix -----------------------------------------------
+ * complete the row under construction and start a new row
+ * args   : spmat_t *A       IO  sparse matrix
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void sprow(spmat_t *A)
+{
+    int *rp;
+
+    if (A->m + 1 >= A->mmax)
+    {
+        A->mmax *= 2;
+        if (!(rp = (int *)realloc(A->rp, sizeof(int) * (A->mmax + 1))))
+            fatalerr("sparse matrix memory allocation error: m=%d\n", A->mmax);
+        A->rp = rp;
+    }
+    A->rp[++A->m] = A->nnz;
+}
+/* discard row of sparse matrix ------------------------------------------------
+ * discard elements of the row under construction
+ * args   : spmat_t *A       IO  sparse matrix
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void spdrop(spmat_t *A)
+{
+    A->nnz = A->rp[A->m];
+}
+/* select rows of sparse matrix ------------------------------------------------
+ * keep rows with non-zero flag and remove others
+ * args   : spmat_t *A       IO  sparse matrix
+ *          int    *flag     I   keep flag of rows (A->m x 1)
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void spkeep(spmat_t *A, const int *flag)
+{
+    int i, l, m = 0, nnz = 0;
+
+    for (i = 0; i < A->m; i++)
+    {
+        if (!flag[i])
+            continue;
+        for (l = A->rp[i]; l < A->rp[i + 1]; l++, nnz++)
+        {
+            A->ci[nnz] = A->ci[l];
+            A->val[nnz] = A->val[l];
+        }
+        A->rp[++m] = nnz;
+    }
+    A->m = m;
+    A->nnz = nnz;
+}
+/* free sparse matrix ----------------------------------------------------------
+ * free memory of sparse matrix
+ * args   : spmat_t *A       IO  sparse matrix
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void spfree(spmat_t *A)
+{
+    free(A->rp);
+    free(A->ci);
+    free(A->val);
+    A->rp = A->ci = NULL;
+    A->val = NULL;
+    A->m = A->nnz = A->mmax = A->nzmax = 0;
+}
 /* kalman filter ---------------------------------------------------------------
  * kalman filter state update as follows:
  *
@@ -1723,12 +2346,15 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x, double
  * return : status (0:ok,<0:error)
  * notes  : matirix stored by column-major order (fortran convention)
  *          if state x[i]==0.0, not updates state x[i]/P[i+i*n]
+ *          if R is diagonal, measurements are processed sequentially (see
+ *          filterd())
  *-----------------------------------------------------------------------------*/
 static int filter_(const double *x, const double *P, const double *H, const double *v, const double *R, int n, int m,
                    double *xp, double *Pp)
 {
-    double *F = mat(n, m), *Q = mat(m, m), *K = mat(n, m), *I = eye(n), *P1 = mat(n, n), *P2 = mat(n, n),
-           *R1 = mat(n, m);
+    void *mk = arenamark();
+    double *F = amat(n, m), *Q = amat(m, m), *K = amat(n, m), *I = aeye(n), *P1 = amat(n, n), *P2 = amat(n, n),
+           *R1 = amat(n, m);
     int info;
 
     matcpy(Q, R, m, m);
@@ -1741,39 +2367,317 @@ static int filter_(const double *x, const double *P, const double *H, const doub
         matmul("NN", n, 1, m, 1.0, K, v, 1.0, xp);                 /* xp=x+K*v */
         matmul("NT", n, n, m, -1.0, K, H, 1.0, I);                 /* Pp=(I-K*H')*P */
         matmul("NN", n, n, n, 1.0, I, P, 0.0, P1);
-        matmul("NT", n, n, n, 1.0, P1, I, 0.0, P2); /* P2=(I-K*H')*P*(I-K*H')' */
+        symmul("NT", n, n, 1.0, P1, I, 0.0, P2);   /* P2=(I-K*H')*P*(I-K*H')' */
         matcpy(Pp, P2, n, n);
-        matmul("NN", n, m, m, 1.0, K, R, 0.0, R1);  /* R1=K*R */
-        matmul("NT", n, n, m, 1.0, R1, K, 1.0, Pp); /* Pp=P2+K*R*K'=(I-K*H')*P*(I-K*H')'+K*R*K' */
+        matmul("NN", n, m, m, 1.0, K, R, 0.0, R1); /* R1=K*R */
+        symmul("NT", n, m, 1.0, R1, K, 1.0, Pp);   /* Pp=P2+K*R*K'=(I-K*H')*P*(I-K*H')'+K*R*K' */
     }
     else
     {
         trace(1, "Q���������\n");
     }
-    free(F);
-    free(Q);
-    free(K);
-    free(I);
-    free(P1);
-    free(P2);
-    free(R1);
+    arenarelease(mk);
+    return info;
+}
+/* IGG-III weight factor of standardized innovation ----------------------------
+ * args   : double y         I   innovation
+ *          double s         I   variance of innovation
+ *          double *k        I   thresholds of standardized innovation {k0,k1}
+ * return : weight factor (1:normal,0-1:downweighted,0:rejected)
+ *----------------------------------------------------------------------------*/
+static double iggwgt(double y, double s, const double *k)
+{
+    double t = fabs(y) / sqrt(s), a;
+
+    if (t <= k[0])
+        return 1.0;
+    if (t > k[1])
+        return 0.0;
+    a = (k[1] - t) / (k[1] - k[0]);
+    return k[0] / t * a * a;
+}
+/* sequential kalman filter for uncorrelated measurements --------------------
+ * P is symmetric and packed by upper triangle (P(i,j)=P[SYMIX(i,j)]). H is
+ * sparse with column index of compressed states. if rob!=NULL, variance of
+ * each measurement with rf[j]!=0 (all if rf==NULL) is inflated by IGG-III
+ * weight w[j] of standardized innovation and measurement with w[j]=0 is
+ * skipped
+ *----------------------------------------------------------------------------*/
+static int filterseq_(double *x, double *P, const spmat_t *H, const double *v, const double *r, int n, int m,
+                      const double *rob, const int *rf, double *w, double *F, double *dx)
+{
+    double *Pl, s, y, g, a;
+    int i, j, l, c, info = 0;
+
+    for (i = 0; i < n; i++)
+        dx[i] = 0.0;
+    for (j = 0; j < m; j++)
+    {
+        if (H->rp[j + 1] <= H->rp[j])
+            continue;
+
+        /* f=P*h, s=h'*P*h+r, y=v-h'*dx */
+        for (i = 0; i < n; i++)
+            F[i] = 0.0;
+        s = r[j];
+        y = v[j];
+        for (l = H->rp[j]; l < H->rp[j + 1]; l++)
+        {
+            c = H->ci[l];
+            a = H->val[l];
+            Pl = P + c * (c + 1) / 2;
+            for (i = 0; i <= c; i++)
+                F[i] += Pl[i] * a;
+            for (; i < n; i++)
+                F[i] += P[c + i * (i + 1) / 2] * a;
+        }
+        for (l = H->rp[j]; l < H->rp[j + 1]; l++)
+        {
+            s += H->val[l] * F[H->ci[l]];
+            y -= H->val[l] * dx[H->ci[l]];
+        }
+        if (s <= 0.0)
+        {
+            info = -1;
+            break;
+        }
+        /* robust reweighting: s=h'*P*h+r/w */
+        if (rob && (!rf || rf[j]))
+        {
+            if ((w[j] = iggwgt(y, s, rob)) <= 0.0)
+                continue;
+            s += r[j] * (1.0 / w[j] - 1.0);
+        }
+        /* x=x+f/s*y, P=P-f*f'/s (upper triangle) */
+        for (i = 0; i < n; i++)
+        {
+            g = F[i] / s * y;
+            x[i] += g;
+            dx[i] += g;
+        }
+        for (l = 0; l < n; l++)
+        {
+            Pl = P + l * (l + 1) / 2;
+            g = F[l] / s;
+            for (i = 0; i <= l; i++)
+                Pl[i] -= F[i] * g;
+        }
+    }
+    return info;
+}
+/* kalman filter with sparse design matrix -----------------------------------
+ * same as filter_() except that H is sparse with column index of compressed
+ * states (m rows)
+ *----------------------------------------------------------------------------*/
+static int filtersp_(const double *x, const double *P, const spmat_t *H, const double *v, const double *R, int n,
+                     int m, double *xp, double *Pp)
+{
+    void *mk = arenamark();
+    double *F = azeros(n, m), *Q = amat(m, m), *K = amat(n, m), *I = aeye(n), *P1 = amat(n, n), *P2 = amat(n, n),
+           *R1 = amat(n, m), *Fj, *Kj, *Ic, a;
+    const double *Pc;
+    int i, j, k, l, c, info;
+
+    matcpy(Q, R, m, m);
+    matcpy(xp, x, n, 1);
+
+    /* F=P*H, Q=H'*P*H+R */
+    for (j = 0; j < m; j++)
+    {
+        for (Fj = F + j * n, l = H->rp[j]; l < H->rp[j + 1]; l++)
+        {
+            for (Pc = P + H->ci[l] * n, a = H->val[l], i = 0; i < n; i++)
+                Fj[i] += Pc[i] * a;
+        }
+    }
+    for (j = 0; j < m; j++)
+        for (i = 0; i < m; i++)
+        {
+            for (Fj = F + j * n, l = H->rp[i]; l < H->rp[i + 1]; l++)
+                Q[i + j * m] += H->val[l] * Fj[H->ci[l]];
+        }
+    if (!(info = matinv(Q, m)))
+    {
+        matmul("NN", n, m, m, 1.0, F, Q, 0.0, K); /* K=P*H*Q^-1 */
+        matmul("NN", n, 1, m, 1.0, K, v, 1.0, xp); /* xp=x+K*v */
+
+        /* I=I-K*H' */
+        for (j = 0; j < m; j++)
+        {
+            for (Kj = K + j * n, l = H->rp[j]; l < H->rp[j + 1]; l++)
+            {
+                c = H->ci[l];
+                a = H->val[l];
+                for (Ic = I + c * n, k = 0; k < n; k++)
+                    Ic[k] -= Kj[k] * a;
+            }
+        }
+        matmul("NN", n, n, n, 1.0, I, P, 0.0, P1);
+        symmul("NT", n, n, 1.0, P1, I, 0.0, P2); /* P2=(I-K*H')*P*(I-K*H')' */
+        matcpy(Pp, P2, n, n);
+        matmul("NN", n, m, m, 1.0, K, R, 0.0, R1); /* R1=K*R */
+        symmul("NT", n, m, 1.0, R1, K, 1.0, Pp);   /* Pp=P2+K*R*K' */
+    }
+    arenarelease(mk);
+    return info;
+}
+/* resize kalman filter workspace --------------------------------------------*/
+static void resizews(filtws_t *ws, int k, int n)
+{
+    if (k > ws->nmax)
+    {
+        free(ws->x);
+        free(ws->P);
+        free(ws->F);
+        free(ws->dx);
+        free(ws->x0);
+        free(ws->P0);
+        ws->nmax = k + k / 2;
+        ws->x = mat(ws->nmax, 1);
+        ws->P = mat(ws->nmax * (ws->nmax + 1) / 2, 1);
+        ws->x0 = mat(ws->nmax, 1);
+        ws->P0 = mat(ws->nmax * (ws->nmax + 1) / 2, 1);
+        ws->F = mat(ws->nmax, 1);
+        ws->dx = mat(ws->nmax, 1);
+    }
+    if (n > ws->nxmax)
+    {
+        free(ws->jx);
+        ws->nxmax = n;
+        ws->jx = imat(n, 1);
+    }
+    spclear(&ws->H);
+}
+/* free kalman filter workspace ------------------------------------------------
+ * free work buffers of kalman filter workspace
+ * args   : filtws_t *ws     IO  kalman filter workspace
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void freefiltws(filtws_t *ws)
+{
+    free(ws->x);
+    free(ws->P);
+    free(ws->F);
+    free(ws->dx);
+    free(ws->x0);
+    free(ws->P0);
+    free(ws->w);
+    free(ws->jx);
+    spfree(&ws->H);
+    ws->x = ws->P = ws->F = ws->dx = ws->x0 = ws->P0 = ws->w = NULL;
+    ws->jx = NULL;
+    ws->ix = NULL;
+    ws->nmax = ws->nxmax = ws->mmax = ws->k = 0;
+}
+/* test diagonal matrix ------------------------------------------------------*/
+static int isdiag(const double *R, int m)
+{
+    int i, j;
+
+    for (j = 0; j < m; j++)
+        for (i = 0; i < m; i++)
+        {
+            if (i != j && R[i + j * m] != 0.0)
+                return 0;
+        }
+    return 1;
+}
+/* compress sparse design matrix to active states ---------------------------*/
+static void spcompress(const spmat_t *H, int m, int n, const int *ix, int k, int *jx, spmat_t *H_)
+{
+    int i, j, l;
+
+    for (i = 0; i < n; i++)
+        jx[i] = -1;
+    for (i = 0; i < k; i++)
+        jx[ix[i]] = i;
+    spclear(H_);
+    for (j = 0; j < m; j++)
+    {
+        for (l = H->rp[j]; l < H->rp[j + 1]; l++)
+            if (jx[H->ci[l]] >= 0 && H->val[l] != 0.0)
+                spadd(H_, jx[H->ci[l]], H->val[l]);
+        sprow(H_);
+    }
+}
+/* gather active states to compressed and packed arrays ---------------------*/
+static void gatherx(const double *x, const double *P, int n, const int *ix, int k, double *x_, double *P_)
+{
+    const double *Pj;
+    int i, j;
+
+    for (j = 0; j < k; j++)
+    {
+        x_[j] = x[ix[j]];
+        for (Pj = P + ix[j] * n, i = 0; i <= j; i++)
+            *P_++ = Pj[ix[i]];
+    }
+}
+/* measurement update on workspace -------------------------------------------*/
+static int updatews_(const double *v, const double *r, int m, int k, const double *rob, const int *rf, filtws_t *ws)
+{
+    int i;
+
+    if (rob)
+    {
+        if (m > ws->mmax)
+        {
+            free(ws->w);
+            ws->mmax = m + m / 2;
+            ws->w = mat(ws->mmax, 1);
+        }
+        for (i = 0; i < m; i++)
+            ws->w[i] = 1.0;
+    }
+    return filterseq_(ws->x, ws->P, &ws->H, v, r, k, m, rob, rf, ws->w, ws->F, ws->dx);
+}
+/* sequential kalman filter on workspace ---------------------------------------*/
+static int filterws_(double *x, double *P, const double *v, const double *r, int n, int m, const int *ix, int k,
+                     filtws_t *ws)
+{
+    double *P_;
+    int i, j, info;
+
+    gatherx(x, P, n, ix, k, ws->x, ws->P);
+
+    /* sequential state update on compressed and packed arrays */
+    if (!(info = updatews_(v, r, m, k, NULL, NULL, ws)))
+    {
+        for (P_ = ws->P, j = 0; j < k; j++)
+        {
+            x[ix[j]] = ws->x[j];
+            for (i = 0; i <= j; i++, P_++)
+                P[ix[i] + ix[j] * n] = P[ix[j] + ix[i] * n] = *P_;
+        }
+    }
     return info;
 }
 extern int filter(double *x, double *P, const double *H, const double *v, const double *R, int n, int m)
 {
-    double *x_, *xp_, *P_, *Pp_, *H_;
+    void *mk = arenamark();
+    double *x_, *xp_, *P_, *Pp_, *H_, *r;
     int i, j, k, info, *ix;
 
+    /* uncorrelated measurements by sequential update */
+    if (isdiag(R, m))
+    {
+        r = amat(m, 1);
+        for (i = 0; i < m; i++)
+            r[i] = R[i + i * m];
+        info = filterd(x, P, H, v, r, n, m);
+        arenarelease(mk);
+        return info;
+    }
     /* create list of non-zero states */
-    ix = imat(n, 1);
+    ix = aimat(n, 1);
     for (i = k = 0; i < n; i++)
         if (x[i] != 0.0 && P[i + i * n] > 0.0)
             ix[k++] = i;
-    x_ = mat(k, 1);
-    xp_ = mat(k, 1);
-    P_ = mat(k, k);
-    Pp_ = mat(k, k);
-    H_ = mat(k, m);
+    x_ = amat(k, 1);
+    xp_ = amat(k, 1);
+    P_ = amat(k, k);
+    Pp_ = amat(k, k);
+    H_ = amat(k, m);
     /* compress array by removing zero elements to save computation time */
     for (i = 0; i < k; i++)
     {
@@ -1792,14 +2696,240 @@ extern int filter(double *x, double *P, const double *H, const double *v, const
         for (j = 0; j < k; j++)
             P[ix[i] + ix[j] * n] = Pp_[i + j * k];
     }
-    free(ix);
-    free(x_);
-    free(xp_);
-    free(P_);
-    free(Pp_);
-    free(H_);
+    arenarelease(mk);
+    return info;
+}
+/* kalman filter with diagonal measurement covariance --------------------------
+ * kalman filter state update for uncorrelated measurements. measurements are
+ * processed one by one by rank-1 updates without inverse of innovation
+ * covariance:
+ *
+ *   f=P*h, s=h'*f+r, K=f/s, x=x+K*(v-h'*dx), P=P-K*f'
+ *
+ * args   : double *x        IO  states vector (n x 1)
+ *          double *P        IO  covariance matrix of states (n x n)
+ *          double *H        I   transpose of design matrix (n x m)
+ *          double *v        I   innovation (measurement - model) (m x 1)
+ *          double *r        I   variance of measurement error (m x 1)
+ *          int    n,m       I   number of states and measurements
+ * return : status (0:ok,<0:error)
+ * notes  : equivalent to filter() with R=diag(r). dx is the correction of
+ *          states by the preceding measurements
+ *          covariance of active states is processed in packed upper triangle
+ *          if state x[i]==0.0, not updates state x[i]/P[i+i*n]
+ *          states are not updated on error
+ *-----------------------------------------------------------------------------*/
+extern int filterd(double *x, double *P, const double *H, const double *v, const double *r, int n, int m)
+{
+    void *mk = arenamark();
+    filtws_t ws = {0};
+    int i, k, info, *ix;
+
+    /* create list of non-zero states */
+    ix = aimat(n, 1);
+    for (i = k = 0; i < n; i++)
+        if (x[i] != 0.0 && P[i + i * n] > 0.0)
+            ix[k++] = i;
+    info = filterix(x, P, H, v, r, n, m, ix, k, &ws);
+    freefiltws(&ws);
+    arenarelease(mk);
     return info;
 }
+/* kalman filter on given active states ----------------------------------------
+ * kalman filter state update for uncorrelated measurements on the states
+ * listed in ix with persistent work buffers
+ * args   : double *x        IO  states vector (n x 1)
+ *          double *P        IO  covariance matrix of states (n x n)
+ *          double *H        I   transpose of design matrix (n x m)
+ *          double *v        I   innovation (measurement - model) (m x 1)
+ *          double *r        I   variance of measurement error (m x 1)
+ *          int    n,m       I   number of states and measurements
+ *          int    *ix       I   index of active states (k x 1)
+ *          int    k         I   number of active states
+ *          filtws_t *ws     IO  kalman filter workspace
+ * return : status (0:ok,<0:error)
+ * notes  : same as filterd() except that states not listed in ix are not
+ *          updated. work buffers in ws are reallocated only if they are
+ *          smaller than required and should be freed by freefiltws()
+ *-----------------------------------------------------------------------------*/
+extern int filterix(double *x, double *P, const double *H, const double *v, const double *r, int n, int m,
+                    const int *ix, int k, filtws_t *ws)
+{
+    const double *Hj;
+    int i, j;
+
+    resizews(ws, k, 0);
+    for (j = 0; j < m; j++)
+    {
+        for (Hj = H + j * n, i = 0; i < k; i++)
+            if (Hj[ix[i]] != 0.0)
+                spadd(&ws->H, i, Hj[ix[i]]);
+        sprow(&ws->H);
+    }
+    return filterws_(x, P, v, r, n, m, ix, k, ws);
+}
+/* kalman filter with sparse design matrix on given active states --------------
+ * kalman filter state update for uncorrelated measurements with sparse design
+ * matrix on the states listed in ix
+ * args   : double *x        IO  states vector (n x 1)
+ *          double *P        IO  covariance matrix of states (n x n)
+ *          spmat_t *H       I   design matrix (m rows, column index of states)
+ *          double *v        I   innovation (measurement - model) (m x 1)
+ *          double *r        I   variance of measurement error (m x 1)
+ *          int    n,m       I   number of states and measurements
+ *          int    *ix       I   index of active states (k x 1)
+ *          int    k         I   number of active states
+ *          filtws_t *ws     IO  kalman filter workspace
+ * return : status (0:ok,<0:error)
+ * notes  : same as filterix() except for sparse design matrix. elements of H
+ *          for states not listed in ix are ignored
+ *-----------------------------------------------------------------------------*/
+extern int filterspix(double *x, double *P, const spmat_t *H, const double *v, const double *r, int n, int m,
+                      const int *ix, int k, filtws_t *ws)
+{
+    resizews(ws, k, n);
+    spcompress(H, m, n, ix, k, ws->jx, &ws->H);
+    return filterws_(x, P, v, r, n, m, ix, k, ws);
+}
+/* kalman filter with sparse design matrix -------------------------------------
+ * kalman filter state update with sparse design matrix
+ * args   : double *x        IO  states vector (n x 1)
+ *          double *P        IO  covariance matrix of states (n x n)
+ *          spmat_t *H       I   design matrix (m rows, column index of states)
+ *          double *v        I   innovation (measurement - model) (m x 1)
+ *          double *R        I   covariance matrix of measurement error (m x m)
+ *          int    n,m       I   number of states and measurements
+ * return : status (0:ok,<0:error)
+ * notes  : same as filter() except for sparse design matrix
+ *-----------------------------------------------------------------------------*/
+extern int filtersp(double *x, double *P, const spmat_t *H, const double *v, const double *R, int n, int m)
+{
+    void *mk = arenamark();
+    filtws_t ws = {0};
+    double *x_, *xp_, *P_, *Pp_, *r;
+    int i, j, k, info, *ix;
+
+    /* create list of non-zero states */
+    ix = aimat(n, 1);
+    for (i = k = 0; i < n; i++)
+        if (x[i] != 0.0 && P[i + i * n] > 0.0)
+            ix[k++] = i;
+
+    /* uncorrelated measurements by sequential update */
+    if (isdiag(R, m))
+    {
+        r = amat(m, 1);
+        for (i = 0; i < m; i++)
+            r[i] = R[i + i * m];
+        info = filterspix(x, P, H, v, r, n, m, ix, k, &ws);
+        freefiltws(&ws);
+        arenarelease(mk);
+        return info;
+    }
+    x_ = amat(k, 1);
+    xp_ = amat(k, 1);
+    P_ = amat(k, k);
+    Pp_ = amat(k, k);
+    ws.jx = imat(n, 1);
+    spcompress(H, m, n, ix, k, ws.jx, &ws.H);
+    for (i = 0; i < k; i++)
+    {
+        x_[i] = x[ix[i]];
+        for (j = 0; j < k; j++)
+            P_[i + j * k] = P[ix[i] + ix[j] * n];
+    }
+    /* do kalman filter state update on compressed arrays */
+    if (!(info = filtersp_(x_, P_, &ws.H, v, R, k, m, xp_, Pp_)))
+    {
+        for (i = 0; i < k; i++)
+        {
+            x[ix[i]] = xp_[i];
+            for (j = 0; j < k; j++)
+                P[ix[i] + ix[j] * n] = Pp_[i + j * k];
+        }
+    }
+    freefiltws(&ws);
+    arenarelease(mk);
+    return info;
+}
+/* start kalman filter iterations ----------------------------------------------
+ * save compressed and packed snapshot of active states for measurement updates
+ * by filterstep()
+ * args   : double *x        I   states vector (n x 1)
+ *          double *P        I   covariance matrix of states (n x n)
+ *          int    n         I   number of states
+ *          int    *ix       I   index of active states (k x 1)
+ *          int    k         I   number of active states
+ *          filtws_t *ws     IO  kalman filter workspace
+ * return : none
+ * notes  : ix should be kept until filtercommit()
+ *-----------------------------------------------------------------------------*/
+extern void filterbegin(const double *x, const double *P, int n, const int *ix, int k, filtws_t *ws)
+{
+    resizews(ws, k, n);
+    gatherx(x, P, n, ix, k, ws->x0, ws->P0);
+    ws->ix = ix;
+    ws->k = k;
+}
+/* kalman filter iteration -----------------------------------------------------
+ * kalman filter state update for uncorrelated measurements from the snapshot
+ * saved by filterbegin()
+ * args   : double *x        IO  states vector (n x 1)
+ *          spmat_t *H       I   design matrix (m rows, column index of states)
+ *          double *v        I   innovation (measurement - model) (m x 1)
+ *          double *r        I   variance of measurement error (m x 1)
+ *          int    *rf       I   robust reweighting flags (m x 1) (NULL: all)
+ *          int    n,m       I   number of states and measurements
+ *          filtws_t *ws     IO  kalman filter workspace
+ * return : status (0:ok,<0:error)
+ * notes  : only active states of x are updated. updated covariance is kept in
+ *          the workspace and written by filtercommit(). each call restarts from
+ *          the snapshot, so a rejected iteration needs no restoration of P.
+ *          if ws->rob[0]>0, measurements with rf[i]!=0 are reweighted by
+ *          IGG-III scheme of standardized innovation {k0,k1}=ws->rob. others
+ *          (e.g. constraints) keep unit weight. weight factors are output to
+ *          ws->w (0:rejected) and counted in ws->nrob
+ *-----------------------------------------------------------------------------*/
+extern int filterstep(double *x, const spmat_t *H, const double *v, const double *r, const int *rf, int n, int m,
+                      filtws_t *ws)
+{
+    const double *rob = ws->rob[0] > 0.0 ? ws->rob : NULL;
+    int i, info, k = ws->k;
+
+    memcpy(ws->x, ws->x0, sizeof(double) * k);
+    memcpy(ws->P, ws->P0, sizeof(double) * k * (k + 1) / 2);
+    spcompress(H, m, n, ws->ix, k, ws->jx, &ws->H);
+
+    ws->nrob[0] = ws->nrob[1] = 0;
+    if (!(info = updatews_(v, r, m, k, rob, rf, ws)))
+    {
+        for (i = 0; i < k; i++)
+            x[ws->ix[i]] = ws->x[i];
+        for (i = 0; rob && i < m; i++)
+        {
+            if (ws->w[i] < 1.0)
+                ws->nrob[ws->w[i] <= 0.0 ? 1 : 0]++;
+        }
+    }
+    return info;
+}
+/* commit kalman filter iterations ---------------------------------------------
+ * write covariance of active states updated by the last filterstep()
+ * args   : double *P        IO  covariance matrix of states (n x n)
+ *          int    n         I   number of states
+ *          filtws_t *ws     IO  kalman filter workspace
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void filtercommit(double *P, int n, filtws_t *ws)
+{
+    const double *P_ = ws->P;
+    const int *ix = ws->ix;
+    int i, j, k = ws->k;
+
+    for (j = 0; j < k; j++)
+        for (i = 0; i <= j; i++, P_++)
+            P[ix[i] + ix[j] * n] = P[ix[j] + ix[i] * n] = *P_;
+}
 /* smoother --------------------------------------------------------------------
  * combine forward and backward filters by fixed-interval smoother as follows:
  *
@@ -1864,20 +2994,107 @@ extern void matprint(const double A[], int n, int m, int p, int q)
 {
     matfprint(A, n, m, p, q, stdout);
 }
+/* scan fixed-width number -----------------------------------------------------
+ * scan decimal number ("[+-]ddd.ddd[EeDd][+-]dd") in string s[0:n-1] without
+ * copy. the number is converted exactly as strtod() while the digits fit in a
+ * double and the power of 10 is exact (|exponent|<=22), otherwise NULL is
+ * returned for the caller to fall back to sscanf()
+ *-----------------------------------------------------------------------------*/
+static const char *scannum(const char *p, const char *e, double *val)
+{
+    static const double pow10[] = {1E0,  1E1,  1E2,  1E3,  1E4,  1E5,  1E6,  1E7,  1E8,  1E9,  1E10, 1E11,
+                                   1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18, 1E19, 1E20, 1E21, 1E22};
+    unsigned long long m = 0;
+    unsigned int d;
+    int neg = 0, nd = 0, nz = 0, exp = 0, eneg = 0, x = 0;
+
+    while (p < e && (*p == ' ' || (unsigned int)(*p - '\t') < 5u))
+        p++;
+    if (p < e && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+
+    for (; p < e && (d = (unsigned int)(*p - '0')) < 10u; p++, nz++)
+    {
+        if (m || d)
+            nd++;
+        m = m * 10u + d; /* overflow checked by nd */
+    }
+    if (p < e && *p == '.')
+    {
+        for (p++; p < e && (d = (unsigned int)(*p - '0')) < 10u; p++, nz++)
+        {
+            if (m || d)
+                nd++;
+            m = m * 10u + d;
+            exp--;
+        }
+    }
+    if (nz <= 0 || nd > MAXNUMDIG)
+        return NULL;
+
+    if (p < e && (*p == 'E' || *p == 'e' || *p == 'D' || *p == 'd'))
+    {
+        if (++p < e && (*p == '-' || *p == '+'))
+            eneg = *p++ == '-';
+        if (p >= e || (unsigned int)(*p - '0') >= 10u)
+            return NULL;
+        for (; p < e && (d = (unsigned int)(*p - '0')) < 10u; p++)
+        {
+            if (x < 10000)
+                x = x * 10 + (int)d;
+        }
+        exp += eneg ? -x : x;
+    }
+    /* number should be terminated by blank or end of field */
+    if (p < e && *p != ' ' && (unsigned int)(*p - '\t') >= 5u)
+        return NULL;
+
+    if (m == 0)
+        *val = 0.0;
+    else if (m > (1ull << 53) || exp < -22 || exp > 22)
+        return NULL;
+    else
+        *val = exp < 0 ? (double)m / pow10[-exp] : (double)m * pow10[exp];
+    if (neg)
+        *val = -*val;
+    return p;
+}
+/* end of substring ----------------------------------------------------------*/
+static const char *subend(const char *s, int n)
+{
+    const char *p = (const char *)memchr(s, '\0', (size_t)n);
+
+    return p ? p : s + n;
+}
 /* string to number ------------------------------------------------------------
  * convert substring in string to number
  * args   : char   *s        I   string ("... nnn.nnn ...")
  *          int    i,n       I   substring position and width
  * return : converted number (0.0:error)
+ * notes  : fixed-width fields are scanned in place by scannum(). the result is
+ *          identical to sscanf("%lf") of the substring ('D' as 'E'), which is
+ *          used for the other cases
  *-----------------------------------------------------------------------------*/
 extern double str2num(const char *s, int i, int n)
 {
     double value;
     char str[256], *p = str;
+    const char *e;
 
-    if (i < 0 || (int)strlen(s) < i || (int)sizeof(str) - 1 < n)
+    if (i < 0 || memchr(s, '\0', (size_t)i) || (int)sizeof(str) - 1 < n)
         return 0.0;
-    for (s += i; *s && --n >= 0; s++)
+    s += i;
+    if (n <= 0)
+        return 0.0;
+    e = subend(s, n);
+    while (s < e && (*s == ' ' || (unsigned int)(*s - '\t') < 5u))
+        s++;
+    if (s >= e)
+        return 0.0; /* blank field */
+    if (scannum(s, e, &value))
+        return value;
+
+    for (; s < e; s++)
         *p++ = *s == 'd' || *s == 'D' ? 'E' : *s;
     *p = '\0';
     return sscanf(str, "%lf", &value) == 1 ? value : 0.0;
@@ -1898,9 +3115,25 @@ extern int str2time(const char *s, int i, int n, gtime_t *t)
                         31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31,
                         31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
-    if (i < 0 || (int)strlen(s) < i || (int)sizeof(str) - 1 < i)
+    const char *q, *e;
+    int k;
+
+    if (i < 0 || memchr(s, '\0', (size_t)i) || (int)sizeof(str) - 1 < i)
         return -1;
-    for (s += i; *s && --n >= 0;)
+    s += i;
+
+    /* blank separated fields scanned in place */
+    e = n > 0 ? subend(s, n) : s;
+    for (k = 0, q = s; k < 6 && q && q < e; k++)
+        q = scannum(q, e, ep + k);
+    if (k == 6 && q)
+    {
+        if (ep[0] < 100.0)
+            ep[0] += ep[0] < 80.0 ? 2000.0 : 1900.0;
+        *t = epoch2time(ep);
+        return 0;
+    }
+    for (; *s && --n >= 0;)
         *p++ = *s++;
     *p = '\0';
     if (sscanf(str, "%lf %lf %lf %lf %lf %lf", ep, ep + 1, ep + 2, ep + 3, ep + 4, ep + 5) == 6 ||
@@ -2364,11 +3597,12 @@ extern void time2str(gtime_t t, char *s, int n)
  * args   : gtime_t t        I   gtime_t struct
  *          int    n         I   number of decimals
  * return : time string
- * notes  : not reentrant, do not use multiple in a function
+ * notes  : not reentrant, do not use multiple in a function (buffer is
+ *          thread-local)
  *-----------------------------------------------------------------------------*/
 extern char *time_str(gtime_t t, int n)
 {
-    static char buff[64];
+    static THREADLOCAL char buff[64];
     time2str(t, buff, n);
     return buff;
 }
@@ -2797,8 +4031,8 @@ static void nut_iau1980(double t, const double *f, double *dpsi, double *deps)
 extern void eci2ecef(gtime_t tutc, const double *erpv, double *U, double *gmst)
 {
     const double ep2000[] = {2000, 1, 1, 12, 0, 0};
-    static gtime_t tutc_;
-    static double U_[9], gmst_;
+    static THREADLOCAL gtime_t tutc_;
+    static THREADLOCAL double U_[9], gmst_;
     gtime_t tgps;
     double eps, ze, th, z, t, t2, t3, dpsi, deps, gast, f[5];
     double R1[9], R2[9], R3[9], R[9], W[9], N[9], P[9], NP[9];
@@ -3592,6 +4826,9 @@ extern void uniqnav(nav_t *nav)
     uniqeph(nav);
     uniqgeph(nav);
     uniqseph(nav);
+
+    /* per-satellite index of ephemeris */
+    ephindex(nav);
 }
 /* compare observation data -------------------------------------------------*/
 static int cmpobs(const void *p1, const void *p2)
@@ -3674,6 +4911,9 @@ extern int readnav(const char *file, nav_t *nav)
     if (!(fp = fopen(file, "r")))
         return 0;
 
+    /* ephemeris are overwritten in place */
+    nav->ie.n = nav->ig.n = 0;
+
     while (fgets(buff, sizeof(buff), fp))
     {
         if (!strncmp(buff, "IONUTC", 6))
@@ -3812,12 +5052,18 @@ extern void freenav(nav_t *nav, int opt)
         free(nav->eph);
         nav->eph = NULL;
         nav->n = nav->nmax = 0;
+        free(nav->ie.idx);
+        nav->ie.idx = NULL;
+        nav->ie.n = 0;
     }
     if (opt & 0x002)
     {
         free(nav->geph);
         nav->geph = NULL;
         nav->ng = nav->ngmax = 0;
+        free(nav->ig.idx);
+        nav->ig.idx = NULL;
+        nav->ig.n = 0;
     }
     if (opt & 0x004)
     {
@@ -3830,12 +5076,29 @@ extern void freenav(nav_t *nav, int opt)
         free(nav->peph);
         nav->peph = NULL;
         nav->ne = nav->nemax = 0;
+        free(nav->pe.time);
+        free(nav->pe.index);
+        free(nav->pe.pos);
+        free(nav->pe.std);
+        free(nav->pe.vel);
+        free(nav->pe.vst);
+        free(nav->pe.cov);
+        free(nav->pe.vco);
+        memset(&nav->pe, 0, sizeof(pephc_t));
+        free(nav->pf.seg);
+        nav->pf.seg = NULL;
+        nav->pf.ne = 0;
     }
     if (opt & 0x010)
     {
         free(nav->pclk);
         nav->pclk = NULL;
         nav->nc = nav->ncmax = 0;
+        free(nav->pc.time);
+        free(nav->pc.index);
+        free(nav->pc.clk);
+        free(nav->pc.std);
+        memset(&nav->pc, 0, sizeof(pclkc_t));
     }
     if (opt & 0x020)
     {
@@ -4063,41 +5326,50 @@ extern void tracehnav(int level, const nav_t *nav)
 }
 extern void tracepeph(int level, const nav_t *nav)
 {
+    const double *pos;
+    double std[4];
     char s[64], id[16];
-    int i, j;
+    int i, j, k, m;
 
     if (!fp_trace || level > level_trace)
         return;
 
-    for (i = 0; i < nav->ne; i++)
+    for (i = 0; i < nav->pe.ne; i++)
     {
-        time2str(nav->peph[i].time, s, 0);
+        time2str(nav->pe.time[i], s, 0);
         for (j = 0; j < MAXSAT; j++)
         {
+            if ((k = nav->pe.slot[j]) < 0)
+                continue;
+            pos = nav->pe.pos + ((size_t)k * nav->pe.ne + i) * 4;
+            for (m = 0; m < 4; m++)
+                std[m] = nav->pe.std ? nav->pe.std[((size_t)k * nav->pe.ne + i) * 4 + m] : 0.0;
             satno2id(j + 1, id);
             fprintf(fp_trace, "%-3s %d %-3s %13.3f %13.3f %13.3f %13.3f %6.3f %6.3f %6.3f %6.3f\n", s,
-                    nav->peph[i].index, id, nav->peph[i].pos[j][0], nav->peph[i].pos[j][1], nav->peph[i].pos[j][2],
-                    nav->peph[i].pos[j][3] * 1E9, nav->peph[i].std[j][0], nav->peph[i].std[j][1],
-                    nav->peph[i].std[j][2], nav->peph[i].std[j][3] * 1E9);
+                    nav->pe.index[i], id, pos[0], pos[1], pos[2], pos[3] * 1E9, std[0], std[1], std[2],
+                    std[3] * 1E9);
         }
     }
 }
 extern void tracepclk(int level, const nav_t *nav)
 {
     char s[64], id[16];
-    int i, j;
+    int i, j, k;
 
     if (!fp_trace || level > level_trace)
         return;
 
-    for (i = 0; i < nav->nc; i++)
+    for (i = 0; i < nav->pc.nc; i++)
     {
-        time2str(nav->pclk[i].time, s, 0);
+        time2str(nav->pc.time[i], s, 0);
         for (j = 0; j < MAXSAT; j++)
         {
+            if ((k = nav->pc.slot[j]) < 0)
+                continue;
             satno2id(j + 1, id);
-            fprintf(fp_trace, "%-3s %d %-3s %13.3f %6.3f\n", s, nav->pclk[i].index, id, nav->pclk[i].clk[j][0] * 1E9,
-                    nav->pclk[i].std[j][0] * 1E9);
+            fprintf(fp_trace, "%-3s %d %-3s %13.3f %6.3f\n", s, nav->pc.index[i], id,
+                    nav->pc.clk[(size_t)k * nav->pc.nc + i] * 1E9,
+                    (nav->pc.std ? nav->pc.std[(size_t)k * nav->pc.nc + i] : 0.0) * 1E9);
         }
     }
 }
@@ -4301,6 +5573,43 @@ extern void createdir(const char *path)
     mkdir(buff, 0777);
 #endif
 }
+/* file status -----------------------------------------------------------------
+ * get modified time and size of file (e.g. source file of cache)
+ * args   : char   *path     I   file path
+ *          int64_t *mtime   O   modified time (s since 1970/1/1)
+ *          int64_t *size    O   file size (bytes)
+ * return : status (1:ok,0:no file or wild-card in path)
+ *-----------------------------------------------------------------------------*/
+extern int filestat(const char *path, int64_t *mtime, int64_t *size)
+{
+    struct stat st;
+
+    if (strchr(path, '*') || stat(path, &st) != 0)
+        return 0;
+    *mtime = (int64_t)st.st_mtime;
+    *size = (int64_t)st.st_size;
+    return 1;
+}
+/* cache file path -------------------------------------------------------------
+ * generate cache file path <dir>/<file name of path><ext>
+ * args   : char   *dir      I   cache directory
+ *          char   *path     I   source file path
+ *          char   *ext      I   extension of cache file (e.g. ".cache")
+ *          char   *file     O   cache file path
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void cachepath(const char *dir, const char *path, const char *ext, char *file)
+{
+    const char *p, *q;
+
+    p = (q = strrchr(path, FILEPATHSEP)) ? q + 1 : path;
+    if ((q = strrchr(p, '/')))
+        p = q + 1;
+    if (dir[strlen(dir) - 1] == FILEPATHSEP || dir[strlen(dir) - 1] == '/')
+        sprintf(file, "%.511s%.255s%.15s", dir, p, ext);
+    else
+        sprintf(file, "%.511s%c%.255s%.15s", dir, FILEPATHSEP, p, ext);
+}
 /* replace string ------------------------------------------------------------*/
 static int repstr(char *str, const char *pat, const char *rep)
 {
@@ -4859,8 +6168,14 @@ extern void antmodel_s(const pcv_t *pcv, double nadir, double *dant)
     }
     trace(2, "antmodel_s: dant=%6.3f %6.3f\n", dant[0], dant[1]);
 }
-/* sun and moon position in eci (ref [4] 5.1.1, 5.2.1) -----------------------*/
-static void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
+/* sun and moon position in eci -----------------------------------------------
+ * get sun and moon position in eci without cache (ref [4] 5.1.1, 5.2.1)
+ * args   : gtime_t tut      I   time in ut1
+ *          double *rsun     IO  sun position in eci  (m) (NULL: not output)
+ *          double *rmoon    IO  moon position in eci (m) (NULL: not output)
+ * return : none
+ *-----------------------------------------------------------------------------*/
+extern void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
 {
     const double ep2000[] = {2000, 1, 1, 12, 0, 0};
     double t, f[5], eps, Ms, ls, rs, lm, pm, rm, sine, cose, sinp, cosp, sinl, cosl;
@@ -4911,6 +6226,15 @@ static void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
         trace(5, "rmoon=%.3f %.3f %.3f\n", rmoon[0], rmoon[1], rmoon[2]);
     }
 }
+typedef struct
+{                    /* sun and moon position cache type */
+    gtime_t tutc;    /* time of grid point in utc (0: empty) */
+    double erpv[3];  /* erp value {xp,yp,ut1_utc} */
+    double rsun[3];  /* sun position in ecef (m) */
+    double rmoon[3]; /* moon position in ecef (m) */
+    double gmst;     /* gmst (rad) */
+} sunmoon_t;
+
 /* sun and moon position -------------------------------------------------------
  * get sun and moon position in ecef
  * args   : gtime_t tut      I   time in ut1
@@ -4919,29 +6243,65 @@ static void sunmoonpos_eci(gtime_t tut, double *rsun, double *rmoon)
  *          double *rmoon    IO  moon position in ecef (m) (NULL: not output)
  *          double *gmst     O   gmst (rad)
  * return : none
+ * notes  : sun/moon position and gmst are computed at the nearest point of
+ *          a fixed time grid of SUNMOONGRID anchored at integer seconds and
+ *          kept in thread-local cache. the values at the grid point are rotated
+ *          by earth rotation to time (error < 1E-6 rad in sun and moon
+ *          direction), so sat_yaw(), satantoff(), testeclipse() and tidedisp()
+ *          of the same epoch compute them once and the result does not depend
+ *          on call order
  *-----------------------------------------------------------------------------*/
 extern void sunmoonpos(gtime_t tutc, const double *erpv, double *rsun, double *rmoon, double *gmst)
 {
-    gtime_t tut;
-    double rs[3], rm[3], U[9], gmst_;
+    static THREADLOCAL sunmoon_t c = {{0}};
+    gtime_t tut, tg;
+    double rs[3], rm[3], U[9], dt, cosr, sinr;
 
     trace(4, "sunmoonpos: tutc=%s\n", time_str(tutc, 3));
 
-    tut = timeadd(tutc, erpv[2]); /* utc -> ut1 */
+    /* nearest point of time grid */
+    tg.time = tutc.time;
+    tg.sec = 0.0;
+    tg = timeadd(tg, floor(tutc.sec / SUNMOONGRID + 0.5) * SUNMOONGRID);
 
-    /* sun and moon position in eci */
-    sunmoonpos_eci(tut, rsun ? rs : NULL, rmoon ? rm : NULL);
+    if (!c.tutc.time || timediff(tg, c.tutc) != 0.0 || c.erpv[0] != erpv[0] || c.erpv[1] != erpv[1] ||
+        c.erpv[2] != erpv[2])
+    {
+        tut = timeadd(tg, erpv[2]); /* utc -> ut1 */
 
-    /* eci to ecef transformation matrix */
-    eci2ecef(tutc, erpv, U, &gmst_);
+        /* sun and moon position in eci */
+        sunmoonpos_eci(tut, rs, rm);
+
+        /* eci to ecef transformation matrix */
+        eci2ecef(tg, erpv, U, &c.gmst);
 
-    /* sun and moon postion in ecef */
+        /* sun and moon postion in ecef */
+        matmul("NN", 3, 1, 3, 1.0, U, rs, 0.0, c.rsun);
+        matmul("NN", 3, 1, 3, 1.0, U, rm, 0.0, c.rmoon);
+        c.tutc = tg;
+        c.erpv[0] = erpv[0];
+        c.erpv[1] = erpv[1];
+        c.erpv[2] = erpv[2];
+    }
+    dt = timediff(tutc, tg);
+
+    /* earth rotation from grid point */
+    cosr = cos(OMGE * dt);
+    sinr = sin(OMGE * dt);
     if (rsun)
-        matmul("NN", 3, 1, 3, 1.0, U, rs, 0.0, rsun);
+    {
+        rsun[0] = cosr * c.rsun[0] + sinr * c.rsun[1];
+        rsun[1] = -sinr * c.rsun[0] + cosr * c.rsun[1];
+        rsun[2] = c.rsun[2];
+    }
     if (rmoon)
-        matmul("NN", 3, 1, 3, 1.0, U, rm, 0.0, rmoon);
+    {
+        rmoon[0] = cosr * c.rmoon[0] + sinr * c.rmoon[1];
+        rmoon[1] = -sinr * c.rmoon[0] + cosr * c.rmoon[1];
+        rmoon[2] = c.rmoon[2];
+    }
     if (gmst)
-        *gmst = gmst_;
+        *gmst = c.gmst + OMGE * dt;
 }
 
 /* carrier smoothing -----------------------------------------------------------
@@ -443,6 +443,7 @@ static void initx(rtk_t *rtk, double xi, double var, int i)
 /* temporal update of position/velocity/acceleration -------------------------*/
 static void udpos(rtk_t *rtk, double tt)
 {
+    void *mk = arenamark();
     double *F, *P, *FP, *x, *xp, pos[3], Q[9] = {0}, Qv[9], var = 0.0;
     int i, j, *ix, nx;
 
@@ -497,7 +498,7 @@ static void udpos(rtk_t *rtk, double tt)
         return;
     }
     /* generate valid state index */
-    ix = imat(rtk->nx, 1);
+    ix = aimat(rtk->nx, 1);
     for (i = nx = 0; i < rtk->nx; i++)
     {
         if (rtk->x[i] != 0.0 && rtk->P[i + i * rtk->nx] > 0.0)
@@ -505,15 +506,15 @@ static void udpos(rtk_t *rtk, double tt)
     }
     if (nx < 9)
     {
-        free(ix);
+        arenarelease(mk);
         return;
     }
     /* state transition of position/velocity/acceleration */
-    F = eye(nx);
-    P = mat(nx, nx);
-    FP = mat(nx, nx);
-    x = mat(nx, 1);
-    xp = mat(nx, 1);
+    F = aeye(nx);
+    P = amat(nx, nx);
+    FP = amat(nx, nx);
+    x = amat(nx, 1);
+    xp = amat(nx, 1);
 
     for (i = 0; i < 6; i++)
     {
@@ -534,7 +535,7 @@ static void udpos(rtk_t *rtk, double tt)
     /* x=F*x, P=F*P*F+Q */
     matmul("NN", nx, 1, nx, 1.0, F, x, 0.0, xp);
     matmul("NN", nx, nx, nx, 1.0, F, P, 0.0, FP);
-    matmul("NT", nx, nx, nx, 1.0, FP, F, 0.0, P);
+    symmul("NT", nx, nx, 1.0, FP, F, 0.0, P);
 
     for (i = 0; i < nx; i++)
     {
@@ -554,12 +555,7 @@ static void udpos(rtk_t *rtk, double tt)
         {
             rtk->P[i + 6 + (j + 6) * rtk->nx] += Qv[i + j * 3];
         }
-    free(ix);
-    free(F);
-    free(P);
-    free(FP);
-    free(x);
-    free(xp);
+    arenarelease(mk);
 }
 /* temporal update of ionospheric parameters ---------------------------------*/
 static void udion(rtk_t *rtk, double tt, double bl, const int *sat, int ns)
@@ -918,7 +914,7 @@ static int exclude(int isat1, int isat2, int f, int nf, exc_t *exc)
     return stat;
 }
 /* baseline length constraint ------------------------------------------------*/
-static int constbl(rtk_t *rtk, const double *x, const double *P, double *v, double *H, double *Ri, double *Rj,
+static int constbl(rtk_t *rtk, const double *x, const double *P, double *v, spmat_t *H, double *Ri, double *Rj,
                    int index)
 {
     int i;
@@ -954,7 +950,8 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v, doub
     if (H)
     {
         for (i = 0; i < 3; i++)
-            H[i + index * rtk->nx] = b[i] / bb;
+            spadd(H, i, b[i] / bb);
+        sprow(H);
     }
     Ri[index] = 0.0;
     Rj[index] = SQR(rtk->opt.baseline[1]);
@@ -982,25 +979,26 @@ static void ddcov(const int *nb, int n, const double *Ri, const double *Rj, int
 }
 /* DD (double-differenced) phase/code residuals ------------------------------*/
 static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const int *sat, double *y, double *e,
-                 double *azel, double *freq, const int *iu, const int *ir, int ns, double *v, double *H, double *R,
+                 double *azel, double *freq, const int *iu, const int *ir, int ns, double *v, spmat_t *H, double *R,
                  int *vflg, exc_t *exc)
 {
+    void *mk = arenamark();
     prcopt_t *opt = &rtk->opt;
     double bl, dr[3], posu[3], posr[3], didxi = 0.0, didxj = 0.0, *im, vartu, vartr;
-    double *tropr, *tropu, *dtdxr, *dtdxu, *Ri, *Rj, freqi, freqj, *Hi = NULL;
+    double *tropr, *tropu, *dtdxr, *dtdxu, *Ri, *Rj, freqi, freqj;
     int i, j, k, m, f, nv = 0, nb[NFREQ * 4 * 2 + 2] = {0}, b = 0, sysi, sysj, nf = NF(opt);
 
     bl = baseline(x, rtk->rb, dr);
     ecef2pos(x, posu);
     ecef2pos(rtk->rb, posr);
 
-    Ri = mat(ns * nf * 2 + 2, 1);
-    Rj = mat(ns * nf * 2 + 2, 1);
-    im = mat(ns, 1);
-    tropu = mat(ns, 1);
-    tropr = mat(ns, 1);
-    dtdxu = mat(ns, 3);
-    dtdxr = mat(ns, 3);
+    Ri = amat(ns * nf * 2 + 2, 1);
+    Rj = amat(ns * nf * 2 + 2, 1);
+    im = amat(ns, 1);
+    tropu = amat(ns, 1);
+    tropr = amat(ns, 1);
+    dtdxu = amat(ns, 3);
+    dtdxr = amat(ns, 3);
 
     /* compute factors of ionospheric and tropospheric delay */
     for (i = 0; i < ns; i++)
@@ -1051,12 +1049,6 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                 if (exclude(sat[i], sat[j], f, nf, exc))
                     continue;
 
-                if (H)
-                {
-                    Hi = H + nv * rtk->nx;
-                    for (k = 0; k < rtk->nx; k++)
-                        Hi[k] = 0.0;
-                }
                 /* DD residual */
                 v[nv] =
                     (y[f + iu[i] * nf * 2] - y[f + ir[i] * nf * 2]) - (y[f + iu[j] * nf * 2] - y[f + ir[j] * nf * 2]);
@@ -1066,7 +1058,7 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                 {
                     for (k = 0; k < 3; k++)
                     {
-                        Hi[k] = -e[k + iu[i] * 3] + e[k + iu[j] * 3];
+                        spadd(H, k, -e[k + iu[i] * 3] + e[k + iu[j] * 3]);
                     }
                 }
                 /* DD ionospheric delay term */
@@ -1077,8 +1069,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                     v[nv] -= didxi * x[II(sat[i], opt)] - didxj * x[II(sat[j], opt)];
                     if (H)
                     {
-                        Hi[II(sat[i], opt)] = didxi;
-                        Hi[II(sat[j], opt)] = -didxj;
+                        spadd(H, II(sat[i], opt), didxi);
+                        spadd(H, II(sat[j], opt), -didxj);
                     }
                 }
                 /* DD tropospheric delay term */
@@ -1089,8 +1081,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                     {
                         if (!H)
                             continue;
-                        Hi[IT(0, opt) + k] = (dtdxu[k + i * 3] - dtdxu[k + j * 3]);
-                        Hi[IT(1, opt) + k] = -(dtdxr[k + i * 3] - dtdxr[k + j * 3]);
+                        spadd(H, IT(0, opt) + k, dtdxu[k + i * 3] - dtdxu[k + j * 3]);
+                        spadd(H, IT(1, opt) + k, -(dtdxr[k + i * 3] - dtdxr[k + j * 3]));
                     }
                 }
                 /* DD phase-bias term */
@@ -1101,8 +1093,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                         v[nv] -= CLIGHT / freqi * x[IB(sat[i], f, opt)] - CLIGHT / freqj * x[IB(sat[j], f, opt)];
                         if (H)
                         {
-                            Hi[IB(sat[i], f, opt)] = CLIGHT / freqi;
-                            Hi[IB(sat[j], f, opt)] = -CLIGHT / freqj;
+                            spadd(H, IB(sat[i], f, opt), CLIGHT / freqi);
+                            spadd(H, IB(sat[j], f, opt), -CLIGHT / freqj);
                         }
                     }
                     else
@@ -1110,8 +1102,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                         v[nv] -= x[IB(sat[i], f, opt)] - x[IB(sat[j], f, opt)];
                         if (H)
                         {
-                            Hi[IB(sat[i], f, opt)] = 1.0;
-                            Hi[IB(sat[j], f, opt)] = -1.0;
+                            spadd(H, IB(sat[i], f, opt), 1.0);
+                            spadd(H, IB(sat[j], f, opt), -1.0);
                         }
                     }
                 }
@@ -1123,6 +1115,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
                 trace(2, "sat=%3d-%3d %s%d v=%13.3f R=%8.6f %8.6f\n", sat[i], sat[j], f < nf ? "L" : "P", f % nf + 1,
                       v[nv], Ri[nv], Rj[nv]);
 
+                if (H)
+                    sprow(H);
                 vflg[nv++] = (sat[i] << 16) | (sat[j] << 8) | ((f % nf + 1) << 4) | (f < nf ? 1 : 2);
                 nb[b]++;
             }
@@ -1139,13 +1133,7 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x, const
     /* DD measurement error covariance */
     ddcov(nb, b, Ri, Rj, nv, R);
 
-    free(Ri);
-    free(Rj);
-    free(im);
-    free(tropu);
-    free(tropr);
-    free(dtdxu);
-    free(dtdxr);
+    arenarelease(mk);
 
     return nv;
 }
@@ -1202,15 +1190,16 @@ static int ddidx(rtk_t *rtk, int *ix)
 /* resolve integer ambiguity by LAMBDA ---------------------------------------*/
 static int resamb_LAMBDA(rtk_t *rtk)
 {
+    void *mk = arenamark();
     int *iD, *ix, *ii, i, j, m, n, nx, na, nb, fix;
     double *a, *b, *Qaa, *Qbb, *Qba;
 
     nx = rtk->nx;
-    a = mat(nx, 1);
-    b = mat(nx, 1);
-    iD = imat(nx, 2);
-    ix = imat(nx, 1);
-    ii = imat(nx, 1);
+    a = amat(nx, 1);
+    b = amat(nx, 1);
+    iD = aimat(nx, 2);
+    ix = aimat(nx, 1);
+    ii = aimat(nx, 1);
 
     /* index of SD to DD transformation matrix D */
     na = ddidx(rtk, iD);
@@ -1225,9 +1214,9 @@ static int resamb_LAMBDA(rtk_t *rtk)
         }
     }
 
-    Qbb = mat(nb, nb);
-    Qba = mat(nb, na);
-    Qaa = mat(na, na);
+    Qbb = amat(nb, nb);
+    Qba = amat(nb, na);
+    Qaa = amat(na, na);
 
     for (i = 0; i < na; i++)
     {
@@ -1265,22 +1254,16 @@ static int resamb_LAMBDA(rtk_t *rtk)
         }
     }
 
-    free(iD);
-    free(ix);
-    free(ii);
-    free(a);
-    free(b);
-    free(Qaa);
-    free(Qbb);
-    free(Qba);
+    arenarelease(mk);
 
     return fix; /* number of ambiguities */
 }
 /* reject obs by pre-fit residuals */
-static int valpre(double *v, double *H, double *R, int *vflg, int nv, int nx, exc_t *exc)
+static int valpre(double *v, spmat_t *H, double *R, int *vflg, int nv, exc_t *exc)
 {
+    void *mk = arenamark();
     int i, j, type, stat, nn = 0;
-    int *ix = imat(nv, 1);
+    int *ix = aimat(nv, 1), *keep = aimat(nv, 1);
 
     for (i = 0; i < nv; i++)
         ix[i] = i;
@@ -1305,14 +1288,14 @@ static int valpre(double *v, double *H, double *R, int *vflg, int nv, int nx, ex
             }
             break;
         }
-        if (!stat)
+        if ((keep[i] = !stat))
         {
             v[nn] = v[i];
-            matcpy(H + nn * nx, H + i * nx, nx, 1);
             ix[nn] = ix[i];
             vflg[nn++] = vflg[i];
         }
     }
+    spkeep(H, keep);
     if (nn != nv)
     {
         for (i = 0; i < nn; i++)
@@ -1324,7 +1307,7 @@ static int valpre(double *v, double *H, double *R, int *vflg, int nv, int nx, ex
         }
     }
 
-    free(ix);
+    arenarelease(mk);
     return nn;
 }
 /* validation of solution ----------------------------------------------------*/
@@ -1412,10 +1395,14 @@ static int update_sol(rtk_t *rtk, int stat)
 /* relative positioning ------------------------------------------------------*/
 extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *nav)
 {
+    void *mk = arenamark();
     prcopt_t *opt = &rtk->opt;
     gtime_t time = obs[0].time;
     exc_t exc = {0};
-    double *rs, *dts, *var, *y, *e, *azel, *freq, *v, *H, *R, *xp, *Pp, dt;
+    double *rs, *dts, *var, *y, *e, *azel, *freq, *v, *R, *xp, *Pp, dt;
+    spmat_t H = {0};
+    size_t peak, size;
+    uint32_t hit, miss;
     int n, nf, ns, ny, nv, sat[MAXSAT], iu[MAXSAT], ir[MAXSAT];
     int i, j, info, *vflg, *svh, stat = SOLQ_NONE;
 
@@ -1425,14 +1412,14 @@ extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *n
 
     n = nu + nr;
     nf = NF(opt);
-    rs = mat(6, n);
-    dts = mat(2, n);
-    var = mat(1, n);
-    svh = imat(1, n);
-    y = mat(nf * 2, n);
-    e = mat(3, n);
-    azel = zeros(2, n);
-    freq = zeros(nf, n);
+    rs = amat(6, n);
+    dts = amat(2, n);
+    var = amat(1, n);
+    svh = aimat(1, n);
+    y = amat(nf * 2, n);
+    e = amat(3, n);
+    azel = azeros(2, n);
+    freq = azeros(nf, n);
 
     for (i = 0; i < MAXSAT; i++)
     {
@@ -1460,13 +1447,7 @@ extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *n
     /* select common satellites between rover and base-station */
     if ((ns = selsat(obs, azel, nu, nr, opt, sat, iu, ir)) <= 0)
     {
-        free(rs);
-        free(dts);
-        free(var);
-        free(y);
-        free(e);
-        free(azel);
-        free(freq);
+        arenarelease(mk);
         return;
     }
 
@@ -1480,12 +1461,11 @@ extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *n
     udstate(rtk, obs, sat, iu, ir, ns, nav);
 
     ny = ns * nf * 2 + 2;
-    xp = mat(rtk->nx, 1);
-    Pp = zeros(rtk->nx, rtk->nx);
-    vflg = imat(ny, 1);
-    v = mat(ny, 1);
-    H = zeros(rtk->nx, ny);
-    R = mat(ny, ny);
+    xp = amat(rtk->nx, 1);
+    Pp = azeros(rtk->nx, rtk->nx);
+    vflg = aimat(ny, 1);
+    v = amat(ny, 1);
+    R = amat(ny, ny);
 
     for (i = 0; i < MAX_ITER; i++)
     {
@@ -1494,11 +1474,12 @@ extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *n
 
         /* reject obs by pre-fit residuals */
         zdres(0, obs, nu, rs, dts, var, svh, nav, xp, opt, 0, y, e, azel, freq);
-        nv = ddres(rtk, nav, dt, xp, sat, y, e, azel, freq, iu, ir, ns, v, H, R, vflg, &exc);
-        nv = valpre(v, H, R, vflg, nv, rtk->nx, &exc);
+        spclear(&H);
+        nv = ddres(rtk, nav, dt, xp, sat, y, e, azel, freq, iu, ir, ns, v, &H, R, vflg, &exc);
+        nv = valpre(v, &H, R, vflg, nv, &exc);
 
         /* Kalman filter measurement update */
-        if ((info = filter(xp, Pp, H, v, R, rtk->nx, nv)))
+        if ((info = filtersp(xp, Pp, &H, v, R, rtk->nx, nv)))
         {
             trace(2, "filter error (info=%d)\n", info);
             break;
@@ -1538,18 +1519,14 @@ extern void relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr, const nav_t *n
     /* update solution status */
     update_sol(rtk, stat);
 
-    free(rs);
-    free(dts);
-    free(var);
-    free(svh);
-    free(y);
-    free(e);
-    free(azel);
-    free(freq);
-    free(xp);
-    free(Pp);
-    free(v);
-    free(H);
-    free(R);
-    free(vflg);
+    spfree(&H);
+    arenarelease(mk);
+
+    /* peak usage of workspace arena in epoch */
+    arenastat(&peak, &size);
+    trace(3, "relpos : arena peak=%lu size=%lu\n", (unsigned long)peak, (unsigned long)size);
+
+    /* satellite state cache of epoch */
+    satcachestat(&hit, &miss);
+    trace(3, "relpos : satcache hit=%u miss=%u\n", hit, miss);
 }